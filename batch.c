@@ -0,0 +1,561 @@
+/*! \file
+  \brief
+  File with subroutines to fit many data sets in one process
+
+  \details
+  A manifest lists the data sets to fit, one per line, with the prefix
+  of their output files and, optionally, the model and the initial
+  values of its parameters. Each data set is a job that runs a single
+  Metropolis chain with walkers(); the jobs are shared by a pool of
+  threads that balance the load by work stealing: each thread owns a
+  range of jobs, takes them from the front and, once its range is
+  empty, steals the back half of the largest range left. Since the
+  cost of a job grows with the size of its data set, the jobs are
+  first ordered from the largest data file to the smallest and dealt
+  to the threads in turn, so that each thread starts from a large job
+  and owns a share of the small ones that are left to steal.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
+#include<sys/stat.h>
+
+#include "mcmc.h"
+
+#define LINELENGTH 4096            // max length of a line of the manifest
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+A data set to fit, as listed in the manifest
+
+*/
+typedef struct
+{
+  char data[FILENAME_MAX];       //!< filename of the data set
+  char prefix[FILENAME_MAX];     //!< prefix of the output files
+  char model[64];                //!< name of the model ("" for the default)
+  int Ninit;                     //!< number of initial values given
+  double *init;                  //!< the initial values given
+  long long size;                //!< size of the data file, for the ordering
+  int line;                      //!< line of the job in the manifest
+  int status;                    //!< zero once the job succeeded
+} batchJob;
+
+/*!
+\brief
+The range of jobs owned by a thread of the pool
+
+*/
+typedef struct
+{
+  pthread_mutex_t mutex;         //!< protects the range
+  int next;                      //!< next job to take from the front
+  int end;                       //!< one past the last job of the range
+} jobRange;
+
+/*!
+\brief
+The settings of the fits and the state of the pool
+
+*/
+typedef struct
+{
+  batchJob *jobs;                //!< the jobs, in order of decreasing size
+  jobRange *ranges;              //!< the range of each thread
+  int Nthreads;                  //!< number of threads
+  int format;                    //!< format of the chain files
+  int Nchain;                    //!< number of chain links of each job
+  int proposal;                  //!< kind of steps of the chains
+  int Nadapt;                    //!< burn-in links of the chains
+  int Ncheckpoint;               //!< links between checkpoints
+  int restart;                   //!< if 1, jobs continue from their checkpoints
+  double frac;                   //!< width of the steps, as a fraction of each parameter
+  uint32 seed;                   //!< seed of the random numbers of the chains
+  chainRecord record;            //!< links recorded in the chain files
+  convergence conv;              //!< stopping rule of the chains
+} batchPool;
+
+/*!
+\brief
+The work of one thread of the pool
+
+*/
+typedef struct
+{
+  batchPool *pool;               //!< the shared pool
+  int ithread;                   //!< index of the thread (from 1)
+} batchThread;
+
+// orders the jobs from the largest data file to the smallest
+static int compareJobs(const void *a, const void *b)
+{
+  const batchJob *ja=a, *jb=b;
+
+  if (ja->size!=jb->size)
+    return (ja->size>jb->size) ? -1 : 1;
+  return ja->line-jb->line;
+}
+
+// frees the jobs read by readManifest()
+static void freeJobs(batchJob *jobs, int Njobs)
+{
+  int ijob;
+
+  for (ijob=1;ijob<=Njobs;ijob++)
+    free(jobs[ijob-1].init);
+  free(jobs);
+}
+
+/*!
+\brief
+Reads the manifest of a batch of fits
+
+\details
+Each line that is not empty or a comment (starting with '#') holds
+
+data_file output_prefix [model [Aparam1 ... AparamN]]
+
+where model is the name of a model in models.c ("-" for the default)
+and, if given, the initial values must be all Nparam of the model.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param manifest a string with the filename of the manifest
+
+@param Njobs a pointer to an int with the number of jobs on return
+
+\return the array of the jobs, to be freed with freeJobs(), or NULL if
+there are none; Njobs is -1 if there was an error
+
+*/
+static batchJob *readManifest(char manifest[], int *Njobs)
+{
+  char line[LINELENGTH];
+  batchJob *jobs=NULL;
+  int Nroom=0, Nline=0, error=0;
+  FILE *manifest_file;
+
+  *Njobs=0;
+  if ((manifest_file=fopen(manifest,"r"))==NULL)
+    {
+      printf("Error opening file %s for reading\n",manifest);
+      *Njobs=-1;
+      return NULL;
+    }
+
+  while (fgets(line,sizeof(line),manifest_file)!=NULL)
+    {
+      char *field, *rest;
+      batchJob *job;
+      struct stat source;
+
+      Nline++;
+      field=strtok_r(line," \t\r\n",&rest);
+      if (field==NULL || field[0]=='#')
+	continue;
+
+      // make room for more jobs
+      if (*Njobs==Nroom)
+	{
+	  Nroom=(Nroom==0) ? 64 : 2*Nroom;
+	  batchJob *more=realloc(jobs,Nroom*sizeof(batchJob));
+	  if (more==NULL)
+	    {
+	      printf("Error allocating memory for the jobs of %s\n",manifest);
+	      error=1;
+	      break;
+	    }
+	  jobs=more;
+	}
+      job=&jobs[*Njobs];
+      memset(job,0,sizeof(batchJob));
+      job->line=Nline;
+      job->status=ERROR_FILE;
+
+      snprintf(job->data,sizeof(job->data),"%s",field);
+      if ((field=strtok_r(NULL," \t\r\n",&rest))==NULL)
+	{
+	  printf("Error in line %d of file %s: no output prefix\n",Nline,manifest);
+	  error=1;
+	  break;
+	}
+      snprintf(job->prefix,sizeof(job->prefix),"%s",field);
+      if ((field=strtok_r(NULL," \t\r\n",&rest))!=NULL && strcmp(field,"-")!=0)
+	snprintf(job->model,sizeof(job->model),"%s",field);
+
+      // the initial values, if any
+      while ((field=strtok_r(NULL," \t\r\n",&rest))!=NULL)
+	{
+	  double *more=realloc(job->init,(job->Ninit+1)*sizeof(double));
+	  if (more==NULL)
+	    {
+	      error=1;
+	      break;
+	    }
+	  job->init=more;
+	  job->init[job->Ninit++]=atof(field);
+	}
+
+      job->size=(stat(job->data,&source)==0) ? (long long)source.st_size : 0;
+      (*Njobs)++;
+      if (error)
+	break;
+    }
+  fclose(manifest_file);
+
+  if (error)
+    {
+      freeJobs(jobs,*Njobs);
+      *Njobs=-1;
+      return NULL;
+    }
+
+  return jobs;
+}
+
+/*!
+\brief
+Fits one data set of the batch
+
+\details
+Reads the data set, sets up its model and initial parameters and runs
+a Metropolis chain with walkers(), recording the chain in
+prefix_chains.dat (or .npy), the best-fit model against the data in
+prefix_model.dat and a log like mcmc.log in prefix.log. The job fails
+if these filenames do not fit in FILENAME_MAX.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+@param job a pointer to the job
+
+@param pool a pointer to the settings of the fits
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+static int runJob(batchJob *job, batchPool *pool)
+{
+  char chainfname[FILENAME_MAX], modelfname[FILENAME_MAX], logfname[FILENAME_MAX];
+  dataset data;
+  FILE *logfile, *modelfile;
+  int index;
+
+  if (snprintf(chainfname,sizeof(chainfname),"%s_chains.%s",job->prefix,((pool->format & ~CHAIN_ASYNC)==CHAIN_NPY) ? "npy" : "dat")>=(int)sizeof(chainfname) ||
+      snprintf(modelfname,sizeof(modelfname),"%s_model.dat",job->prefix)>=(int)sizeof(modelfname) ||
+      snprintf(logfname,sizeof(logfname),"%s.log",job->prefix)>=(int)sizeof(logfname))
+    {
+      printf("Line %d of the manifest has a prefix too long for its output files\n",job->line);
+      return ERROR_FILE;
+    }
+
+  if (readData(job->data,&data,0)!=0)
+    {
+      printf("Error in reading data %s\n",job->data);
+      return ERROR_FILE;
+    }
+  if (job->model[0]!='\0' && setModel(&data,job->model)!=0)
+    {
+      freeData(&data);
+      return ERROR_FILE;
+    }
+
+  int Nparam=data.model->Nparam;
+  if (job->Ninit!=0 && job->Ninit!=Nparam)
+    {
+      printf("Line %d of the manifest has %d initial values, the model %s has %d parameters\n",job->line,job->Ninit,data.model->name,Nparam);
+      freeData(&data);
+      return ERROR_FILE;
+    }
+
+  // the same initial steps as in main()
+  double Aparam[Nparam], dev[Nparam];
+  for (index=1;index<=Nparam;index++)
+    {
+      Aparam[index-1]=(job->Ninit>0) ? job->init[index-1] : data.model->init[index-1];
+      dev[index-1]=pool->frac*Aparam[index-1];
+    }
+
+  int proposal=pool->proposal;
+  if (proposal==PROPOSAL_BLOCK && data.model->Nblocks!=MODELNBLOCKS)
+    proposal=PROPOSAL_FULL;
+
+  double ess[Nparam], iat[Nparam], rhat[Nparam];
+  convergence conv=pool->conv;
+  conv.Nlinks=pool->Nchain;
+  conv.ess=ess; conv.iat=iat; conv.rhat=rhat;
+
+  double acc=walkers(chainfname,pool->format,data.model->names,pool->Nchain,Nparam,Aparam,dev,proposal,pool->Nadapt,pool->Ncheckpoint,pool->restart,pool->seed,&pool->record,&conv,&data);
+  if (acc==ERROR_FILE)
+    {
+      freeData(&data);
+      return ERROR_FILE;
+    }
+
+  if ((logfile=fopen(logfname,"w"))!=NULL)
+    {
+      fprintf(logfile,"Read %d data points from file %s\n",data.Npts,job->data);
+      fprintf(logfile,"%ld chains completed with an acceptance ratio of %e\n",conv.Nlinks,acc);
+      fprintf(logfile,"Effective sample sizes, autocorrelation times and split R-hats after burn-in:\n");
+      for(index=1;index<=Nparam;index++)
+	fprintf(logfile,"%e\t%s",ess[index-1],(index==Nparam) ? "\n" : "");
+      for(index=1;index<=Nparam;index++)
+	fprintf(logfile,"%e\t%s",iat[index-1],(index==Nparam) ? "\n" : "");
+      for(index=1;index<=Nparam;index++)
+	fprintf(logfile,"%e\t%s",rhat[index-1],(index==Nparam) ? "\n" : "");
+      fprintf(logfile,"Most likely values of the parameters:\n");
+      for(index=1;index<=Nparam;index++)
+	fprintf(logfile,"%e\t%s",Aparam[index-1],(index==Nparam) ? "\n" : "");
+      fclose(logfile);
+    }
+
+  if ((modelfile=fopen(modelfname,"w"))==NULL)
+    {
+      printf("Error opening file %s for writing\n",modelfname);
+      freeData(&data);
+      return ERROR_FILE;
+    }
+  fprintf(modelfile,"uCo,vCo,VisAmp,Sigma,Model\n");
+  for (index=1;index<=data.Npts;index++)
+    fprintf(modelfile, "%e, %e, %e, %e, %e\n",data.uCo[index-1],data.vCo[index-1],data.Vis[index-1],data.Sigma[index-1],model(data.uCo[index-1],data.vCo[index-1],Nparam,Aparam,&data));
+  fclose(modelfile);
+
+  freeData(&data);
+
+  return 0;
+}
+
+/*!
+\brief
+Takes the next job of a thread, stealing one if its range is empty
+
+\details
+Takes the job at the front of the range of the thread. If the range
+is empty, finds the thread with the most jobs left and moves the back
+half of its range (at least one job) to the range of this thread.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param pool a pointer to the pool
+
+@param ithread an int with the index of the thread (from 1)
+
+\return the index of the job (from 0), or -1 if all jobs are taken
+
+*/
+static int takeJob(batchPool *pool, int ithread)
+{
+  jobRange *own=&pool->ranges[ithread-1];
+  int ijob=-1, ivictim;
+
+  pthread_mutex_lock(&own->mutex);
+  if (own->next<own->end)
+    ijob=own->next++;
+  pthread_mutex_unlock(&own->mutex);
+  if (ijob>=0)
+    return ijob;
+
+  while (1)
+    {
+      int victim=0, Nleft=0;
+
+      // the thread with the most jobs left (the counts may change meanwhile)
+      for (ivictim=1;ivictim<=pool->Nthreads;ivictim++)
+	{
+	  jobRange *range=&pool->ranges[ivictim-1];
+	  pthread_mutex_lock(&range->mutex);
+	  if (range->end-range->next>Nleft)
+	    {
+	      Nleft=range->end-range->next;
+	      victim=ivictim;
+	    }
+	  pthread_mutex_unlock(&range->mutex);
+	}
+      if (victim==0)
+	return -1;
+
+      jobRange *range=&pool->ranges[victim-1];
+      int first=-1, end=-1;
+      pthread_mutex_lock(&range->mutex);
+      Nleft=range->end-range->next;
+      if (Nleft>0)
+	{
+	  end=range->end;
+	  first=end-(Nleft+1)/2;
+	  range->end=first;
+	}
+      pthread_mutex_unlock(&range->mutex);
+      if (first<0)
+	continue;                      // the victim finished meanwhile
+
+      // run the first stolen job, keep the others
+      pthread_mutex_lock(&own->mutex);
+      own->next=first+1;
+      own->end=end;
+      pthread_mutex_unlock(&own->mutex);
+      return first;
+    }
+}
+
+// the work of a thread of the pool: run jobs until there are none left
+static void *runBatchThread(void *arg)
+{
+  batchThread *thread=arg;
+  batchPool *pool=thread->pool;
+  int ijob;
+
+  while ((ijob=takeJob(pool,thread->ithread))>=0)
+    {
+      batchJob *job=&pool->jobs[ijob];
+      job->status=runJob(job,pool);
+      printf("%s %s (%s)\n",(job->status==0) ? "Fitted" : "Failed to fit",job->data,job->prefix);
+    }
+
+  return NULL;
+}
+
+/*!
+\brief
+Fits every data set of a manifest
+
+\details
+Reads the manifest (see readManifest()) and runs one Metropolis chain
+of Nchain links per data set, with the given format, steps, burn-in,
+checkpoints and stopping rule (see walkers()), over a pool of Nthreads
+threads with work stealing, to which the jobs are dealt in turn from
+the largest. The outputs of each data set go to files
+named after its prefix (see runJob()), so that a batch can be run
+again with restart=1 to continue each chain from its checkpoint.
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is called from main()
+
+@param manifest a string with the filename of the manifest
+
+@param Nthreads an int with the number of threads
+
+@param format an int with the format of the chain files (see mcmc.h)
+
+@param Nchain an int with the number of links of each chain
+
+@param proposal an int with the kind of steps, PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
+
+@param Nadapt an int with the number of links of burn-in
+
+@param Ncheckpoint an int with the number of links between checkpoints (0 for none)
+
+@param restart an int; if 1, each chain continues from its checkpoint
+
+@param frac a double with the width of the steps, as a fraction of each initial parameter
+
+@param seed a uint32 with the seed of the random numbers of each chain
+
+@param record a pointer to the rule of the links recorded in the chain files (without a summary)
+
+@param conv a pointer to the stopping rule of the chains
+
+@param Nfailed a pointer to an int with the number of jobs that failed on return
+
+\return the number of jobs in the manifest, or -1 if it could not be read
+
+*/
+int batch(char manifest[], int Nthreads, int format, int Nchain, int proposal, int Nadapt, int Ncheckpoint, int restart, double frac, uint32 seed, chainRecord *record, convergence *conv, int *Nfailed)
+{
+  batchPool pool;
+  int Njobs, ijob, ithread;
+
+  *Nfailed=0;
+  pool.jobs=readManifest(manifest,&Njobs);
+  if (pool.jobs==NULL)
+    return Njobs;
+
+  qsort(pool.jobs,Njobs,sizeof(batchJob),compareJobs);
+
+  if (Nthreads<1)
+    Nthreads=1;
+  if (Nthreads>Njobs)
+    Nthreads=Njobs;
+
+  pool.Nthreads=Nthreads;
+  pool.format=format;
+  pool.Nchain=Nchain;
+  pool.proposal=proposal;
+  pool.Nadapt=Nadapt;
+  pool.Ncheckpoint=Ncheckpoint;
+  pool.restart=restart;
+  pool.frac=frac;
+  pool.seed=seed;
+  pool.record=*record;
+  pool.record.summary=NULL;
+  pool.conv=*conv;
+
+  pool.ranges=malloc(Nthreads*sizeof(jobRange));
+  batchThread *threads=malloc(Nthreads*sizeof(batchThread));
+  pthread_t *tid=malloc(Nthreads*sizeof(pthread_t));
+  batchJob *dealt=malloc(Njobs*sizeof(batchJob));
+  if (pool.ranges==NULL || threads==NULL || tid==NULL || dealt==NULL)
+    {
+      printf("Error allocating memory for %d threads\n",Nthreads);
+      free(pool.ranges); free(threads); free(tid); free(dealt);
+      freeJobs(pool.jobs,Njobs);
+      return -1;
+    }
+
+  // deal the jobs, largest first, to the threads in turn: the jobs
+  // ithread, ithread+Nthreads, ... go together in the range of ithread
+  int Ndealt=0;
+  for (ithread=1;ithread<=Nthreads;ithread++)
+    {
+      pthread_mutex_init(&pool.ranges[ithread-1].mutex,NULL);
+      pool.ranges[ithread-1].next=Ndealt;
+      for (ijob=ithread;ijob<=Njobs;ijob+=Nthreads)
+	dealt[Ndealt++]=pool.jobs[ijob-1];
+      pool.ranges[ithread-1].end=Ndealt;
+      threads[ithread-1].pool=&pool;
+      threads[ithread-1].ithread=ithread;
+    }
+  free(pool.jobs);
+  pool.jobs=dealt;
+
+  int Nstarted=0;
+  for (ithread=1;ithread<=Nthreads;ithread++)
+    {
+      if (pthread_create(&tid[ithread-1],NULL,runBatchThread,&threads[ithread-1])!=0)
+	break;
+      Nstarted++;
+    }
+  // with fewer threads, the others steal the jobs of those not started
+  if (Nstarted==0)
+    runBatchThread(&threads[0]);
+  for (ithread=1;ithread<=Nstarted;ithread++)
+    pthread_join(tid[ithread-1],NULL);
+
+  for (ijob=1;ijob<=Njobs;ijob++)
+    if (pool.jobs[ijob-1].status!=0)
+      (*Nfailed)++;
+
+  for (ithread=1;ithread<=Nthreads;ithread++)
+    pthread_mutex_destroy(&pool.ranges[ithread-1].mutex);
+  free(pool.ranges); free(threads); free(tid);
+  freeJobs(pool.jobs,Njobs);
+
+  return Njobs;
+}
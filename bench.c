@@ -0,0 +1,610 @@
+/*! \file
+  \brief
+  Benchmarks of the likelihood, the random numbers, the chain files and the samplers
+
+  \details
+  A separate executable (make bench) that times the hot paths of the
+  MCMC code and writes the results as JSON, so that they can be
+  compared between versions:
+
+  - "likelihood": ns per evaluation of model(), like(), post() and
+    postGrad() of the default model, on synthetic data sets of 1k to 1M
+    points, of like() with the single-precision kernel on the same data
+    sets, and of like() for every model on 64k points;
+  - "accuracy": errors of the exponential and the sine/cosine of the
+    kernels and of the log likelihood against libm (see benchAccuracy());
+  - "rng": random numbers per second of randomMT(), uniform() and
+    gauss(), and of randomMT() on a Philox stream;
+  - "chainio": rows and MB per second written to a chain file in each
+    format, with and without the I/O thread;
+  - "samplers": effective samples per second of each sampler on the
+    data of synth_data.dat (or, without it, on 1k synthetic points).
+
+  Each measurement repeats the operation until it has run for at least
+  BENCH_TIME seconds. Usage:
+
+  ./bench [quick] > bench.json
+
+  where "quick" shortens every measurement and skips the largest data
+  sets, for a smoke test.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<unistd.h>
+#include<sys/stat.h>
+
+#include "mcmc.h"
+#include "simd.h"
+
+#define BENCH_TIME 0.5             // min seconds of each measurement
+#define BENCH_QUICKTIME 0.02       // min seconds of each measurement with "quick"
+#define BENCH_SEED 4357U           // seed of the synthetic data
+#define BENCH_NMIN 1000            // smallest synthetic data set
+#define BENCH_NMAX 1000000         // largest synthetic data set
+#define BENCH_NQUICK 100000        // largest synthetic data set with "quick"
+#define BENCH_NMODELS 65536        // data points of the comparison of the models
+#define BENCH_FILE "bench_chains"  // prefix of the temporary chain files
+#define BENCH_LOGPTOL 1.e-6        // largest error of the log likelihood of the double kernels
+#define BENCH_LARGETOL 2.0         // largest growth of the errors of the sine and cosine at 1e5-1e6
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+static double benchTime=BENCH_TIME;     // min seconds of each measurement
+
+// the models of models.c, compared on the same data
+static char *modelNames[]={"gauss1","gauss2","gauss3","ring"};
+
+// wall clock time, in seconds
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+1.e-9*ts.tv_nsec;
+}
+
+/*!
+\brief
+Makes a synthetic data set of the default model
+
+\details
+The (u,v) points are spread uniformly over the baselines of
+synth_data.dat, and the amplitudes are those of the initial parameters
+of the default model with Gaussian noise.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param data a pointer to the data set on return
+
+@param Npts an int with the number of data points
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+static int makeData(dataset *data, int Npts)
+{
+  double *uCo=malloc(4*(size_t)Npts*sizeof(double));
+  double *vCo=uCo+Npts, *Vis=vCo+Npts, *Sigma=Vis+Npts;
+  modelSpec *spec=findModel(NULL);
+  mtState rng;
+  int index, result;
+
+  if (uCo==NULL)
+    return ERROR_FILE;
+
+  seedMT(&rng,BENCH_SEED);
+  for (index=1;index<=Npts;index++)
+    {
+      uCo[index-1]=6.e10*(uniform(&rng)-0.5);
+      vCo[index-1]=6.e10*(uniform(&rng)-0.5);
+      Sigma[index-1]=0.05;
+      Vis[index-1]=spec->model(uCo[index-1],vCo[index-1],spec->Nparam,spec->init)+gauss(&rng,Sigma[index-1]);
+    }
+
+  result=prepareData(data,Npts,uCo,vCo,Vis,Sigma);
+  free(uCo);
+  return result;
+}
+
+// the operations that are timed, on a data set and a parameter vector
+#define OP_MODEL 0
+#define OP_LIKE 1
+#define OP_POST 2
+#define OP_GRAD 3
+
+/*!
+\brief
+Times one operation of the likelihood
+
+\details
+Repeats the operation, with the parameters nudged at every call so
+that nothing can be hoisted out of the loop, until it has run for
+benchTime seconds.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param op an int with the operation, OP_MODEL, OP_LIKE, OP_POST or OP_GRAD
+
+@param data a pointer to the prepared data set
+
+\return a double with the ns per evaluation (per point for OP_MODEL)
+
+*/
+static double timeOp(int op, dataset *data)
+{
+  int Nparam=data->model->Nparam;
+  double Aparam[Nparam], gradient[Nparam];
+  double sink=0.0, start, elapsed;
+  long Ncalls=0, Nrep=1;
+  int index, iparam;
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    Aparam[iparam-1]=data->model->init[iparam-1];
+
+  start=now();
+  do
+    {
+      for (index=1;index<=Nrep;index++)
+	{
+	  Aparam[0]*=1.0+1.e-12;
+	  switch (op)
+	    {
+	    case OP_MODEL:
+	      sink+=model(data->uCo[index%data->Npts],data->vCo[index%data->Npts],Nparam,Aparam,data);
+	      break;
+	    case OP_LIKE:
+	      sink+=like(Nparam,Aparam,data);
+	      break;
+	    case OP_POST:
+	      sink+=post(Nparam,Aparam,data);
+	      break;
+	    case OP_GRAD:
+	      sink+=postGrad(Nparam,Aparam,data,gradient)+gradient[0];
+	      break;
+	    }
+	}
+      Ncalls+=Nrep;
+      Nrep*=2;
+      elapsed=now()-start;
+    }
+  while (elapsed<benchTime);
+
+  // keep the results alive
+  if (sink==0.123456789)
+    printf("%e\n",sink);
+
+  return 1.e9*elapsed/Ncalls;
+}
+
+// benchmarks the likelihood over the sizes of data sets and the models
+static void benchLikelihood(FILE *out, int Nmax)
+{
+  dataset data;
+  int Npts, imodel, first=1;
+
+  fprintf(out,"  \"likelihood\": {\n    \"model\": \"%s\",\n    \"sizes\": [\n",findModel(NULL)->name);
+  for (Npts=BENCH_NMIN;Npts<=Nmax;Npts*=10)
+    {
+      if (makeData(&data,Npts)!=0)
+	break;
+      double nsModel=timeOp(OP_MODEL,&data);
+      double nsLike=timeOp(OP_LIKE,&data);
+      double nsPost=timeOp(OP_POST,&data);
+      double nsGrad=timeOp(OP_GRAD,&data);
+      double nsSingle=(singleData(&data,PRECISION_SINGLE)==0) ? timeOp(OP_LIKE,&data) : 0.0;
+      fprintf(out,"%s      {\"points\": %d, \"model_ns\": %.3f, \"like_ns\": %.1f, \"post_ns\": %.1f, \"postgrad_ns\": %.1f, \"like_ns_per_point\": %.4f, \"like_single_ns\": %.1f}",
+	      (first) ? "" : ",\n",Npts,nsModel,nsLike,nsPost,nsGrad,nsLike/Npts,nsSingle);
+      first=0;
+      freeData(&data);
+    }
+  fprintf(out,"\n    ],\n    \"models\": [\n");
+
+  // the same points for every model
+  if (makeData(&data,BENCH_NMODELS)==0)
+    {
+      for (imodel=1;imodel<=(int)(sizeof(modelNames)/sizeof(modelNames[0]));imodel++)
+	{
+	  setModel(&data,modelNames[imodel-1]);
+	  double nsLike=timeOp(OP_LIKE,&data);
+	  fprintf(out,"%s      {\"model\": \"%s\", \"points\": %d, \"like_ns\": %.1f, \"like_ns_per_point\": %.4f}",
+		  (imodel==1) ? "" : ",\n",modelNames[imodel-1],data.Npts,nsLike,nsLike/data.Npts);
+	}
+      freeData(&data);
+    }
+  fprintf(out,"\n    ]\n  },\n");
+}
+
+// the functions of the lanes checked against libm by benchAccuracy()
+#define FUNC_EXP 0
+#define FUNC_SIN 1
+#define FUNC_COS 2
+
+// largest error of a function of the lanes over Nargs arguments spread
+// uniformly in [lo,hi], relative for the exponential and absolute for the
+// sine and the cosine, which vanish; in single precision if single is 1
+static double funcError(int func, int single, double lo, double hi, long Nargs)
+{
+  double x[VLEN] __attribute__((aligned(DATA_ALIGN))), y[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  float xf[VLENF] __attribute__((aligned(DATA_ALIGN))), yf[VLENF] __attribute__((aligned(DATA_ALIGN)));
+  int Nlanes=(single) ? VLENF : VLEN;
+  double err=0.0, arg, ref, val;
+  long iarg;
+  int lane;
+
+  for (iarg=0;iarg+Nlanes<=Nargs;iarg+=Nlanes)
+    {
+      if (single)
+	{
+	  for (lane=0;lane<VLENF;lane++)
+	    xf[lane]=(float)(lo+(hi-lo)*(iarg+lane)/Nargs);
+	  vfloat v=vfload(xf);
+	  vfstore(yf,(func==FUNC_EXP) ? vfexp(v) : ((func==FUNC_SIN) ? vfsin(v) : vfcos(v)));
+	}
+      else
+	{
+	  for (lane=0;lane<VLEN;lane++)
+	    x[lane]=lo+(hi-lo)*(iarg+lane)/Nargs;
+	  vdouble v=vload(x);
+	  vstore(y,(func==FUNC_EXP) ? vexp(v) : ((func==FUNC_SIN) ? vsin(v) : vcos(v)));
+	}
+
+      for (lane=0;lane<Nlanes;lane++)
+	{
+	  arg=(single) ? xf[lane] : x[lane];
+	  val=(single) ? yf[lane] : y[lane];
+	  ref=(func==FUNC_EXP) ? exp(arg) : ((func==FUNC_SIN) ? sin(arg) : cos(arg));
+	  val=(func==FUNC_EXP) ? ((ref>0.0) ? fabs(val/ref-1.0) : fabs(val)) : fabs(val-ref);
+	  if (val>err)
+	    err=val;
+	}
+    }
+
+  return err;
+}
+
+// the log likelihood of the model at Aparam[] from model(), with libm, summed
+// in long double
+static double likeReference(int Nparam, double Aparam[], dataset *data)
+{
+  long double chi2=0.0L;
+  int index;
+
+  for (index=1;index<=data->Npts;index++)
+    {
+      double variance=(data->Vis[index-1]-model(data->uCo[index-1],data->vCo[index-1],Nparam,Aparam,data))/data->Sigma[index-1];
+      chi2+=variance*variance;
+    }
+
+  return -(double)(chi2+data->chi2Offset);
+}
+
+/*!
+\brief
+Checks the accuracy of the transcendental functions of the kernels
+
+\details
+Compares the exponential, the sine and the cosine of the SIMD lanes
+(the vector math library, or the polynomials of simd.h in builds with
+VMATH) with those of libm, over the arguments of the kernels and
+beyond, in double and in single precision, as well as the double sine
+and cosine at arguments of 1e5 to 1e6, where an inexact reduction to
+[-pi/4,pi/4] shows up; there the errors must stay within BENCH_LARGETOL
+times those at the arguments up to 1e3. It then compares the log
+likelihood of like() with the one summed from model(), which calls
+libm one point at a time, for every model on BENCH_NMODELS points and
+Nsets parameter vectors that scatter the initial parameters by 1%, as
+the steps of the chains do (see frac). The double kernels pass when
+these errors do and when the log likelihood differs by less than BENCH_LOGPTOL, far below the
+differences of log posterior that decide the steps of a chain; the
+differences of the single-precision kernel are reported as well.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+@param out a pointer to the open JSON file
+
+@param quick an int; if 1, check fewer arguments and parameter vectors
+
+*/
+static void benchAccuracy(FILE *out, int quick)
+{
+  long Nargs=(quick) ? 1L<<16 : 1L<<22;
+  int Nsets=(quick) ? 10 : 100;
+  dataset data;
+  mtState rng;
+  int imodel, iset, iparam, pass=1;
+
+  fprintf(out,"  \"accuracy\": {\n    \"vmath\": %d,\n",
+#ifdef VMATH
+	  VMATH
+#else
+	  0
+#endif
+	  );
+  double sinErr=funcError(FUNC_SIN,0,-1.e3,1.e3,Nargs), cosErr=funcError(FUNC_COS,0,-1.e3,1.e3,Nargs);
+  double sinLarge=funcError(FUNC_SIN,0,1.e5,1.e6,Nargs), cosLarge=funcError(FUNC_COS,0,-1.e6,-1.e5,Nargs);
+  pass&=(sinLarge<=BENCH_LARGETOL*sinErr && cosLarge<=BENCH_LARGETOL*cosErr);
+  fprintf(out,"    \"exp_rel\": %.3e, \"sin_abs\": %.3e, \"cos_abs\": %.3e,\n",
+	  funcError(FUNC_EXP,0,-700.,700.,Nargs),sinErr,cosErr);
+  fprintf(out,"    \"sin_large_abs\": %.3e, \"cos_large_abs\": %.3e,\n",sinLarge,cosLarge);
+  fprintf(out,"    \"expf_rel\": %.3e, \"sinf_abs\": %.3e, \"cosf_abs\": %.3e,\n    \"models\": [\n",
+	  funcError(FUNC_EXP,1,-80.,80.,Nargs),funcError(FUNC_SIN,1,-1.e2,1.e2,Nargs),funcError(FUNC_COS,1,-1.e2,1.e2,Nargs));
+
+  if (makeData(&data,BENCH_NMODELS)==0)
+    {
+      seedMT(&rng,BENCH_SEED);
+      for (imodel=1;imodel<=(int)(sizeof(modelNames)/sizeof(modelNames[0]));imodel++)
+	{
+	  setModel(&data,modelNames[imodel-1]);
+	  int Nparam=data.model->Nparam;
+	  double Aparam[Nparam];
+	  double errDouble=0.0, errSingle=0.0, relDouble=0.0;
+	  int single=(data.model->chi2f!=NULL && singleData(&data,PRECISION_SINGLE)==0);
+
+	  for (iset=1;iset<=Nsets;iset++)
+	    {
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		Aparam[iparam-1]=data.model->init[iparam-1]*(1.0+gauss(&rng,0.01));
+	      double ref=likeReference(Nparam,Aparam,&data);
+	      data.precision=PRECISION_DOUBLE;
+	      double err=fabs(like(Nparam,Aparam,&data)-ref);
+	      if (err>errDouble)
+		errDouble=err;
+	      if (err/fabs(ref)>relDouble)
+		relDouble=err/fabs(ref);
+	      if (single)
+		{
+		  data.precision=PRECISION_SINGLE;
+		  err=fabs(like(Nparam,Aparam,&data)-ref);
+		  if (err>errSingle)
+		    errSingle=err;
+		}
+	    }
+	  data.precision=PRECISION_DOUBLE;
+	  pass&=(errDouble<BENCH_LOGPTOL);
+	  fprintf(out,"%s      {\"model\": \"%s\", \"like_abs\": %.3e, \"like_rel\": %.3e, \"like_single_abs\": %.3e}",
+		  (imodel==1) ? "" : ",\n",modelNames[imodel-1],errDouble,relDouble,(single) ? errSingle : 0.0);
+	}
+      freeData(&data);
+    }
+  fprintf(out,"\n    ],\n    \"pass\": %s\n  },\n",(pass) ? "true" : "false");
+}
+
+// benchmarks the random number generators, in numbers per second
+static void benchRng(FILE *out)
+{
+  mtState rng, prng;
+  double start, elapsed, sink=0.0;
+  double rates[4];
+  long Ncalls, index, Nrep;
+  int igen;
+  uint32 isink=0;
+
+  seedMT(&rng,BENCH_SEED);
+  seedPhilox(&prng,BENCH_SEED);
+  for (igen=1;igen<=4;igen++)
+    {
+      Ncalls=0;
+      Nrep=1024;
+      start=now();
+      do
+	{
+	  for (index=1;index<=Nrep;index++)
+	    {
+	      if (igen==1)
+		isink+=randomMT(&rng);
+	      else if (igen==2)
+		sink+=uniform(&rng);
+	      else if (igen==3)
+		sink+=gauss(&rng,1.0);
+	      else
+		isink+=randomMT(&prng);
+	    }
+	  Ncalls+=Nrep;
+	  Nrep*=2;
+	  elapsed=now()-start;
+	}
+      while (elapsed<benchTime);
+      rates[igen-1]=Ncalls/elapsed;
+    }
+  if (sink==0.123456789 || isink==123456789)
+    printf("%e\n",sink);
+
+  fprintf(out,"  \"rng\": {\"randomMT_per_s\": %.4e, \"uniform_per_s\": %.4e, \"gauss_per_s\": %.4e, \"philox_per_s\": %.4e},\n",rates[0],rates[1],rates[2],rates[3]);
+}
+
+// benchmarks the writing of chain files of 6 parameters in every format
+static void benchChainio(FILE *out, long Nrows)
+{
+  static char *formats[]={"text","npy","text_async","npy_async"};
+  int formatCodes[4]={CHAIN_TEXT,CHAIN_NPY,CHAIN_TEXT|CHAIN_ASYNC,CHAIN_NPY|CHAIN_ASYNC};
+  char fname[FILENAME_MAX];
+  double row[6]={4.05,4.99,-12.2,12.8,1.14,2.94};
+  chainWriter writer;
+  struct stat info;
+  long irow;
+  int iformat;
+
+  fprintf(out,"  \"chainio\": [\n");
+  for (iformat=1;iformat<=4;iformat++)
+    {
+      snprintf(fname,sizeof(fname),"%s.%s",BENCH_FILE,((formatCodes[iformat-1] & ~CHAIN_ASYNC)==CHAIN_NPY) ? "npy" : "dat");
+      if (openChain(&writer,fname,formatCodes[iformat-1],6,0,Nrows,NULL,BENCH_SEED)!=0)
+	continue;
+
+      double start=now();
+      for (irow=1;irow<=Nrows;irow++)
+	{
+	  row[0]+=1.e-9;
+	  writeChain(&writer,row);
+	}
+      closeChain(&writer);
+      double elapsed=now()-start;
+
+      double MB=(stat(fname,&info)==0) ? info.st_size/1.e6 : 0.0;
+      remove(fname);
+      fprintf(out,"%s    {\"format\": \"%s\", \"rows\": %ld, \"rows_per_s\": %.4e, \"MB_per_s\": %.2f}",
+	      (iformat==1) ? "" : ",\n",formats[iformat-1],Nrows,Nrows/elapsed,MB/elapsed);
+    }
+  fprintf(out,"\n  ],\n");
+}
+
+/*!
+\brief
+Benchmarks the samplers end to end
+
+\details
+Runs each sampler from the initial parameters of the model, writing
+its chains to temporary files that are removed afterwards, and reports
+the smallest effective sample size over the parameters after burn-in
+(summed over the chains) per second of the whole run. The ensemble
+sampler has no convergence diagnostics, so only its samples per second
+are reported.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param out a pointer to the open JSON file
+
+@param data a pointer to the prepared data set
+
+@param quick an int; if 1, run shorter chains
+
+*/
+static void benchSamplers(FILE *out, dataset *data, int quick)
+{
+  static char *samplers[]={"mh","multi","nuts","ensemble"};
+  int Nparam=data->model->Nparam;
+  double Aparam[Nparam], dev[Nparam], ess[Nparam], iat[Nparam], rhat[Nparam];
+  char fname[FILENAME_MAX], shard[FILENAME_MAX];
+  double stepSize, swapRate;
+  long Ngrad;
+  convergence conv;
+  chainRecord record={0,1,NULL};   // every link to the file, without a summary
+  int isampler, iparam, ichain;
+  int Nchains=4, Nwalkers=32;
+
+  // links of each sampler, so that each run takes a comparable time
+  int Nlinks[4]={40000,10000,2000,40000/32};
+  if (quick)
+    for (isampler=1;isampler<=4;isampler++)
+      Nlinks[isampler-1]/=10;
+
+  fprintf(out,"  \"samplers\": {\n    \"points\": %d,\n    \"runs\": [\n",data->Npts);
+  for (isampler=1;isampler<=4;isampler++)
+    {
+      for (iparam=1;iparam<=Nparam;iparam++)
+	{
+	  Aparam[iparam-1]=data->model->init[iparam-1];
+	  dev[iparam-1]=0.01*Aparam[iparam-1];
+	}
+      conv.essTarget=0.0;
+      conv.rhatTarget=1.01;
+      conv.Ncheck=1000;
+      conv.Nlinks=Nlinks[isampler-1];
+      conv.ess=ess; conv.iat=iat; conv.rhat=rhat;
+      int Nadapt=Nlinks[isampler-1]/5;
+      snprintf(fname,sizeof(fname),"%s.dat",BENCH_FILE);
+
+      double start=now();
+      long Nsamples=Nlinks[isampler-1];
+      if (isampler==1)
+	walkers(fname,CHAIN_TEXT,NULL,Nlinks[0],Nparam,Aparam,dev,PROPOSAL_FULL,Nadapt,0,0,BENCH_SEED,&record,&conv,data);
+      else if (isampler==2)
+	{
+	  multichain(fname,CHAIN_TEXT,NULL,Nlinks[1],Nchains,0,1.0,100,Nparam,Aparam,dev,PROPOSAL_FULL,Nadapt,BENCH_SEED,&record,&conv,data,&swapRate);
+	  Nsamples*=Nchains;
+	}
+      else if (isampler==3)
+	hmc(fname,CHAIN_TEXT,NULL,Nlinks[2],Nparam,Aparam,dev,0,Nadapt,BENCH_SEED,&record,&conv,data,&stepSize,&Ngrad);
+      else
+	{
+	  ensemble(fname,CHAIN_TEXT,NULL,Nlinks[3],Nwalkers,Nparam,Aparam,dev,BENCH_SEED,&record,data);
+	  Nsamples*=Nwalkers;
+	}
+      double elapsed=now()-start;
+
+      // the chain files, including the shards of several chains
+      remove(fname);
+      for (ichain=0;ichain<Nchains;ichain++)
+	{
+	  chainFileName(shard,fname,ichain);
+	  remove(shard);
+	}
+
+      fprintf(out,"%s      {\"sampler\": \"%s\", \"samples\": %ld, \"seconds\": %.4f, \"samples_per_s\": %.4e",
+	      (isampler==1) ? "" : ",\n",samplers[isampler-1],Nsamples,elapsed,Nsamples/elapsed);
+      if (isampler!=4)
+	{
+	  double essMin=ess[0];
+	  for (iparam=2;iparam<=Nparam;iparam++)
+	    if (ess[iparam-1]<essMin)
+	      essMin=ess[iparam-1];
+	  fprintf(out,", \"ess_min\": %.1f, \"ess_per_s\": %.4e",essMin,essMin/elapsed);
+	}
+      fprintf(out,"}");
+    }
+  fprintf(out,"\n    ]\n  }\n");
+}
+
+/*!
+\brief
+Main function of the benchmarks
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param argc an int with the number of command line arguments
+
+@param argv[] an array of strings with the command line arguments
+
+*/
+int main(int argc, char *argv[])
+{
+  dataset data;
+  int quick=(argc>1 && strcmp(argv[1],"quick")==0);
+  FILE *out=stdout;
+
+  if (quick)
+    benchTime=BENCH_QUICKTIME;
+
+  fprintf(out,"{\n  \"simd_lanes\": %d,\n  \"cores\": %ld,\n  \"compiler\": \"%s\",\n  \"quick\": %s,\n",
+	  VLEN,sysconf(_SC_NPROCESSORS_ONLN),__VERSION__,(quick) ? "true" : "false");
+
+  benchLikelihood(out,(quick) ? BENCH_NQUICK : BENCH_NMAX);
+  benchAccuracy(out,quick);
+  benchRng(out);
+  benchChainio(out,(quick) ? 100000L : 1000000L);
+
+  // the samplers on the real data if there are any
+  FILE *test=fopen("synth_data.dat","r");
+  if (test!=NULL)
+    fclose(test);
+  if ((test!=NULL) ? readData("synth_data.dat",&data,0) : makeData(&data,BENCH_NMIN))
+    {
+      printf("Error in reading data\n");
+      return 1;
+    }
+  benchSamplers(out,&data,quick);
+  freeData(&data);
+
+  fprintf(out,"}\n");
+  return 0;
+}
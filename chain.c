@@ -15,20 +15,23 @@
 #include<math.h>
 #include<stdlib.h>
 
+#include "mcmc.h"
+#include "instrument.h"
+#ifdef USE_GPU
+#include<string.h>
+#include "likegpu.h"
+#endif
 
 
-typedef unsigned int uint32;
-uint32 MTMAX=0xFFFFFFFFU;           // max number in the MT random series
-
-#define SEEDNO 4357U               // initial seed for random number generator
-
-#define muarcsecToRad 4.8481368110954e-12   //microarcsec to radians
+#define EXITBLOCK 1024             // data points per block of likeBudget() (a multiple of DATA_PAD)
+#define EXITMARGIN 1.e-9           // relative slack of the chi-square budget for rounding
 
 #define ERROR_FILE 9999            // error code for file i/o errors
 
+#define ADAPT_START 500            // links before the first adapted covariance
+#define ADAPT_REFACTOR 100         // links between Cholesky factorizations
+#define ADAPT_EPS 1.e-6            // regularization of the covariance, in units of dev^2
 
-void seedMT(uint32 seed);
-uint32 reloadMT(void);
 
 /*!
 \brief 
@@ -39,14 +42,14 @@ Given a number of parameters Nparam and their values stored in the
 array Aparam[], it returns model prediction at the location with coordinates
 (uCo, vCo).
 
-The model used here generates the visibility amplitude of a 2-Gaussian
-component model
+The model is the one chosen for the data set with setModel(); by
+default, the visibility amplitude of a 2-Gaussian component model.
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.1
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from walkers()
 
@@ -58,32 +61,14 @@ component model
 
 @param Aparam[] an array of doubles with the current values of the model parameters
 
+@param data a pointer to the data set
+
 \return a double with the log prior likelihood
 
 */
-double model(double uCo, double vCo, int Nparam, double Aparam[])
+double model(double uCo, double vCo, int Nparam, double Aparam[], dataset *data)
 {
-  double result;
-
-  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
-  double b02=uCo*uCo+vCo*vCo;     // baseline length squared
-
-  b02*=muarcsecToRad*muarcsecToRad;
-  // real and imaginary parts of Gaussian 1 (zero centered)
-  double Vr1=Aparam[0]*exp(-aux*Aparam[1]*Aparam[1]*b02);
-  double Vi1=0.0;
-
-  // amplitude, real and imaginary parts of Gaussian 2
-  double V2=Aparam[4]*exp(-aux*Aparam[5]*Aparam[5]*b02);
-  double phase2=-2.*M_PI*(uCo*Aparam[2]+vCo*Aparam[3])*muarcsecToRad;
-  double Vr2=V2*cos(phase2);
-  double Vi2=V2*sin(phase2);
-
-  // add together real and imaginary parts and take their modulus
-  result=sqrt((Vr1+Vr2)*(Vr1+Vr2)+Vi2*Vi2);
-
-  return result;
-  
+  return data->model->model(uCo,vCo,Nparam,Aparam);
 }
 
 /*!
@@ -93,13 +78,13 @@ Calculates the priors
 \details 
 Given a number of parameters Nparam and their values stored in the
 array Aparam[], it returns the log of the full prior distribution for
-the underlying model.
+the model of the data set.
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.1
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from walkers()
 
@@ -107,20 +92,14 @@ the underlying model.
 
 @param Aparam[] an array of doubles with the current values of the model parameters
 
+@param data a pointer to the data set
+
 \return a double with the log prior 
 
 */
-double prior(int Nparam, double Aparam[])
+double prior(int Nparam, double Aparam[], dataset *data)
 {
-  double result=1.;
-
-  // for each gaussian components, the prior is inversely proportional to the
-  // two scale parameters, normalization and width
-  // NB: no check for zeros, to increase efficiency
-  result=-log(Aparam[0]*Aparam[1]*Aparam[4]*Aparam[5]);
-
-  return result;
-  
+  return data->model->prior(Nparam,Aparam);
 }
 
 /*!
@@ -128,19 +107,21 @@ double prior(int Nparam, double Aparam[])
 Calculates the likelihood
 
 \details Given a number of parameters Nparam and their values stored
-in the array Aparam[] as well as a number of data points with
-coordinates stored in the arrays uCo[] and vCo[], visibility
-amplitudes stored in the array Vis[], and errors stored in the arrays
-Sigma[], it returns the log of the likelihood for the
-underlying model.
+in the array Aparam[] as well as a data set prepared by prepareData(),
+it returns the log of the likelihood for the underlying model.
 
-In this example the log likelihood is simply the value of -chi2.
+In this example the log likelihood is simply the value of -chi2. The
+chi-square over all data points is calculated by the SIMD kernel
+of the model, through chi2Pool(), which shares the points of large data
+sets among threads, or by chi2Terms() when the data set
+also has complex or closure terms, plus the chi-square of the points
+within their bins if the data were binned with binData().
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.4
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from walkers()
 
@@ -148,40 +129,32 @@ In this example the log likelihood is simply the value of -chi2.
 
 @param Aparam[] an array of doubles with the current values of the model parameters
 
-@param Npts an integer with the number of data points
-
-@param uCo[] an array of doubles with the u-coordinates of the data
-
-@param vCo[] an array of doubles with the v-coordinates of the data
-
-@param Vis[] an array of doubles with the visibility amplitudes
-
-@param Sigma[] an array of doubles with the errors
+@param data a pointer to the prepared data set
 
 \return a double with the log likelihood
 
 */
-double like(int Nparam, double Aparam[], int Npts, double uCo[], double vCo[], double Vis[], double Sigma[])
+double like(int Nparam, double Aparam[], dataset *data)
 {
-  double result, chi2=0.0;
-  int index;
+  double result;
 
-  // penalize all negative fluxes and sigmas with a very small likelihood
-  if (Aparam[0]<0 || Aparam[1]<0 || Aparam[4]<0 || Aparam[5]<0)
+  // penalize parameters outside the support of the model (e.g., negative
+  // fluxes and sigmas) with a very small likelihood
+  if (!data->model->valid(Nparam,Aparam))
     {
       return -1.e34;
     }
   
-  for (index=1;index<=Npts;index++)      // for all data points
-    {
-      // calculate the difference between model and data
-      double variance=Vis[index-1]-model(uCo[index-1],vCo[index-1],Nparam,Aparam);
-      // add to chi2 value
-      chi2+=variance*variance/(Sigma[index-1]*Sigma[index-1]);
-    }
-
-  result=-chi2;
+  // chi2 over all data points (the padding does not contribute), and
+  // over the complex and closure terms if there are any
+  INSTR_LIKE_BEGIN(tlike);
+  if (data->Nterms>0)
+    result=-(chi2Terms(Nparam,Aparam,data)+data->chi2Offset);
+  else
+    result=-(chi2Pool(Nparam,Aparam,data)+data->chi2Offset);
+  INSTR_LIKE_END(tlike);
   /* FOR DEBUG ONLY
+  int index;
   for(index=1;index<=Nparam;index++)
     printf("%e\t%s",Aparam[index-1],(index==Nparam) ? "\n" : "");
   printf("%e\n",result);
@@ -190,25 +163,85 @@ double like(int Nparam, double Aparam[], int Npts, double uCo[], double vCo[], d
   return result;
 }
 
+/*!
+\brief 
+Calculates the likelihood, unless the chi-square exceeds a budget
+
+\details
+Adds up the chi-square of the model over blocks of EXITBLOCK data
+points, in order, and stops as soon as the partial sum exceeds
+chi2Max: every block adds a chi-square that is not negative, so that
+the full chi-square can only be larger still. This is the early exit
+of mhStep() for the proposals that cannot be accepted.
+
+If it does not stop, the result is the log likelihood like() returns,
+up to the rounding of sums over blocks rather than over all points in
+one pass; if it stops, it is an upper bound on the log likelihood.
+The blocks are summed by chi2Data(), in the precision of the data set.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre The data set has no complex or closure terms; it is called from
+mhStep() when data->earlyExit is set
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param chi2Max a double with the budget of the chi-square of the data points
+
+@param Nused a pointer to an int with the number of points (with the padding) summed on return, data->Npad unless it stopped
+
+\return a double with the log likelihood, or an upper bound on it
+
+*/
+double likeBudget(int Nparam, double Aparam[], dataset *data, double chi2Max, int *Nused)
+{
+  double chi2=0.0;
+  int first, last;
+
+  *Nused=data->Npad;
+  if (!data->model->valid(Nparam,Aparam))
+    return -1.e34;
+
+  INSTR_LIKE_BEGIN(tlike);
+  for (first=0;first<data->Npad;first=last)
+    {
+      last=(first+EXITBLOCK<data->Npad) ? first+EXITBLOCK : data->Npad;
+      chi2+=chi2Data(Nparam,Aparam,data,first,last);
+      if (chi2>chi2Max && last<data->Npad)
+	{
+	  *Nused=last;
+	  break;
+	}
+    }
+  INSTR_LIKE_END(tlike);
+  INSTR_EXIT(*Nused,data->Npad);
+
+  return -(chi2+data->chi2Offset);
+}
+
 /*!
 \brief 
 Calculates the posterior
 
 \details Given a number of parameters Nparam and their values stored
-in the array Aparam[] as well as a number of data points with
-coordinates stored in the arrays uCo[] and vCo[], visibility
-amplitudes stored in the array Vis[], and errors stored in the arrays
-Sigma[], it returns the log of the posterior probability for the
-underlying model.
+in the array Aparam[] as well as a data set prepared by prepareData(),
+it returns the log of the posterior probability for the underlying
+model.
 
 In this example the log posterior is equal to the sum of the log prior plus
 the log likelihood
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.1
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from walkers()
 
@@ -216,28 +249,231 @@ the log likelihood
 
 @param Aparam[] an array of doubles with the current values of the model parameters
 
-@param Npts an integer with the number of data points
+@param data a pointer to the prepared data set
 
-@param uCo[] an array of doubles with the u-coordinates of the data
+\return a double with the log likelihood
+
+*/
+double post(int Nparam, double Aparam[], dataset *data)
+{
+  double result;
+
+  result=prior(Nparam,Aparam,data)+like(Nparam,Aparam,data);
+  
+  return result;
+}
 
-@param vCo[] an array of doubles with the v-coordinates of the data
+/*!
+\brief 
+Calculates the posterior and its gradient
 
-@param Vis[] an array of doubles with the visibility amplitudes
+\details Given a number of parameters Nparam and their values stored
+in the array Aparam[] as well as a data set prepared by prepareData(),
+it returns the same log posterior as post() and stores its derivatives
+with respect to the parameters in gradient[]. The chi-square and its
+derivatives come from one pass of the gradient kernel of the model
+over the data points, which shares the transcendental functions
+between them.
 
-@param Sigma[] an array of doubles with the errors
+Outside the support of the model, it returns the same very small
+posterior as post() and a zero gradient.
 
-\return a double with the log likelihood
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre The model has a gradient kernel and the data set has no complex or
+closure terms; it is called from hmc()
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param gradient[] an array of doubles with the derivatives of the log posterior on return
+
+\return a double with the log posterior
 
 */
-double post(int Nparam, double Aparam[], int Npts, double uCo[], double vCo[], double Vis[], double Sigma[])
+double postGrad(int Nparam, double Aparam[], dataset *data, double gradient[])
 {
+  double dchi2[Nparam];
   double result;
+  int iparam;
+
+  if (!data->model->valid(Nparam,Aparam))
+    {
+      for (iparam=1;iparam<=Nparam;iparam++)
+	gradient[iparam-1]=0.0;
+      return -1.e34;
+    }
+
+  // the log likelihood is -chi2, as in like()
+  INSTR_LIKE_BEGIN(tlike);
+  result=data->model->priorGrad(Nparam,Aparam,gradient);
+  result-=data->model->grad(Nparam,Aparam,data,0,data->Npad,dchi2)+data->chi2Offset;
+  INSTR_LIKE_END(tlike);
+  for (iparam=1;iparam<=Nparam;iparam++)
+    gradient[iparam-1]-=dchi2[iparam-1];
 
-  result=prior(Nparam,Aparam)+like(Nparam,Aparam,Npts,uCo,vCo,Vis,Sigma);
-  
   return result;
 }
 
+#ifdef USE_GPU
+/*!
+\brief 
+Copies a data set to the memory of a GPU
+
+\details
+The precomputed arrays of the data set stay on the device for the
+rest of the run, so that postBatch() sends it only the parameter
+vectors of each batch (see likegpu.cu).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The data set has no complex or closure terms; it is called from
+main() in builds with USE_GPU, after binData() and setModel()
+
+@param data a pointer to the prepared data set
+
+\return zero if all was OK, ERROR_FILE if the model has no GPU kernel or the device failed
+
+*/
+int startGPU(dataset *data)
+{
+  data->gpu=gpuOpen(data->Npad,data->b02,data->uPh,data->vPh,data->Vis,data->invVar,data->model->name,data->model->Nparam);
+
+  return (data->gpu==NULL) ? ERROR_FILE : 0;
+}
+
+/*!
+\brief 
+Frees the memory of a data set on the GPU
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param data a pointer to the data set
+
+*/
+void stopGPU(dataset *data)
+{
+  gpuClose(data->gpu);
+  data->gpu=NULL;
+}
+
+/*!
+\brief 
+Calculates the posterior for a batch of parameter vectors on the GPU
+
+\details
+The same log posteriors as post(), with the priors and the support of
+the model evaluated on the host. Only the vectors in the support are
+sent to the device, which returns their chi-squares. If the device
+fails, the data set is released from it.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The data set was copied to the GPU by startGPU(); it is called from postBatch()
+
+@param Nbatch an int with the number of parameter vectors
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of Nbatch*Nparam doubles with the model parameters
+
+@param data a pointer to the prepared data set
+
+@param result[] an array of Nbatch doubles with the log posteriors on return
+
+\return zero if all was OK, ERROR_FILE if the device failed
+
+*/
+static int postBatchGPU(int Nbatch, int Nparam, double Aparam[], dataset *data, double result[])
+{
+  double packed[Nbatch*Nparam], chi2[Nbatch];
+  int valid[Nbatch];
+  int ibatch, Nvalid=0, status;
+
+  for (ibatch=1;ibatch<=Nbatch;ibatch++)
+    {
+      double *A=Aparam+(ibatch-1)*Nparam;
+      result[ibatch-1]=prior(Nparam,A,data);
+      if (data->model->valid(Nparam,A))
+	{
+	  memcpy(packed+Nvalid*Nparam,A,Nparam*sizeof(double));
+	  valid[Nvalid++]=ibatch-1;
+	}
+      else
+	result[ibatch-1]+=-1.e34;
+    }
+
+  INSTR_LIKE_BEGIN(tlike);
+  status=gpuChi2(data->gpu,Nvalid,packed,chi2);
+  INSTR_LIKE_END(tlike);
+  if (status!=0)
+    {
+      printf("Evaluating the likelihood on the CPU from now on\n");
+      stopGPU(data);
+      return ERROR_FILE;
+    }
+
+  for (ibatch=1;ibatch<=Nvalid;ibatch++)
+    result[valid[ibatch-1]]+=-(chi2[ibatch-1]+data->chi2Offset);
+
+  return 0;
+}
+#endif
+
+/*!
+\brief 
+Calculates the posterior for a batch of parameter vectors
+
+\details Given Nbatch sets of Nparam model parameters stored one after
+the other in the array Aparam[], it stores in result[] the log of the
+posterior probability of each set. This is the entry point for the
+samplers that evaluate many parameter vectors at once.
+
+In builds with USE_GPU, if the data set was copied to a GPU by
+startGPU(), the chi-squares of the whole batch are calculated there
+with one kernel launch (see postBatchGPU()); if the GPU fails, the
+batch and the rest of the run are evaluated on the CPU.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from ensemble()
+
+@param Nbatch an int with the number of parameter vectors
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of Nbatch*Nparam doubles with the model parameters
+
+@param data a pointer to the prepared data set
+
+@param result[] an array of Nbatch doubles with the log posteriors on return
+
+*/
+void postBatch(int Nbatch, int Nparam, double Aparam[], dataset *data, double result[])
+{
+  int ibatch;
+
+#ifdef USE_GPU
+  if (data->gpu!=NULL && postBatchGPU(Nbatch,Nparam,Aparam,data,result)==0)
+    return;
+#endif
+  for (ibatch=1;ibatch<=Nbatch;ibatch++)
+    result[ibatch-1]=post(Nparam,Aparam+(ibatch-1)*Nparam,data);
+}
+
 /*!
 \brief 
 Returns a value drawn from a Gaussian distribution
@@ -246,36 +482,644 @@ Returns a value drawn from a Gaussian distribution
 Returns a value drawn from a zero-centered Gaussian distribution of a 
 particular standard deviation sigma. 
 
-It uses the Box-Muller algorithm and the Mersenne-Twister
-random number generator. It presumes that the random number generator
-has already been seeded.
+It uses the polar Box-Muller algorithm and the Mersenne-Twister
+random number generator (see gaussFill()). It presumes that the random
+number generator has already been seeded.
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.2
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
-\pre It is called from walkers()
+\pre It is called from ensemble()
+
+@param mt a pointer to the state of the random number generator
 
 @param sigma a float with the standard deviation of the Gaussian.
 
 \return a double with the value drawn from the distribution
 
 */
-double gauss(double sigma)
+double gauss(mtState *mt, double sigma)
 {
-  double y1,y2,result;
+  double result;
 
-  // Box-Muller auxiliary variables
-  y1=randomMT()/(MTMAX*1.0)+0.5;     // hack for unsigned ints
-  y2=randomMT()/(MTMAX*1.0)+0.5;
+  gaussFill(mt,1,&result);
+  return sigma*result;
+}
 
-  //y1=rand()/(RAND_MAX+1.0);
-  //y2=rand()/(RAND_MAX+1.0);
-  
-  result=sigma*sqrt(-2.0*log(y1))*cos(2.0*M_PI*y2);
-  return result;
+/*!
+\brief 
+Fills an array with values drawn from a unit Gaussian distribution
+
+\details 
+Uses the polar (Marsaglia) form of the Box-Muller algorithm, which
+draws a point (y1,y2) uniformly in the unit circle and turns it into
+a pair of independent normal deviates with a single log and sqrt and
+no trigonometric functions. Both deviates of each pair are used; when
+Ngauss is odd, the second one of the last pair is kept in the state
+of the generator for the next call. The uniform deviates are drawn in
+blocks with fillMT(), in the same order as with uniform().
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from gauss(), mhStep() and blockStep()
+
+@param mt a pointer to the state of the random number generator
+
+@param Ngauss an int with the number of values to draw
+
+@param result[] an array of doubles with the values on return
+
+\return nothing
+
+*/
+void gaussFill(mtState *mt, int Ngauss, double result[])
+{
+  int index=1;
+  double y1, y2, rsq;
+
+  // first use up the deviate left over from the previous call
+  if (Ngauss>=1 && mt->hasGauss)
+    {
+      result[0]=mt->gaussSpare;
+      mt->hasGauss=0;
+      index=2;
+    }
+
+  while (index<=Ngauss)
+    {
+      // uniform deviates for all the pairs still needed, drawn as a block
+      int Npairs=(Ngauss-index)/2+1;
+      double ybuf[2*Npairs];
+      int ipair;
+
+      fillMT(mt,2*Npairs,ybuf);
+
+      for (ipair=1;ipair<=Npairs;ipair++)
+	{
+	  // a point uniformly distributed in the unit circle, or a rejection
+	  y1=2.0*ybuf[2*ipair-2]-1.0;
+	  y2=2.0*ybuf[2*ipair-1]-1.0;
+	  rsq=y1*y1+y2*y2;
+	  if (rsq>=1.0 || rsq==0.0)
+	    continue;
+
+	  double factor=sqrt(-2.0*log(rsq)/rsq);
+
+	  result[index-1]=y1*factor;
+	  if (index<Ngauss)
+	    result[index]=y2*factor;
+	  else
+	    {
+	      mt->gaussSpare=y2*factor;
+	      mt->hasGauss=1;
+	    }
+	  index+=2;
+	}
+    }
+}
+
+/*!
+\brief 
+Returns a value drawn from a uniform distribution
+
+\details 
+Returns a value drawn from a uniform distribution in the open interval
+(0,1), using the Mersenne-Twister random number generator: the 32-bit
+integer k maps to (k+1/2)/2^32, so that the result is never zero and
+its logarithm is always finite. It presumes that the random number
+generator has already been seeded.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from ensemble()
+
+@param mt a pointer to the state of the random number generator
+
+\return a double with the value drawn from the distribution
+
+*/
+double uniform(mtState *mt)
+{
+  return (randomMT(mt)+0.5)*(1.0/4294967296.0);
+}
+
+/*!
+\brief 
+Sets up the state of a Metropolis chain
+
+\details 
+Allocates the arrays of the chain, starts it at the parameters
+Aparam[], calculates the prior, likelihood and posterior there, and
+seeds the random number generator of the chain.
+
+The chain samples the tempered distribution prior*likelihood^beta;
+beta=1 gives the posterior. For PROPOSAL_BLOCK, the cache of the
+model components is also allocated and filled at Aparam[], which
+needs a model with the blocks of modelCache and data with amplitudes
+only; for PROPOSAL_ADAPTIVE, the running moments of the chain are allocated and
+the caller sets the number of adapting links in chain->Nadapt.
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() and multichain()
+
+@param chain a pointer to the chain to set up
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial values of the model parameters
+
+@param dev[] an array of doubles with the standard deviations of Gaussian steps for each model parameter
+
+@param beta a double with the inverse temperature of the chain
+
+@param seed the seed for the random number generator of the chain
+
+@param proposal an int with the kind of steps, PROPOSAL_FULL or PROPOSAL_BLOCK
+
+@param data a pointer to the data set prepared by prepareData()
+
+\return zero if all was OK, ERROR_FILE if an allocation failed or the
+model cannot take block steps
+
+*/
+int initChain(chainState *chain, int Nparam, double Aparam[], double dev[], double beta, uint32 seed, int proposal, dataset *data)
+{
+  int iparam;
+
+  if (proposal==PROPOSAL_BLOCK && (data->model->Nblocks!=MODELNBLOCKS || data->Nterms>0))
+    {
+      printf("The model %s cannot take block steps with these data\n",data->model->name);
+      return ERROR_FILE;
+    }
+
+  chain->Nparam=Nparam;
+  chain->proposal=proposal;
+  chain->iblock=0;
+  chain->cache=NULL;
+  chain->Nlinks=0;
+  chain->Nadapt=0;
+  chain->Nfactor=0;
+  chain->mean=chain->M2=chain->chol=NULL;
+  chain->Aparam=malloc(Nparam*sizeof(double));
+  chain->AparamPlusOne=malloc(Nparam*sizeof(double));
+  chain->AparamMax=malloc(Nparam*sizeof(double));
+  chain->dev=malloc(Nparam*sizeof(double));
+
+  if (chain->Aparam==NULL || chain->AparamPlusOne==NULL || chain->AparamMax==NULL || chain->dev==NULL)
+    {
+      printf("Error allocating memory for a chain\n");
+      freeChain(chain);
+      return ERROR_FILE;
+    }
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      chain->Aparam[iparam-1]=Aparam[iparam-1];
+      chain->AparamMax[iparam-1]=Aparam[iparam-1];
+      chain->dev[iparam-1]=dev[iparam-1];
+    }
+
+  chain->data=data;
+  chain->beta=beta;
+  chain->accept=0;
+
+  // block steps need the components of the model at the initial parameters
+  if (proposal==PROPOSAL_BLOCK)
+    {
+      chain->cache=malloc(sizeof(modelCache));
+      if (chain->cache==NULL || initCache(chain->cache,data)!=0)
+	{
+	  free(chain->cache);
+	  chain->cache=NULL;
+	  freeChain(chain);
+	  return ERROR_FILE;
+	}
+      fillCache(chain->cache,Nparam,chain->Aparam,data);
+    }
+
+  // adaptive steps need the running moments of the chain
+  if (proposal==PROPOSAL_ADAPTIVE)
+    {
+      chain->mean=calloc(Nparam+2*Nparam*Nparam,sizeof(double));
+      if (chain->mean==NULL)
+	{
+	  printf("Error allocating memory for a chain\n");
+	  freeChain(chain);
+	  return ERROR_FILE;
+	}
+      chain->M2=chain->mean+Nparam;
+      chain->chol=chain->M2+Nparam*Nparam;
+    }
+
+  // calculate the posterior for the initial parameters
+  chain->priorpre=prior(Nparam,chain->Aparam,data);
+  chain->likepre=like(Nparam,chain->Aparam,data);
+  chain->probpre=chain->priorpre+beta*chain->likepre;
+  chain->postMax=-1.e34;
+
+  seedMT(&chain->rng,seed);            // start the random number generator
+
+  return 0;
+}
+
+/*!
+\brief 
+Frees the arrays of a Metropolis chain
+
+\version 1.2
+
+\date Oct 14, 2026
+
+@param chain a pointer to the chain
+
+*/
+void freeChain(chainState *chain)
+{
+  free(chain->Aparam);
+  free(chain->AparamPlusOne);
+  free(chain->AparamMax);
+  free(chain->dev);
+
+  if (chain->cache!=NULL)
+    {
+      freeCache(chain->cache);
+      free(chain->cache);
+      chain->cache=NULL;
+    }
+
+  // the moments and the Cholesky factor share one allocation
+  free(chain->mean);
+  chain->mean=chain->M2=chain->chol=NULL;
+
+  chain->Aparam=chain->AparamPlusOne=chain->AparamMax=chain->dev=NULL;
+}
+
+/*!
+\brief 
+Calculates the Cholesky factor of a symmetric matrix
+
+\details 
+Factors the Nparam x Nparam matrix A (stored by rows) as L L^T, with L
+lower triangular, in place of the array L[].
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from adaptChain()
+
+@param Nparam an int with the dimension of the matrix
+
+@param A[] an array of doubles with the matrix
+
+@param L[] an array of doubles with the factor on return
+
+\return zero if all was OK, one if the matrix is not positive definite
+
+*/
+static int cholesky(int Nparam, double A[], double L[])
+{
+  int irow, icol, index;
+
+  for (irow=1;irow<=Nparam;irow++)
+    for (icol=1;icol<=Nparam;icol++)
+      {
+	if (icol>irow)
+	  {
+	    L[(irow-1)*Nparam+icol-1]=0.0;
+	    continue;
+	  }
+
+	double sum=A[(irow-1)*Nparam+icol-1];
+	for (index=1;index<icol;index++)
+	  sum-=L[(irow-1)*Nparam+index-1]*L[(icol-1)*Nparam+index-1];
+
+	if (icol==irow)
+	  {
+	    if (sum<=0.0)
+	      return 1;
+	    L[(irow-1)*Nparam+icol-1]=sqrt(sum);
+	  }
+	else
+	  L[(irow-1)*Nparam+icol-1]=sum/L[(icol-1)*Nparam+icol-1];
+      }
+
+  return 0;
+}
+
+/*!
+\brief 
+Updates the proposal of an adaptive Metropolis chain
+
+\details 
+Adds the current position of the chain to its running mean and sum of
+squared deviations with a Welford (rank-1) update, and every
+ADAPT_REFACTOR links after the first ADAPT_START it factors the
+proposal covariance of Haario et al. (2001),
+
+C = 2.38^2/Nparam (Cov + ADAPT_EPS diag(dev^2)),
+
+where Cov is the covariance of the chain so far. If the factorization
+fails, the previous proposal is kept. After chain->Nadapt links the
+proposal is frozen, so that the rest of the chain is Markovian.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from mhStep() after every link of a PROPOSAL_ADAPTIVE chain
+
+@param chain a pointer to the chain
+
+*/
+static void adaptChain(chainState *chain)
+{
+  int Nparam=chain->Nparam;
+  int iparam, jparam;
+  double delta[Nparam];
+  long Nlinks=++chain->Nlinks;
+
+  if (Nlinks>chain->Nadapt)
+    return;
+
+  // rank-1 update of the mean and of the sum of squared deviations
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      delta[iparam-1]=chain->Aparam[iparam-1]-chain->mean[iparam-1];
+      chain->mean[iparam-1]+=delta[iparam-1]/Nlinks;
+    }
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=1;jparam<=Nparam;jparam++)
+      chain->M2[(iparam-1)*Nparam+jparam-1]+=delta[iparam-1]*(chain->Aparam[jparam-1]-chain->mean[jparam-1]);
+
+  if (Nlinks<ADAPT_START || Nlinks%ADAPT_REFACTOR!=0)
+    return;
+
+  // the scaled and regularized covariance of the chain so far
+  double cov[Nparam*Nparam];
+  double factor[Nparam*Nparam];
+  double scale=2.38*2.38/Nparam;
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=1;jparam<=Nparam;jparam++)
+      {
+	cov[(iparam-1)*Nparam+jparam-1]=scale*chain->M2[(iparam-1)*Nparam+jparam-1]/(Nlinks-1.0);
+	if (iparam==jparam)
+	  cov[(iparam-1)*Nparam+jparam-1]+=scale*ADAPT_EPS*chain->dev[iparam-1]*chain->dev[iparam-1];
+      }
+
+  if (cholesky(Nparam,cov,factor)==0)
+    {
+      for (iparam=1;iparam<=Nparam*Nparam;iparam++)
+	chain->chol[iparam-1]=factor[iparam-1];
+      chain->Nfactor++;
+    }
+}
+
+/*!
+\brief 
+Advances a Metropolis chain by one link
+
+\details 
+Takes a Gaussian step of width dev[] in each parameter and accepts it
+with the Metropolis condition on the tempered posterior. On
+acceptance, the chain moves to the new position and the most likely
+model is updated if needed.
+
+For PROPOSAL_ADAPTIVE, once the covariance of the chain has been
+factored (see adaptChain()), the step is instead a correlated
+multivariate Gaussian L z, with z a vector of unit normal deviates.
+
+With data->earlyExit, the uniform deviate of the Metropolis condition
+is drawn first and turned into the largest chi-square with which the
+step could be accepted, so that likeBudget() can stop summing the
+chi-square of a step that is sure to be rejected. A step that is not
+stopped is decided by the same test as without it.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from chainStep()
+
+@param chain a pointer to the chain, set up with initChain()
+
+\return one if the step was accepted, zero otherwise
+
+*/
+int mhStep(chainState *chain)
+{
+  int Nparam=chain->Nparam;
+  int iparam, jparam;
+  int accepted=0;
+
+  double zdev[Nparam];                 // unit normal deviates of the step
+  gaussFill(&chain->rng,Nparam,zdev);
+
+  if (chain->Nfactor>0)
+    {
+      // take a correlated step with the adapted covariance
+      for (iparam=1;iparam<=Nparam;iparam++)
+	{
+	  double step=0.0;
+	  for (jparam=1;jparam<=iparam;jparam++)
+	    step+=chain->chol[(iparam-1)*Nparam+jparam-1]*zdev[jparam-1];
+	  chain->AparamPlusOne[iparam-1]=chain->Aparam[iparam-1]+step;
+	}
+    }
+  else
+    {
+      // take a Gaussian step in each parameter
+      for (iparam=1;iparam<=Nparam;iparam++)
+	{
+	  chain->AparamPlusOne[iparam-1]=chain->Aparam[iparam-1]+chain->dev[iparam-1]*zdev[iparam-1];
+	}
+    }
+
+  // draw a random number of 0 to 1 (before the posterior, which
+  // draws none, so that the stream is the same either way)
+  double probRandom=uniform(&chain->rng);
+
+  // calculate the posterior for the new set of model parameters
+  double priorpost=prior(Nparam,chain->AparamPlusOne,chain->data);
+  double likepost;
+  int Nused=chain->data->Npad;
+  if (chain->data->earlyExit)
+    {
+      // the step can only be accepted with a chi-square within the budget;
+      // the slack leaves the close calls to the full test below
+      double chi2Max=(priorpost-chain->probpre-log(probRandom))/chain->beta-chain->data->chi2Offset;
+      chi2Max+=EXITMARGIN*(fabs(chi2Max)+1.0);
+      likepost=likeBudget(Nparam,chain->AparamPlusOne,chain->data,chi2Max,&Nused);
+    }
+  else
+    likepost=like(Nparam,chain->AparamPlusOne,chain->data);
+  double probpost=priorpost+chain->beta*likepost;
+
+  // if the chi-square was summed over all points and the MCMC
+  // condition is satisfied
+  if (Nused==chain->data->Npad && probpost>=chain->probpre+log(probRandom))
+    {
+      // update the model parameters
+      for (iparam=1;iparam<=Nparam;iparam++)
+	{
+	  chain->Aparam[iparam-1]=chain->AparamPlusOne[iparam-1];
+	}
+      chain->priorpre=priorpost;
+      chain->likepre=likepost;
+      chain->probpre=probpost;
+
+      // and add one to the acceptance counter
+      chain->accept+=1;
+
+      // check if this is the most likely value
+      if (priorpost+likepost>chain->postMax)
+	{
+	  for (iparam=1;iparam<=Nparam;iparam++)
+	    {
+	      chain->AparamMax[iparam-1]=chain->Aparam[iparam-1];
+	    }
+	  chain->postMax=priorpost+likepost;
+	}
+      accepted=1;
+    }
+
+  // learn the covariance of the proposal during burn-in
+  if (chain->proposal==PROPOSAL_ADAPTIVE)
+    adaptChain(chain);
+
+  return accepted;
+}
+
+/*!
+\brief 
+Advances a Metropolis chain by one link in one block of parameters
+
+\details 
+Takes a Gaussian step of width dev[] in the two parameters of the
+current block only, and accepts it with the Metropolis condition on
+the tempered posterior. The likelihood is calculated from the cached
+components of the model, so that only the terms of the changed block
+are re-evaluated (see chi2Block()), plus the chi-square of the points
+within their bins, as in like(). The blocks are visited in turn, one
+per link.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from chainStep(); the chain was set up with PROPOSAL_BLOCK
+
+@param chain a pointer to the chain, set up with initChain()
+
+\return one if the step was accepted, zero otherwise
+
+*/
+int blockStep(chainState *chain)
+{
+  int Nparam=chain->Nparam;
+  int iblock=chain->iblock;
+  int iparam;
+  double likepost;
+
+  chain->iblock=(iblock+1)%MODELNBLOCKS;
+
+  // take a Gaussian step in the parameters of the block only
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      chain->AparamPlusOne[iparam-1]=chain->Aparam[iparam-1];
+    }
+  double zdev[2];                      // unit normal deviates of the step
+  gaussFill(&chain->rng,2,zdev);
+  for (iparam=2*iblock+1;iparam<=2*iblock+2;iparam++)
+    {
+      chain->AparamPlusOne[iparam-1]=chain->Aparam[iparam-1]+chain->dev[iparam-1]*zdev[iparam-2*iblock-1];
+    }
+
+  // calculate the posterior for the new set of model parameters,
+  // with the same penalty for negative fluxes and sigmas as like()
+  double *Aplus=chain->AparamPlusOne;
+  double priorpost=prior(Nparam,Aplus,chain->data);
+  if (!chain->data->model->valid(Nparam,Aplus))
+    likepost=-1.e34;
+  else
+    likepost=-(chi2Block(chain->cache,iblock,Nparam,Aplus,chain->data)+chain->data->chi2Offset);
+  double probpost=priorpost+chain->beta*likepost;
+
+  // draw a random number of 0 to 1
+  double probRandom=uniform(&chain->rng);
+
+  // if the MCMC condition is satisfied
+  if (probpost>=chain->probpre+log(probRandom))
+    {
+      // update the model parameters and their cached components
+      for (iparam=2*iblock+1;iparam<=2*iblock+2;iparam++)
+	{
+	  chain->Aparam[iparam-1]=chain->AparamPlusOne[iparam-1];
+	}
+      if (likepost>-1.e34)
+	acceptBlock(chain->cache,iblock);
+      else
+	fillCache(chain->cache,Nparam,chain->Aparam,chain->data);
+      chain->priorpre=priorpost;
+      chain->likepre=likepost;
+      chain->probpre=probpost;
+
+      // and add one to the acceptance counter
+      chain->accept+=1;
+
+      // check if this is the most likely value
+      if (priorpost+likepost>chain->postMax)
+	{
+	  for (iparam=1;iparam<=Nparam;iparam++)
+	    {
+	      chain->AparamMax[iparam-1]=chain->Aparam[iparam-1];
+	    }
+	  chain->postMax=priorpost+likepost;
+	}
+      return 1;
+    }
+
+  return 0;
+}
+
+/*!
+\brief 
+Advances a chain by one link with the steps it was set up for
+
+\details
+Every link starts a new step of the generator of the chain (see
+nextStepMT()), so that with Philox streams its random numbers depend
+only on the seed of the chain and on the number of the link.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() and multichain()
+
+@param chain a pointer to the chain, set up with initChain()
+
+\return one if the step was accepted, zero otherwise
+
+*/
+int chainStep(chainState *chain)
+{
+  nextStepMT(&chain->rng);
+
+  if (chain->proposal==PROPOSAL_BLOCK)
+    return blockStep(chain);
+
+  return mhStep(chain);
 }
 
 /*!
@@ -285,16 +1129,40 @@ Runs an MCMC chain
 \details 
 Runs an MCMC chain
 
+Every Ncheckpoint links, the chain file is flushed to disk and the
+state of the chain is saved in the checkpoint file fname.ckpt (see
+writeCheckpoint()), with record->summary if there is one. If restart
+is nonzero and that file exists, the chain continues from the
+checkpoint instead of from Aparam[], exactly as if it had not been
+interrupted, the chain file is appended to and the summary takes up
+the links before the checkpoint.
+
+The links after the first Nadapt (the burn-in) feed the convergence
+diagnostics of diagnostics.c. Every conv->Ncheck links, the chain
+stops early if the stopping rule of conv is met; at the end, conv
+holds the final diagnostics and the number of links run.
+
+Only the links after record->Nburn are recorded, thinned by
+record->thin in the file and all of them in record->summary if
+there is one (see recordLink()).
+
+With -DINSTRUMENT, the loop is timed and the acceptance ratio followed
+in windows of links (see instrument.h).
+
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.11
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from main()
 
 @param fname a string with the filename where to record the chains
 
+@param format an int with the format of the file, CHAIN_TEXT or CHAIN_NPY
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
 @param Nchains an int with the length of the chain to be calculated
 
 @param Nparam an int with the number of model parameters
@@ -303,108 +1171,114 @@ Runs an MCMC chain
 
 @param dev[] an array of doubles with the standard deviations of Gaussian steps for each model parameter
 
-@param Npts an integer with the number of data points
+@param proposal an int with the kind of steps, PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
 
-@param uCo[] an array of doubles with the u-coordinates of the data
+@param Nadapt an int with the number of links of burn-in over which a PROPOSAL_ADAPTIVE chain adapts
 
-@param vCo[] an array of doubles with the v-coordinates of the data
+@param Ncheckpoint an int with the number of links between checkpoints, or 0 for none
 
-@param Vis[] an array of doubles with the visibility amplitudes
+@param restart an int; if nonzero, continue from the checkpoint if there is one
 
-@param Sigma[] an array of doubles with the errors
+@param seed a uint32 with the seed of the random numbers of the chain
+
+@param record a pointer to the rule of the links recorded in the file and the summary
+
+@param conv a pointer to the stopping rule, and the diagnostics on return
+
+@param data a pointer to the data set prepared by prepareData()
 
 \return a double with the acceptance ratio for this chain; also on
 return, the array Aparam[] will have the model parameters of the most
 likely model.
 
 */
-double walkers(char fname[], int Nchain, int Nparam, double Aparam[], double dev[], int Npts, double uCo[], double vCo[], double Vis[], double Sigma[])
+double walkers(char fname[], int format, char *names[], int Nchain, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, int Ncheckpoint, int restart, uint32 seed, chainRecord *record, convergence *conv, dataset *data)
 {
-  FILE *chainfile;                     // file to record MCMC chains
+  chainWriter chainfile;               // file to record MCMC chains
+  char ckptname[FILENAME_MAX];         // file with the checkpoint
   
-  int ichain;                          // index counting chain links
+  long ichain;                         // index counting chain links
   int iparam;                          // index counting parameters
-  int index;                           // generic index
+  long Ndone=0, Nrows, offset;         // position of the checkpoint
+  int status;
   
-  double AparamPlusOne[Nparam];        // temporary storage of new model parameters
-
-  double AparamMax[Nparam];            // parameters of most likely model
-  double postMax=-1.e34;               // maximum posterior
-  
-  int accept=0;                        // initialize number of accepted MCMC points
+  chainState chain;                    // the state of the chain
+  chainStats stats;                    // running sums of the diagnostics
+
+  // set up the chain at the initial parameters
+  if (initChain(&chain,Nparam,Aparam,dev,1.0,seed,proposal,data)!=0)
+    return ERROR_FILE;
+  chain.Nadapt=Nadapt;
+  if (initStats(&stats,Nparam)!=0)
+    {
+      freeChain(&chain);
+      return ERROR_FILE;
+    }
 
-  // calculate the posterior for the initial parameters
-  double probpre=post(Nparam,Aparam,Npts,uCo,vCo,Vis,Sigma);
+  snprintf(ckptname,sizeof(ckptname),"%s.ckpt",fname);
 
-  // open file to output MCMC chain
-  if ((chainfile=fopen(fname,"w"))==NULL)
+  // open file to output MCMC chain, or continue it from the checkpoint
+  if (restart && readCheckpoint(ckptname,&chain,&stats,record->summary,&Ndone,&Nrows,&offset)==0)
+    {
+      printf("Restarting from %s after %ld links\n",ckptname,Ndone);
+      status=appendChain(&chainfile,fname,format,Nparam,0,recordedLinks(record,Nchain),names,seed,Nrows,offset);
+    }
+  else
     {
-      printf("Error opening file %s for writing\n",fname);
+      if (restart)
+	printf("No checkpoint %s, starting a new chain\n",ckptname);
+      status=openChain(&chainfile,fname,format,Nparam,0,recordedLinks(record,Nchain),names,seed);
+    }
+  if (status!=0)
+    {
+      freeStats(&stats);
+      freeChain(&chain);
       return ERROR_FILE;
     }
   
-  
-  seedMT(SEEDNO);                      // start the random number generator
-  //  srand(100);
-
-  for (ichain=1;ichain<=Nchain;ichain++)
+  INSTR_RUN_BEGIN();
+  for (ichain=Ndone+1;ichain<=Nchain;ichain++)
     {
-      // take a Gaussian step in each parameter
-      for (iparam=1;iparam<=Nparam;iparam++)
-	{
-	  AparamPlusOne[iparam-1]=Aparam[iparam-1]+gauss(dev[iparam-1]);
-	}
+      // take a Metropolis step
+      chainStep(&chain);
+      INSTR_ACCEPT(ichain,Nchain,chain.accept);
 
-      // calculate the posterior for the new set of model parameters
-      double probpost=post(Nparam,AparamPlusOne,Npts,uCo,vCo,Vis,Sigma);
-      
-      // draw a random number of 0 to 1
-      double probRandom=randomMT()/(MTMAX*1.0)+0.5;      // hack for unsigned ints
-      //      double probRandom=rand()/(RAND_MAX+1.0);
+      // record the chain
+      recordLink(&chainfile,record,ichain,chain.Aparam);
 
-      // if the MCMC condition is satisfied
-      if (probpost>=probpre+log(probRandom))
+      // follow the convergence after burn-in, and stop once it is reached
+      if (ichain>Nadapt)
 	{
-	  // update the model parameters
-	  for (iparam=1;iparam<=Nparam;iparam++)
+	  addStats(&stats,chain.Aparam);
+	  if (conv->essTarget>0.0 && conv->Ncheck>0 && (ichain-Nadapt)%conv->Ncheck==0 && checkConvergence(1,&stats,conv))
 	    {
-	      Aparam[iparam-1]=AparamPlusOne[iparam-1];
+	      ichain++;
+	      break;
 	    }
-	  // and add one to the acceptance counter
-	  accept+=1;
-	  // check if this is the most likely value
-	  if (probpost>postMax)
-	    {
-	      for (iparam=1;iparam<=Nparam;iparam++)
-		{
-		  AparamMax[iparam-1]=Aparam[iparam-1];
-		}
-	      postMax=probpost;
-	    }
-	}
-      else // otherwise
-	{
-	  // do nothing
 	}
 
-      // record the chain
-      for(index=1;index<=Nparam;index++)
-	fprintf(chainfile,"%e\t%s",Aparam[index-1],(index==Nparam) ? "\n" : "");
-
-      
+      // save the state of the chain along with all the links so far
+      if (Ncheckpoint>0 && ichain%Ncheckpoint==0 && flushChain(&chainfile,&offset)==0)
+	writeCheckpoint(ckptname,&chain,&stats,record->summary,ichain,chainfile.Ntotal,offset);
     }
+  conv->Nlinks=ichain-1;
+  checkConvergence(1,&stats,conv);
 
   // close file with chains
-  fclose(chainfile);
+  closeChain(&chainfile);
+  INSTR_RUN_END();
   
   // return the most likely model values
   for (iparam=1;iparam<=Nparam;iparam++)
     {
-      Aparam[iparam-1]=AparamMax[iparam-1];
+      Aparam[iparam-1]=chain.AparamMax[iparam-1];
     }
   
   // calculate and return the acceptance ratio
-  double acceptance=accept/(1.0*Nchain);
+  double acceptance=chain.accept/(1.0*conv->Nlinks);
+
+  freeStats(&stats);
+  freeChain(&chain);
   return acceptance;
 
 }
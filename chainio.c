@@ -0,0 +1,649 @@
+/*! \file
+  \brief
+  File with subroutines to record MCMC chains
+
+  \details
+  The chains are recorded through a chainWriter, either as ASCII text
+  (one line per link, as in the original chains.dat) or in binary.
+
+  The binary format is a NumPy .npy file (version 1.0) with a 2D array
+  of little-endian doubles, one row per link, so that the chains can
+  be read in python with np.load() or memory-mapped with
+  np.load(fname,mmap_mode='r'). The header dictionary is followed by a
+  python comment with the metadata of the run, e.g.,
+
+  {'descr': '<f8', 'fortran_order': False, 'shape': (50000, 6), } # mcmc Nparam=6 Nchain=50000 seed=4357 names=F1,sigma1,x2,y2,F2,sigma2
+
+  which np.load() ignores. The number of rows in 'shape' is updated when
+  the file is closed, so that it is always equal to the number of links
+  recorded.
+
+  The rows are collected in a large in-memory buffer and written out
+  in blocks.
+
+  A chain can be flushed to disk at any point with flushChain(), which
+  returns the length of the file so far, and reopened later with
+  appendChain() to continue from there, e.g., after a restart from a
+  checkpoint.
+
+  If the format is combined with CHAIN_ASYNC, the formatting and
+  writing happen in a separate I/O thread: the sampler fills blocks of
+  rows in a ring of CHAINNBLOCKS slots and publishes each completed
+  block to the I/O thread through a lock-free single-producer,
+  single-consumer queue (the two counters head and tail). The sampler
+  only waits if all slots are waiting to be written, so that a slow
+  filesystem does not stall the chain.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<sched.h>
+#include<pthread.h>
+#include<unistd.h>
+#include<sys/types.h>
+
+#include "mcmc.h"
+#include "instrument.h"
+
+#define CHAINBUFSIZE (1<<20)       // size in bytes of the output buffers
+#define NPYHEADERMAX 4096          // max length of the .npy header
+
+#define CHAINBLOCKSIZE (1<<18)     // size in bytes of each slot
+#define CHAINSPIN 64               // polls of the ring before the I/O thread sleeps
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+static const char npyMagic[]="\x93NUMPY";
+
+/*!
+\brief
+Builds the header of a binary chain file
+
+\details
+Writes in header[] the complete .npy header (magic string, version,
+header length and the padded dictionary) for a file with Nrows rows.
+The width of the row count is fixed, so that the header has the same
+length for any number of rows and can be rewritten in place.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param writer a pointer to the chain writer
+
+@param Nrows a long with the number of rows to record in the header
+
+@param header a string of length NPYHEADERMAX with the header on return
+
+\return an int with the length of the header in bytes, or zero if it does not fit
+
+*/
+static int npyHeader(chainWriter *writer, long Nrows, char header[])
+{
+  char dict[NPYHEADERMAX];
+  int Ndict, Ntotal, index;
+
+  Ndict=snprintf(dict,NPYHEADERMAX,
+		 "{'descr': '<f8', 'fortran_order': False, 'shape': (%20ld, %d), } "
+		 "# mcmc Nparam=%d Nchain=%ld seed=%u names=%s",
+		 Nrows,writer->Ncol,writer->Nparam,writer->Nchain,writer->seed,writer->names);
+
+  // magic (6) + version (2) + length (2) + dict + newline, padded to 64 bytes
+  Ntotal=((10+Ndict+1+63)/64)*64;
+  if (Ndict>=NPYHEADERMAX || Ntotal>NPYHEADERMAX || Ntotal-10>0xFFFF)
+    return 0;
+
+  memcpy(header,npyMagic,6);
+  header[6]=1;                         // major version
+  header[7]=0;                         // minor version
+  header[8]=(Ntotal-10)&0xFF;          // header length, little endian
+  header[9]=((Ntotal-10)>>8)&0xFF;
+  memcpy(header+10,dict,Ndict);
+  for (index=10+Ndict;index<Ntotal-1;index++)
+    header[index]=' ';
+  header[Ntotal-1]='\n';
+
+  return Ntotal;
+}
+
+/*!
+\brief
+Writes rows to the file of a chain
+
+\details
+Formats the Nrows rows in rows[] as text, or writes them in binary
+(after converting them to little endian, if needed, in place).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param writer a pointer to the chain writer
+
+@param rows[] an array of Nrows*Ncol doubles with the rows
+
+@param Nrows an int with the number of rows
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+static int writeRows(chainWriter *writer, double rows[], int Nrows)
+{
+  int Nvalues=Nrows*writer->Ncol;
+  int irow, index;
+
+  if (writer->format==CHAIN_NPY)
+    {
+      // the .npy data are little endian
+      union { unsigned int word; unsigned char byte[4]; } probe={1};
+      if (probe.byte[0]==0)
+	for (index=1;index<=Nvalues;index++)
+	  {
+	    unsigned char *byte=(unsigned char *)&rows[index-1], aux;
+	    int ibyte;
+	    for (ibyte=0;ibyte<4;ibyte++)
+	      {
+		aux=byte[ibyte];
+		byte[ibyte]=byte[7-ibyte];
+		byte[7-ibyte]=aux;
+	      }
+	  }
+
+      if (Nvalues>0 && fwrite(rows,sizeof(double),Nvalues,writer->file)!=(size_t)Nvalues)
+	{
+	  printf("Error writing to chain file\n");
+	  return ERROR_FILE;
+	}
+      return 0;
+    }
+
+  for (irow=1;irow<=Nrows;irow++)
+    {
+      double *row=rows+(irow-1)*writer->Ncol;
+      for(index=1;index<=writer->Nparam;index++)
+	fprintf(writer->file,"%e\t%s",row[index-1],(index==writer->Ncol) ? "\n" : "");
+      for(index=writer->Nparam+1;index<=writer->Ncol;index++)
+	fprintf(writer->file,"%d%s",(int)row[index-1],(index==writer->Ncol) ? "\n" : "\t");
+    }
+
+  return 0;
+}
+
+/*!
+\brief
+The I/O thread of an asynchronous chain writer
+
+\details
+Waits for blocks to be published in the ring, writes them out in
+order and hands their slots back to the sampler. It polls the ring
+CHAINSPIN times before sleeping briefly, and exits once the writer
+is closed and the ring is empty.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is started in a thread by openChain()
+
+@param arg a pointer to the chain writer
+
+\return NULL
+
+*/
+static void *runWriter(void *arg)
+{
+  chainWriter *writer=(chainWriter *)arg;
+  struct timespec nap={0,50000};       // 50 microseconds
+  int spin=0;
+
+  while (1)
+    {
+      long tail=atomic_load_explicit(&writer->tail,memory_order_relaxed);
+
+      if (tail<atomic_load_explicit(&writer->head,memory_order_acquire))
+	{
+	  int slot=tail%CHAINNBLOCKS;
+	  if (writeRows(writer,writer->blocks+slot*writer->Nbuf*writer->Ncol,writer->blockRows[slot])!=0)
+	    writer->status=ERROR_FILE;
+	  atomic_store_explicit(&writer->tail,tail+1,memory_order_release);
+	  spin=0;
+	}
+      else if (atomic_load_explicit(&writer->done,memory_order_acquire))
+	{
+	  // the last block is published before done is set
+	  if (tail==atomic_load_explicit(&writer->head,memory_order_acquire))
+	    break;
+	}
+      else if (++spin<CHAINSPIN)
+	sched_yield();
+      else
+	nanosleep(&nap,NULL);
+    }
+
+  return NULL;
+}
+
+/*!
+\brief
+Publishes the current block of an asynchronous chain writer
+
+\details
+Hands the block being filled over to the I/O thread and waits, if
+needed, until the next slot of the ring is free.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param writer a pointer to the chain writer
+
+*/
+static void publishBlock(chainWriter *writer)
+{
+  long head=atomic_load_explicit(&writer->head,memory_order_relaxed);
+
+  writer->blockRows[head%CHAINNBLOCKS]=writer->Nrows;
+  atomic_store_explicit(&writer->head,head+1,memory_order_release);
+  writer->Nrows=0;
+
+  // wait for the slot of the next block to be written out
+  while (head+1-atomic_load_explicit(&writer->tail,memory_order_acquire)>=CHAINNBLOCKS)
+    sched_yield();
+  writer->buffer=writer->blocks+((head+1)%CHAINNBLOCKS)*writer->Nbuf*writer->Ncol;
+}
+
+/*!
+\brief
+Sets up a chain writer on a new or an existing file
+
+\details
+Shared by openChain() and appendChain(), with the same parameters: if
+offset is negative, the file is created anew; otherwise the existing
+file is truncated to offset bytes, which hold Nrows rows, and the
+writer continues after them.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from openChain() and appendChain()
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+static int startChain(chainWriter *writer, char fname[], int format, int Nparam, int Nextra, long Nchain, char *names[], uint32 seed, long Nrows, long offset)
+{
+  char header[NPYHEADERMAX];
+  int icol, Nheader;
+  char *mode=(offset<0) ? "w" : "r+";
+
+  writer->format=format & ~CHAIN_ASYNC;
+  writer->async=(format & CHAIN_ASYNC) ? 1 : 0;
+  writer->Nparam=Nparam;
+  writer->Ncol=Nparam+Nextra;
+  writer->Nchain=Nchain;
+  writer->seed=seed;
+  writer->Nrows=0;
+  writer->Ntotal=(offset<0) ? 0 : Nrows;
+  writer->buffer=NULL;
+  writer->blocks=NULL;
+  writer->textbuf=NULL;
+  writer->status=0;
+
+  // comma separated column names for the metadata
+  writer->names[0]='\0';
+  for (icol=1;icol<=writer->Ncol;icol++)
+    {
+      char aux[32];
+      if (names!=NULL && names[icol-1]!=NULL)
+	snprintf(aux,sizeof(aux),"%s",names[icol-1]);
+      else
+	snprintf(aux,sizeof(aux),"p%d",icol-1);
+      if (strlen(writer->names)+strlen(aux)+2<sizeof(writer->names))
+	{
+	  if (icol>1)
+	    strcat(writer->names,",");
+	  strcat(writer->names,aux);
+	}
+    }
+
+  if ((writer->file=fopen(fname,mode))==NULL)
+    {
+      printf("Error opening file %s for writing\n",fname);
+      return ERROR_FILE;
+    }
+
+  if (writer->format==CHAIN_TEXT)
+    {
+      // let stdio collect the formatted lines in a large buffer
+      writer->textbuf=malloc(CHAINBUFSIZE);
+      if (writer->textbuf!=NULL)
+	setvbuf(writer->file,writer->textbuf,_IOFBF,CHAINBUFSIZE);
+    }
+
+  if (offset>=0)
+    {
+      // drop anything recorded after the point to continue from
+      if (fseeko(writer->file,0,SEEK_END)!=0 || ftello(writer->file)<offset
+	  || ftruncate(fileno(writer->file),offset)!=0 || fseeko(writer->file,offset,SEEK_SET)!=0)
+	{
+	  printf("Error: chain file %s is shorter than its checkpoint\n",fname);
+	  fclose(writer->file);
+	  free(writer->textbuf);
+	  return ERROR_FILE;
+	}
+    }
+  else if (writer->format==CHAIN_NPY)
+    {
+      Nheader=npyHeader(writer,0,header);
+      if (Nheader==0 || fwrite(header,1,Nheader,writer->file)!=(size_t)Nheader)
+	{
+	  printf("Error setting up binary chain file %s\n",fname);
+	  fclose(writer->file);
+	  return ERROR_FILE;
+	}
+    }
+
+  if (writer->async)
+    {
+      // the ring of blocks shared with the I/O thread
+      writer->Nbuf=CHAINBLOCKSIZE/(writer->Ncol*sizeof(double));
+      if (writer->Nbuf<1)
+	writer->Nbuf=1;
+      writer->blocks=malloc(CHAINNBLOCKS*writer->Nbuf*writer->Ncol*sizeof(double));
+      writer->buffer=writer->blocks;
+      atomic_init(&writer->head,0);
+      atomic_init(&writer->tail,0);
+      atomic_init(&writer->done,0);
+
+      if (writer->blocks==NULL || pthread_create(&writer->thread,NULL,runWriter,writer)!=0)
+	{
+	  printf("Error starting the I/O thread for %s, writing synchronously\n",fname);
+	  free(writer->blocks);
+	  writer->blocks=NULL;
+	  writer->async=0;
+	}
+    }
+
+  if (!writer->async && writer->format==CHAIN_NPY)
+    {
+      writer->Nbuf=CHAINBUFSIZE/(writer->Ncol*sizeof(double));
+      if (writer->Nbuf<1)
+	writer->Nbuf=1;
+      writer->buffer=malloc(writer->Nbuf*writer->Ncol*sizeof(double));
+      if (writer->buffer==NULL)
+	{
+	  printf("Error allocating the buffer for %s\n",fname);
+	  fclose(writer->file);
+	  free(writer->textbuf);
+	  return ERROR_FILE;
+	}
+    }
+
+  return 0;
+}
+
+/*!
+\brief
+Opens a file to record an MCMC chain
+
+\details
+Opens the file fname for writing in the given format and sets up the
+output buffer. Each row of the chain has Nparam parameter values
+followed by Nextra extra columns (e.g., the walker index of the
+ensemble sampler), which are integers in the text format.
+
+If format includes CHAIN_ASYNC, an I/O thread is started to do the
+writing; if that fails, the file is written synchronously.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from the samplers in chain.c, ensemble.c and multichain.c
+
+@param writer a pointer to the chain writer to set up
+
+@param fname a string with the filename
+
+@param format an int with the format, CHAIN_TEXT or CHAIN_NPY, possibly combined with CHAIN_ASYNC
+
+@param Nparam an int with the number of model parameters
+
+@param Nextra an int with the number of extra columns
+
+@param Nchain a long with the expected number of rows, recorded in the metadata
+
+@param names[] an array of Nparam+Nextra strings with the column names, or NULL
+
+@param seed the seed of the random number generator, recorded in the metadata
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int openChain(chainWriter *writer, char fname[], int format, int Nparam, int Nextra, long Nchain, char *names[], uint32 seed)
+{
+  return startChain(writer,fname,format,Nparam,Nextra,Nchain,names,seed,0,-1);
+}
+
+/*!
+\brief
+Reopens the file of an MCMC chain to continue recording it
+
+\details
+Like openChain(), but for a file written earlier with the same
+parameters: the first Nrows rows, which take offset bytes as returned
+by flushChain(), are kept and anything after them is discarded, so
+that the new rows follow on from there.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() on a restart from a checkpoint
+
+@param writer a pointer to the chain writer to set up
+
+@param fname a string with the filename
+
+@param format an int with the format, CHAIN_TEXT or CHAIN_NPY, possibly combined with CHAIN_ASYNC
+
+@param Nparam an int with the number of model parameters
+
+@param Nextra an int with the number of extra columns
+
+@param Nchain a long with the expected number of rows, recorded in the metadata
+
+@param names[] an array of Nparam+Nextra strings with the column names, or NULL
+
+@param seed the seed of the random number generator, recorded in the metadata
+
+@param Nrows a long with the number of rows to keep
+
+@param offset a long with the length in bytes of those rows, including any header
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int appendChain(chainWriter *writer, char fname[], int format, int Nparam, int Nextra, long Nchain, char *names[], uint32 seed, long Nrows, long offset)
+{
+  return startChain(writer,fname,format,Nparam,Nextra,Nchain,names,seed,Nrows,offset);
+}
+
+/*!
+\brief
+Records one row of an MCMC chain
+
+\details
+With -DINSTRUMENT, the time it takes is that of the I/O of the run.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+@param writer a pointer to the chain writer
+
+@param row[] an array of doubles with the Nparam parameters and the extra columns
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int writeChain(chainWriter *writer, double row[])
+{
+  int result=0;
+
+  INSTR_IO_BEGIN(tio);
+  writer->Ntotal++;
+
+  // synchronous text goes straight to the stdio buffer
+  if (!writer->async && writer->format==CHAIN_TEXT)
+    result=writeRows(writer,row,1);
+  else
+    {
+      memcpy(writer->buffer+writer->Nrows*writer->Ncol,row,writer->Ncol*sizeof(double));
+      if (++writer->Nrows==writer->Nbuf)
+	{
+	  if (writer->async)
+	    publishBlock(writer);
+	  else
+	    {
+	      result=writeRows(writer,writer->buffer,writer->Nrows);
+	      writer->Nrows=0;
+	    }
+	}
+    }
+  INSTR_IO_END(tio);
+
+  return result;
+}
+
+/*!
+\brief
+Writes all the rows of an MCMC chain recorded so far to disk
+
+\details
+Writes out any buffered rows, waits for the I/O thread to write all
+the published blocks, updates the header of a binary file and syncs
+the file, so that the rows survive the end of the process. The length
+of the file is returned in offset, for appendChain().
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() before a checkpoint
+
+@param writer a pointer to the chain writer
+
+@param offset a pointer to a long with the length of the file on return
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int flushChain(chainWriter *writer, long *offset)
+{
+  char header[NPYHEADERMAX];
+  int result=0, Nheader;
+
+  if (writer->async)
+    {
+      if (writer->Nrows>0)
+	publishBlock(writer);
+      while (atomic_load_explicit(&writer->tail,memory_order_acquire)<atomic_load_explicit(&writer->head,memory_order_relaxed))
+	sched_yield();
+      result=writer->status;
+    }
+  else if (writer->format==CHAIN_NPY)
+    {
+      result=writeRows(writer,writer->buffer,writer->Nrows);
+      writer->Nrows=0;
+    }
+
+  *offset=ftello(writer->file);
+
+  if (writer->format==CHAIN_NPY)
+    {
+      Nheader=npyHeader(writer,writer->Ntotal,header);
+      if (fseeko(writer->file,0,SEEK_SET)!=0 || fwrite(header,1,Nheader,writer->file)!=(size_t)Nheader
+	  || fseeko(writer->file,*offset,SEEK_SET)!=0)
+	result=ERROR_FILE;
+    }
+
+  if (fflush(writer->file)!=0 || fsync(fileno(writer->file))!=0)
+    result=ERROR_FILE;
+
+  if (result!=0)
+    printf("Error flushing the chain file\n");
+
+  return result;
+}
+
+/*!
+\brief
+Closes the file of an MCMC chain
+
+\details
+Writes out any buffered rows, waits for the I/O thread to finish if
+there is one and, for the binary format, rewrites the header with the
+number of rows recorded. With -DINSTRUMENT, the time it takes is
+that of the I/O of the run, as for writeChain().
+
+\version 1.2
+
+\date Oct 14, 2026
+
+@param writer a pointer to the chain writer
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int closeChain(chainWriter *writer)
+{
+  char header[NPYHEADERMAX];
+  int result=0, Nheader;
+
+  INSTR_IO_BEGIN(tio);
+  if (writer->async)
+    {
+      if (writer->Nrows>0)
+	publishBlock(writer);
+      atomic_store_explicit(&writer->done,1,memory_order_release);
+      pthread_join(writer->thread,NULL);
+      result=writer->status;
+    }
+  else if (writer->format==CHAIN_NPY)
+    result=writeRows(writer,writer->buffer,writer->Nrows);
+
+  if (writer->format==CHAIN_NPY)
+    {
+      Nheader=npyHeader(writer,writer->Ntotal,header);
+      if (fseek(writer->file,0L,SEEK_SET)!=0 || fwrite(header,1,Nheader,writer->file)!=(size_t)Nheader)
+	{
+	  printf("Error updating the header of the chain file\n");
+	  result=ERROR_FILE;
+	}
+    }
+
+  if (fclose(writer->file)!=0)
+    result=ERROR_FILE;
+  INSTR_IO_END(tio);
+
+  if (writer->async)
+    free(writer->blocks);
+  else
+    free(writer->buffer);
+  free(writer->textbuf);
+  writer->buffer=NULL;
+  writer->blocks=NULL;
+  writer->textbuf=NULL;
+
+  return result;
+}
@@ -0,0 +1,340 @@
+/*! \file
+  \brief
+  File with subroutines to checkpoint and restart an MCMC chain
+
+  \details
+  A checkpoint is a compact binary snapshot of everything that
+  determines the rest of a chain: the position, posterior and best
+  model of the chain, its counters, the moments of an adaptive
+  proposal, the running sums of its convergence diagnostics and the
+  state of its random number generator (the full state vector of a
+  Mersenne Twister, or only the key and the counter of a Philox
+  stream) and the streaming summary of its links, if there is one,
+  along with the number of links done and the length of the chain file
+  at that point. A chain restarted from a checkpoint continues exactly
+  as the uninterrupted chain would have, its file is truncated to the
+  links recorded before the checkpoint and appended to from there, and
+  its summary covers the links before the checkpoint too.
+
+  The snapshot is written to a temporary file that is synced and then
+  renamed over the previous checkpoint, so that an interruption at any
+  point leaves a complete checkpoint behind.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+
+#include "mcmc.h"
+
+#define CKPTMAGIC "MCMCCKPT"          // identifies a checkpoint file
+#define CKPTORDER 0x01020304U        // identifies the byte order of the checkpoint
+#define CKPTVERSION 4                // version of the layout below
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+The header of a checkpoint file
+
+\details
+The header is followed by the Nparam values of Aparam[] and of
+AparamMax[], then, for PROPOSAL_ADAPTIVE, the Nparam values of the
+running mean and the Nparam*Nparam values of its sum of squares and
+of the Cholesky factor, then, for a Mersenne Twister, the MTLENGTH+1
+words of the state of the random number generator (the header holds
+the whole state of a Philox stream), the (2*NBATCHMAX+3)*Nparam running
+sums of the diagnostics and finally, if there is a summary, its
+Nblock doubles and Ncounts longs (see initSummary()), all in the byte
+order of the machine that wrote them.
+
+*/
+typedef struct
+{
+  char magic[8];                       //!< CKPTMAGIC
+  unsigned int order;                  //!< CKPTORDER, as written by the machine
+  int version;                         //!< CKPTVERSION
+  int Nparam;                          //!< number of model parameters
+  int proposal;                        //!< kind of steps of the chain
+  long long Ndone;                     //!< number of links done
+  long long Nrows;                     //!< number of rows in the chain file
+  long long offset;                    //!< length in bytes of the chain file
+
+  double priorpre;                     //!< log prior at the current position
+  double likepre;                      //!< log likelihood at the current position
+  double probpre;                      //!< tempered log posterior at the current position
+  double postMax;                      //!< maximum log posterior so far
+  double beta;                         //!< inverse temperature
+  long long accept;                    //!< number of accepted steps
+  int iblock;                          //!< block of the next block step
+  int Nfactor;                         //!< factorizations of the adaptive covariance
+  long long Nlinks;                    //!< links seen by the adaptation
+  long long Nadapt;                    //!< links over which the proposal adapts
+
+  int mtNext;                          //!< offset of the next value in the state vector
+  int mtLeft;                          //!< values left before reloading
+  int hasGauss;                        //!< if 1, gaussSpare is valid
+  double gaussSpare;                   //!< leftover normal deviate
+  int philox;                          //!< if 1, the generator is a Philox stream
+  unsigned int key[2];                 //!< key of the Philox stream
+  unsigned long long step;             //!< step of its counter
+  unsigned int block;                  //!< next block of the step
+  int nout;                            //!< numbers of the previous block left to draw
+
+  long long Nsamples;                  //!< links added to the diagnostics
+  long long batchSize;                 //!< links per batch of the diagnostics
+  long long Ncurrent;                  //!< links in the current batch
+  int Nbatches;                        //!< full batches of the diagnostics
+
+  int Nbins;                           //!< bins of the histograms of the summary, 0 for none
+  long long summaryLinks;              //!< links added to the summary
+} ckptHeader;
+
+/*!
+\brief
+Writes a checkpoint of an MCMC chain
+
+\details
+Saves the state of the chain and of its diagnostics after Ndone links,
+when its file holds Nrows rows in offset bytes (see flushChain()), in
+the file fname, along with the summary of its links if summary is not
+NULL. The counter of a Philox stream is only written for one.
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() after flushChain()
+
+@param fname a string with the filename of the checkpoint
+
+@param chain a pointer to the chain
+
+@param stats a pointer to the running sums of the diagnostics of the chain
+
+@param summary a pointer to the summary of the links of the chain, or NULL
+
+@param Ndone a long with the number of links done
+
+@param Nrows a long with the number of rows in the chain file
+
+@param offset a long with the length in bytes of the chain file
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int writeCheckpoint(char fname[], chainState *chain, chainStats *stats, chainSummary *summary, long Ndone, long Nrows, long offset)
+{
+  char tmpname[FILENAME_MAX];
+  FILE *ckpt_file;
+  ckptHeader header;
+  int Nparam=chain->Nparam;
+  int result=0;
+
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,CKPTMAGIC,8);
+  header.order=CKPTORDER;
+  header.version=CKPTVERSION;
+  header.Nparam=Nparam;
+  header.proposal=chain->proposal;
+  header.Ndone=Ndone;
+  header.Nrows=Nrows;
+  header.offset=offset;
+  header.priorpre=chain->priorpre;
+  header.likepre=chain->likepre;
+  header.probpre=chain->probpre;
+  header.postMax=chain->postMax;
+  header.beta=chain->beta;
+  header.accept=chain->accept;
+  header.iblock=chain->iblock;
+  header.Nfactor=chain->Nfactor;
+  header.Nlinks=chain->Nlinks;
+  header.Nadapt=chain->Nadapt;
+  header.mtNext=(chain->rng.philox) ? 0 : (int)(chain->rng.next-chain->rng.state);
+  header.mtLeft=chain->rng.left;
+  header.hasGauss=chain->rng.hasGauss;
+  header.gaussSpare=chain->rng.gaussSpare;
+  header.philox=chain->rng.philox;
+  if (chain->rng.philox)
+    {
+      header.key[0]=chain->rng.key[0];
+      header.key[1]=chain->rng.key[1];
+      header.step=chain->rng.step;
+      header.block=chain->rng.block;
+      header.nout=chain->rng.nout;
+    }
+  header.Nsamples=stats->Nsamples;
+  header.batchSize=stats->batchSize;
+  header.Ncurrent=stats->Ncurrent;
+  header.Nbatches=stats->Nbatches;
+  if (summary!=NULL)
+    {
+      header.Nbins=summary->Nbins;
+      header.summaryLinks=summary->Nlinks;
+    }
+
+  if (snprintf(tmpname,sizeof(tmpname),"%s.tmp",fname)>=(int)sizeof(tmpname))
+    return ERROR_FILE;
+  if ((ckpt_file=fopen(tmpname,"wb"))==NULL)
+    {
+      printf("Error opening file %s for writing\n",tmpname);
+      return ERROR_FILE;
+    }
+
+  if (fwrite(&header,sizeof(header),1,ckpt_file)!=1 ||
+      fwrite(chain->Aparam,sizeof(double),Nparam,ckpt_file)!=(size_t)Nparam ||
+      fwrite(chain->AparamMax,sizeof(double),Nparam,ckpt_file)!=(size_t)Nparam)
+    result=ERROR_FILE;
+  if (result==0 && chain->proposal==PROPOSAL_ADAPTIVE &&
+      fwrite(chain->mean,sizeof(double),Nparam+2*Nparam*Nparam,ckpt_file)!=(size_t)(Nparam+2*Nparam*Nparam))
+    result=ERROR_FILE;
+  if (result==0 && !chain->rng.philox && fwrite(chain->rng.state,sizeof(uint32),MTLENGTH+1,ckpt_file)!=MTLENGTH+1)
+    result=ERROR_FILE;
+  if (result==0 && fwrite(stats->block,sizeof(double),(2*NBATCHMAX+3)*Nparam,ckpt_file)!=(size_t)((2*NBATCHMAX+3)*Nparam))
+    result=ERROR_FILE;
+  if (result==0 && summary!=NULL &&
+      (fwrite(summary->block,sizeof(double),summary->Nblock,ckpt_file)!=(size_t)summary->Nblock ||
+       fwrite(summary->counts,sizeof(long),summary->Ncounts,ckpt_file)!=(size_t)summary->Ncounts))
+    result=ERROR_FILE;
+
+  // the checkpoint must be on disk before it replaces the previous one
+  if (result==0 && (fflush(ckpt_file)!=0 || fsync(fileno(ckpt_file))!=0))
+    result=ERROR_FILE;
+  if (fclose(ckpt_file)!=0)
+    result=ERROR_FILE;
+
+  if (result!=0 || rename(tmpname,fname)!=0)
+    {
+      printf("Error writing checkpoint file %s\n",fname);
+      remove(tmpname);
+      return ERROR_FILE;
+    }
+
+  return 0;
+}
+
+/*!
+\brief
+Restores an MCMC chain from a checkpoint
+
+\details
+Reads the checkpoint file fname written by writeCheckpoint() into a
+chain that was set up with initChain() for the same number of
+parameters and kind of steps, and into the running sums of its
+diagnostics, set up with initStats(), and into the summary of its
+links, set up with initSummary() for the same number of bins, or NULL
+if there is none. For block steps, the cache of the model components
+is recalculated at the restored position. The checkpoint must come
+from the same kind of generator as the chain, and have a summary if
+and only if the chain does.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() on a restart
+
+@param fname a string with the filename of the checkpoint
+
+@param chain a pointer to the chain, set up with initChain()
+
+@param stats a pointer to the running sums of the diagnostics of the chain
+
+@param summary a pointer to the summary of the links of the chain, set up with initSummary(), or NULL
+
+@param Ndone a pointer to a long with the number of links done on return
+
+@param Nrows a pointer to a long with the number of rows in the chain file on return
+
+@param offset a pointer to a long with the length in bytes of the chain file on return
+
+\return zero if all was OK, ERROR_FILE if there is no matching checkpoint
+
+*/
+int readCheckpoint(char fname[], chainState *chain, chainStats *stats, chainSummary *summary, long *Ndone, long *Nrows, long *offset)
+{
+  FILE *ckpt_file;
+  ckptHeader header;
+  int Nparam=chain->Nparam;
+  int result=0;
+
+  if ((ckpt_file=fopen(fname,"rb"))==NULL)
+    return ERROR_FILE;
+
+  if (fread(&header,sizeof(header),1,ckpt_file)!=1 ||
+      memcmp(header.magic,CKPTMAGIC,8)!=0 || header.order!=CKPTORDER ||
+      header.version!=CKPTVERSION || header.Nparam!=Nparam || header.proposal!=chain->proposal ||
+      header.mtNext<0 || header.mtNext>MTLENGTH || header.philox!=chain->rng.philox ||
+      (header.philox && (header.nout<0 || header.nout>4)) || header.Nbatches<0 || header.Nbatches>=NBATCHMAX ||
+      header.Nbins!=((summary!=NULL) ? summary->Nbins : 0))
+    {
+      printf("Checkpoint file %s does not match the chain\n",fname);
+      fclose(ckpt_file);
+      return ERROR_FILE;
+    }
+
+  if (fread(chain->Aparam,sizeof(double),Nparam,ckpt_file)!=(size_t)Nparam ||
+      fread(chain->AparamMax,sizeof(double),Nparam,ckpt_file)!=(size_t)Nparam)
+    result=ERROR_FILE;
+  if (result==0 && chain->proposal==PROPOSAL_ADAPTIVE &&
+      fread(chain->mean,sizeof(double),Nparam+2*Nparam*Nparam,ckpt_file)!=(size_t)(Nparam+2*Nparam*Nparam))
+    result=ERROR_FILE;
+  if (result==0 && !chain->rng.philox && fread(chain->rng.state,sizeof(uint32),MTLENGTH+1,ckpt_file)!=MTLENGTH+1)
+    result=ERROR_FILE;
+  if (result==0 && fread(stats->block,sizeof(double),(2*NBATCHMAX+3)*Nparam,ckpt_file)!=(size_t)((2*NBATCHMAX+3)*Nparam))
+    result=ERROR_FILE;
+  if (result==0 && summary!=NULL &&
+      (fread(summary->block,sizeof(double),summary->Nblock,ckpt_file)!=(size_t)summary->Nblock ||
+       fread(summary->counts,sizeof(long),summary->Ncounts,ckpt_file)!=(size_t)summary->Ncounts))
+    result=ERROR_FILE;
+  fclose(ckpt_file);
+
+  if (result!=0)
+    {
+      printf("Error reading checkpoint file %s\n",fname);
+      return ERROR_FILE;
+    }
+
+  chain->priorpre=header.priorpre;
+  chain->likepre=header.likepre;
+  chain->probpre=header.probpre;
+  chain->postMax=header.postMax;
+  chain->beta=header.beta;
+  chain->accept=header.accept;
+  chain->iblock=header.iblock;
+  chain->Nfactor=header.Nfactor;
+  chain->Nlinks=header.Nlinks;
+  chain->Nadapt=header.Nadapt;
+  chain->rng.next=chain->rng.state+header.mtNext;
+  chain->rng.left=header.mtLeft;
+  if (chain->rng.philox)
+    {
+      chain->rng.key[0]=header.key[0];
+      chain->rng.key[1]=header.key[1];
+      seekPhilox(&chain->rng,header.step,header.block,header.nout);
+    }
+  chain->rng.hasGauss=header.hasGauss;
+  chain->rng.gaussSpare=header.gaussSpare;
+  stats->Nsamples=header.Nsamples;
+  stats->batchSize=header.batchSize;
+  stats->Ncurrent=header.Ncurrent;
+  stats->Nbatches=header.Nbatches;
+  if (summary!=NULL)
+    summary->Nlinks=header.summaryLinks;
+
+  if (chain->cache!=NULL)
+    fillCache(chain->cache,Nparam,chain->Aparam,chain->data);
+
+  *Ndone=header.Ndone;
+  *Nrows=header.Nrows;
+  *offset=header.offset;
+
+  return 0;
+}
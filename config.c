@@ -0,0 +1,498 @@
+/*! \file
+  \brief
+  subroutine(s) to set up a run from a configuration file and the command line
+
+  \details
+  All the settings of a run (file names, model, initial parameters,
+  sampler, chain lengths, seed, ...) are held in a runConfig, which
+  starts from the defaults of defaultConfig() and is then changed by
+  the arguments of the command line, in order:
+
+  -c file      reads the settings of a configuration file
+  key=value    sets a single setting (also --key=value)
+  -h           lists the settings with their current values
+
+  A configuration file has one "key = value" per line; empty lines and
+  everything after a '#' are ignored. The keys are those of the table
+  configKeys below, e.g.
+
+  filename = synth_data.dat
+  sampler = multi          # mh, ensemble, multi, mpi or nuts
+  Nchain = 100000
+  init = 4 5 -12 13 1.1 3
+
+  Later settings override earlier ones, so a command line like
+  "./mcmc -c sweep.cfg seed=7" runs the configuration with another seed.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<stddef.h>
+
+#include "mcmc.h"
+
+#define LINELENGTH 4096            // max length of a line of a configuration file
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+#define CONFIG_INT 0               // an int
+#define CONFIG_DOUBLE 1            // a double
+#define CONFIG_STRING 2            // a string of CONFIGNAMELENGTH
+#define CONFIG_CHOICE 3            // an int, given by name or by number
+#define CONFIG_SEED 4              // a uint32
+#define CONFIG_LIST 5              // the initial parameters
+
+// names of the choices, in the order of their values in mcmc.h
+static char *samplerNames[]={"mh","ensemble","multi","mpi","nuts",NULL};
+static char *proposalNames[]={"full","block","adaptive",NULL};
+static char *formatNames[]={"text","npy",NULL};
+static char *precisionNames[]={"double","single","validate",NULL};
+static char *rngNames[]={"mt","philox",NULL};
+
+/*!
+\brief
+A setting of a runConfig
+
+*/
+typedef struct
+{
+  char *key;                     //!< name of the setting
+  int type;                      //!< CONFIG_INT, CONFIG_DOUBLE, ...
+  size_t offset;                 //!< offset of the setting in the runConfig
+  char **choices;                //!< names of the values of a CONFIG_CHOICE
+  char *help;                    //!< one-line description
+} configKey;
+
+#define KEY(name,type,choices,help) {#name,type,offsetof(runConfig,name),choices,help}
+
+static configKey configKeys[]={
+  KEY(filename,CONFIG_STRING,NULL,"file with the data"),
+  KEY(closurefname,CONFIG_STRING,NULL,"file with complex and closure terms (empty for none)"),
+  KEY(chainfname,CONFIG_STRING,NULL,"file with the chains (empty for chains.dat or chains.npy)"),
+  KEY(modelfname,CONFIG_STRING,NULL,"file with the best-fit model"),
+  KEY(logfname,CONFIG_STRING,NULL,"file with the log of the run"),
+  KEY(manifest,CONFIG_STRING,NULL,"if set, fit every data set listed in it (see batch.c)"),
+  KEY(model,CONFIG_STRING,NULL,"model fit to the data (see models.c)"),
+  KEY(init,CONFIG_LIST,NULL,"initial parameters (empty for those of the model)"),
+  KEY(frac,CONFIG_DOUBLE,NULL,"width of the steps, as a fraction of each initial parameter"),
+  KEY(seed,CONFIG_SEED,NULL,"seed of the random numbers"),
+  KEY(rng,CONFIG_CHOICE,rngNames,"generator: mt (Mersenne Twister) or philox (counter-based streams)"),
+  KEY(verbose,CONFIG_INT,NULL,"if 1, write the log of the run"),
+  KEY(dataCache,CONFIG_INT,NULL,"if 1, keep a binary cache of the data"),
+  KEY(binSize,CONFIG_DOUBLE,NULL,"if >=0, merge the points in (u,v) cells of this size"),
+  KEY(Nchain,CONFIG_INT,NULL,"number of chain links"),
+  KEY(sampler,CONFIG_CHOICE,samplerNames,"sampler: mh, ensemble, multi, mpi or nuts"),
+  KEY(format,CONFIG_CHOICE,formatNames,"format of the chains file: text or npy"),
+  KEY(async,CONFIG_INT,NULL,"if 1, write the chains from an I/O thread"),
+  KEY(proposal,CONFIG_CHOICE,proposalNames,"steps of the mh/multi chains: full, block or adaptive"),
+  KEY(Nadapt,CONFIG_INT,NULL,"burn-in links, left out of the diagnostics (-1 for Nchain/5)"),
+  KEY(Nburn,CONFIG_INT,NULL,"first links (ensemble steps) left out of the chains file and the summary"),
+  KEY(thin,CONFIG_INT,NULL,"record every thin-th link after them (0 for none)"),
+  KEY(summaryfname,CONFIG_STRING,NULL,"file with the streaming summary of the links (empty for none)"),
+  KEY(Nbins,CONFIG_INT,NULL,"bins of the histograms of the summary"),
+  KEY(Ncheckpoint,CONFIG_INT,NULL,"mh links between checkpoints (0 for none)"),
+  KEY(restart,CONFIG_INT,NULL,"if 1, continue the mh chain from its last checkpoint"),
+  KEY(Nwalkers,CONFIG_INT,NULL,"number of walkers of the ensemble sampler (even, at least twice the parameters)"),
+  KEY(Nchains,CONFIG_INT,NULL,"number of chains (threads) of the multi sampler"),
+  KEY(tempering,CONFIG_INT,NULL,"if 1, the multi/mpi chains form a tempering ladder"),
+  KEY(Tmax,CONFIG_DOUBLE,NULL,"highest temperature of the ladder"),
+  KEY(Nswap,CONFIG_INT,NULL,"chain links between swap proposals"),
+  KEY(Nleapfrog,CONFIG_INT,NULL,"leapfrog steps of the nuts links (0 for NUTS, >0 for plain HMC)"),
+  KEY(likeThreads,CONFIG_INT,NULL,"helper threads for the chi-square (-1 for the free cores)"),
+  KEY(likeNmin,CONFIG_INT,NULL,"data points from which the helper threads are used"),
+  KEY(earlyExit,CONFIG_INT,NULL,"if 1, stop the chi-square of sure mh rejections early (no helper threads)"),
+  KEY(precision,CONFIG_CHOICE,precisionNames,"chi-square of the amplitudes: double, single or validate (single against double)"),
+  KEY(gpu,CONFIG_INT,NULL,"if 1, evaluate the walkers of the ensemble sampler on a GPU (make gpu)"),
+  KEY(batchThreads,CONFIG_INT,NULL,"threads fitting the manifest (0 for one per core)"),
+  KEY(optStarts,CONFIG_INT,NULL,"if >0, starts of a Nelder-Mead search for the best fit before sampling"),
+  KEY(optThreads,CONFIG_INT,NULL,"threads of the search (0 for one per core)"),
+  KEY(optScale,CONFIG_DOUBLE,NULL,"spread of the starts of the search, as a fraction of each initial parameter"),
+  KEY(optNmax,CONFIG_INT,NULL,"evaluations of the posterior per start of the search"),
+  KEY(essTarget,CONFIG_DOUBLE,NULL,"stop once every ESS exceeds this (0 for never)"),
+  KEY(rhatTarget,CONFIG_DOUBLE,NULL,"... and every split R-hat is below this"),
+  KEY(Ncheck,CONFIG_INT,NULL,"links between checks of the stopping rule"),
+  {NULL,0,0,NULL,NULL}
+};
+
+/*!
+\brief
+Sets a runConfig to the defaults of a run
+
+\version 1.5
+
+\date Oct 14, 2026
+
+@param cfg a pointer to the runConfig
+
+*/
+void defaultConfig(runConfig *cfg)
+{
+  memset(cfg,0,sizeof(runConfig));
+
+  snprintf(cfg->filename,CONFIGNAMELENGTH,"synth_data.dat");
+  snprintf(cfg->modelfname,CONFIGNAMELENGTH,"model.dat");
+  snprintf(cfg->logfname,CONFIGNAMELENGTH,"mcmc.log");
+  snprintf(cfg->model,CONFIGNAMELENGTH,DEFAULT_MODEL);
+  cfg->Ninit=0;
+  cfg->frac=0.01;
+  cfg->seed=SEEDNO;
+  cfg->rng=RNG_MT;
+  cfg->verbose=1;
+
+  cfg->dataCache=0;
+  cfg->binSize=-1.;
+
+  cfg->Nchain=50000;
+  cfg->sampler=SAMPLER_MH;
+  cfg->format=CHAIN_TEXT;
+  cfg->async=0;
+  cfg->proposal=PROPOSAL_FULL;
+  cfg->Nadapt=-1;
+  cfg->Nburn=0;
+  cfg->thin=1;
+  cfg->Nbins=50;
+  cfg->Ncheckpoint=10000;
+  cfg->restart=0;
+
+  cfg->Nwalkers=32;
+  cfg->Nchains=4;
+  cfg->tempering=0;
+  cfg->Tmax=10.;
+  cfg->Nswap=100;
+  cfg->Nleapfrog=0;
+
+  cfg->likeThreads=-1;
+  cfg->likeNmin=65536;
+  cfg->earlyExit=0;
+  cfg->precision=PRECISION_DOUBLE;
+  cfg->gpu=0;
+  cfg->batchThreads=0;
+
+  cfg->optStarts=0;
+  cfg->optThreads=0;
+  cfg->optScale=0.1;
+  cfg->optNmax=20000;
+
+  cfg->essTarget=0.;
+  cfg->rhatTarget=1.01;
+  cfg->Ncheck=1000;
+}
+
+// parses a whole int, returning 0 if the string is not one
+static int parseInt(char value[], long *result)
+{
+  char *end;
+
+  *result=strtol(value,&end,10);
+  return (end!=value && *end=='\0');
+}
+
+/*!
+\brief
+Changes one setting of a runConfig
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param cfg a pointer to the runConfig
+
+@param key a string with the name of the setting
+
+@param value a string with its new value, without surrounding blanks
+
+\return zero if all was OK, ERROR_FILE if the key or the value is not valid
+
+*/
+int setConfig(runConfig *cfg, char key[], char value[])
+{
+  configKey *entry;
+  char *field=(char *)cfg, *end;
+  long number;
+  int index;
+
+  for (entry=configKeys;entry->key!=NULL;entry++)
+    if (strcmp(entry->key,key)==0)
+      break;
+  if (entry->key==NULL)
+    {
+      printf("Unknown setting %s\n",key);
+      return ERROR_FILE;
+    }
+  field+=entry->offset;
+
+  switch (entry->type)
+    {
+    case CONFIG_INT:
+      if (!parseInt(value,&number))
+	break;
+      *(int *)field=(int)number;
+      return 0;
+
+    case CONFIG_SEED:
+      if (!parseInt(value,&number) || number<0)
+	break;
+      *(uint32 *)field=(uint32)number;
+      return 0;
+
+    case CONFIG_DOUBLE:
+      *(double *)field=strtod(value,&end);
+      if (end==value || *end!='\0')
+	break;
+      return 0;
+
+    case CONFIG_STRING:
+      if (strlen(value)>=CONFIGNAMELENGTH)
+	break;
+      snprintf(field,CONFIGNAMELENGTH,"%s",value);
+      return 0;
+
+    case CONFIG_CHOICE:
+      for (index=1;entry->choices[index-1]!=NULL;index++)
+	if (strcmp(entry->choices[index-1],value)==0)
+	  {
+	    *(int *)field=index-1;
+	    return 0;
+	  }
+      if (!parseInt(value,&number) || number<0 || number>=index-1)
+	break;
+      *(int *)field=(int)number;
+      return 0;
+
+    case CONFIG_LIST:
+      for (cfg->Ninit=0;*value!='\0';cfg->Ninit++)
+	{
+	  if (cfg->Ninit==CONFIGMAXPARAM)
+	    break;
+	  cfg->init[cfg->Ninit]=strtod(value,&end);
+	  if (end==value)
+	    break;
+	  for (value=end;*value==' ' || *value=='\t' || *value==',';value++)
+	    ;
+	}
+      if (*value!='\0')
+	break;
+      return 0;
+    }
+
+  printf("Invalid value %s of the setting %s\n",value,key);
+  return ERROR_FILE;
+}
+
+// strips the blanks around a string, in place
+static char *strip(char *string)
+{
+  char *end;
+
+  while (*string==' ' || *string=='\t')
+    string++;
+  end=string+strlen(string);
+  while (end>string && (end[-1]==' ' || end[-1]=='\t' || end[-1]=='\r' || end[-1]=='\n'))
+    end--;
+  *end='\0';
+
+  return string;
+}
+
+/*!
+\brief
+Changes a runConfig with the settings of a configuration file
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param fname a string with the filename of the configuration file
+
+@param cfg a pointer to the runConfig
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int readConfig(char fname[], runConfig *cfg)
+{
+  char line[LINELENGTH];
+  char *equal, *comment;
+  int Nline=0, result=0;
+  FILE *file;
+
+  if ((file=fopen(fname,"r"))==NULL)
+    {
+      printf("Error opening file %s for reading\n",fname);
+      return ERROR_FILE;
+    }
+
+  while (fgets(line,sizeof(line),file)!=NULL)
+    {
+      Nline++;
+      if ((comment=strchr(line,'#'))!=NULL)
+	*comment='\0';
+      if (*strip(line)=='\0')
+	continue;
+
+      if ((equal=strchr(line,'='))==NULL)
+	{
+	  printf("Error in line %d of file %s: expected key = value\n",Nline,fname);
+	  result=ERROR_FILE;
+	  break;
+	}
+      *equal='\0';
+      if (setConfig(cfg,strip(line),strip(equal+1))!=0)
+	{
+	  printf("Error in line %d of file %s\n",Nline,fname);
+	  result=ERROR_FILE;
+	  break;
+	}
+    }
+
+  fclose(file);
+  return result;
+}
+
+/*!
+\brief
+Writes the settings of a runConfig, in the format of a configuration file
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param file a pointer to the open file
+
+@param cfg a pointer to the runConfig
+
+*/
+void writeConfig(FILE *file, runConfig *cfg)
+{
+  configKey *entry;
+  char line[LINELENGTH];
+  char *field;
+  int index, Nchar;
+
+  for (entry=configKeys;entry->key!=NULL;entry++)
+    {
+      field=(char *)cfg+entry->offset;
+      Nchar=snprintf(line,sizeof(line),"%s = ",entry->key);
+      switch (entry->type)
+	{
+	case CONFIG_INT:
+	  snprintf(line+Nchar,sizeof(line)-Nchar,"%d",*(int *)field);
+	  break;
+	case CONFIG_SEED:
+	  snprintf(line+Nchar,sizeof(line)-Nchar,"%u",*(uint32 *)field);
+	  break;
+	case CONFIG_DOUBLE:
+	  snprintf(line+Nchar,sizeof(line)-Nchar,"%.17g",*(double *)field);
+	  break;
+	case CONFIG_STRING:
+	  snprintf(line+Nchar,sizeof(line)-Nchar,"%s",field);
+	  break;
+	case CONFIG_CHOICE:
+	  snprintf(line+Nchar,sizeof(line)-Nchar,"%s",entry->choices[*(int *)field]);
+	  break;
+	case CONFIG_LIST:
+	  for (index=1;index<=cfg->Ninit && Nchar<(int)sizeof(line);index++)
+	    Nchar+=snprintf(line+Nchar,sizeof(line)-Nchar,"%.17g%s",cfg->init[index-1],(index==cfg->Ninit) ? "" : " ");
+	  break;
+	}
+      fprintf(file,"%-32s # %s\n",line,entry->help);
+    }
+}
+
+// checks that the settings make sense, and fills in the derived ones
+static int checkConfig(runConfig *cfg)
+{
+  if (cfg->Nadapt<0)
+    cfg->Nadapt=cfg->Nchain/5;
+
+  if (cfg->Nchain<1 || cfg->Nadapt>cfg->Nchain)
+    printf("Nchain must be positive and at least Nadapt\n");
+  else if (cfg->frac<=0.)
+    printf("frac must be positive\n");
+  else if (cfg->Nwalkers<2 || cfg->Nwalkers%2!=0 || cfg->Nchains<1)
+    printf("Nwalkers must be even and at least 2, and Nchains at least 1\n");
+  else if (cfg->Nburn<0 || cfg->Nburn>=cfg->Nchain || cfg->thin<0 || cfg->Nbins<1)
+    printf("Nburn must be in [0,Nchain), thin not negative and Nbins positive\n");
+  else if (cfg->Ncheck<1 || cfg->Nswap<1 || cfg->Nleapfrog<0)
+    printf("Ncheck and Nswap must be positive, and Nleapfrog not negative\n");
+  else if (cfg->tempering && cfg->Tmax<1.)
+    printf("Tmax must be at least 1\n");
+  else if (cfg->optStarts<0 || cfg->optThreads<0 || cfg->optScale<=0. || cfg->optNmax<1)
+    printf("optStarts and optThreads must not be negative, optScale and optNmax positive\n");
+  else
+    return 0;
+
+  return ERROR_FILE;
+}
+
+/*!
+\brief
+Sets up a runConfig from the command line
+
+\details
+Starts from the settings already in the runConfig (usually those of
+defaultConfig()) and applies the arguments in order: "-c file" reads a
+configuration file and "key=value" (or "--key=value") sets a single
+setting. With "-h", it lists the settings and returns without running.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param argc an int with the number of arguments, as passed to main()
+
+@param argv[] an array of strings with the arguments, as passed to main()
+
+@param cfg a pointer to the runConfig
+
+\return zero if all was OK, -1 if only the help was asked for, ERROR_FILE otherwise
+
+*/
+int parseArgs(int argc, char *argv[], runConfig *cfg)
+{
+  char arg[LINELENGTH];
+  char *equal, *key;
+  int iarg;
+
+  for (iarg=1;iarg<argc;iarg++)
+    {
+      if (strcmp(argv[iarg],"-h")==0 || strcmp(argv[iarg],"--help")==0)
+	{
+	  printf("Usage: %s [-c file] [key=value ...]\nSettings, with their current values:\n",argv[0]);
+	  writeConfig(stdout,cfg);
+	  return -1;
+	}
+
+      if (strcmp(argv[iarg],"-c")==0)
+	{
+	  if (iarg+1==argc)
+	    {
+	      printf("Missing configuration file after -c\n");
+	      return ERROR_FILE;
+	    }
+	  if (readConfig(argv[++iarg],cfg)!=0)
+	    return ERROR_FILE;
+	  continue;
+	}
+
+      snprintf(arg,sizeof(arg),"%s",argv[iarg]);
+      key=(strncmp(arg,"--",2)==0) ? arg+2 : arg;
+      if ((equal=strchr(key,'='))==NULL)
+	{
+	  printf("Invalid argument %s, expected key=value (see -h)\n",argv[iarg]);
+	  return ERROR_FILE;
+	}
+      *equal='\0';
+      if (setConfig(cfg,strip(key),strip(equal+1))!=0)
+	return ERROR_FILE;
+    }
+
+  return checkConfig(cfg);
+}
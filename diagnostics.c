@@ -0,0 +1,332 @@
+/*! \file
+  \brief
+  File with subroutines to diagnose the convergence of MCMC chains
+
+  \details
+  The diagnostics are calculated on the fly from running sums, without
+  keeping the history of the chains. The links of each chain are
+  grouped in consecutive batches of equal size; whenever NBATCHMAX
+  batches fill up, neighbouring pairs are merged and the batch size is
+  doubled, so that the number of batches stays between NBATCHMAX/2 and
+  NBATCHMAX however long the chain runs. From the batches:
+
+  - the integrated autocorrelation time follows from the variance of
+    the batch means (the batch-means estimator), tau = b Var(batch
+    means) / Var(links), for batches of b links,
+
+  - the effective sample size is the number of links over tau, summed
+    over chains,
+
+  - the split R-hat of Gelman et al. compares the means and variances
+    of the first and second halves of all the chains, made of the
+    first and last half of the batches of each chain.
+
+  All sums are taken relative to the first link of each chain, to
+  avoid cancellation in the variances.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "mcmc.h"
+
+#define NBATCHMIN 16               // batches needed before the diagnostics are calculated
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+Sets up the running sums of the diagnostics of a chain
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() and multichain()
+
+@param stats a pointer to the running sums
+
+@param Nparam an int with the number of model parameters
+
+\return zero if all was OK, ERROR_FILE if the allocation failed
+
+*/
+int initStats(chainStats *stats, int Nparam)
+{
+  stats->Nparam=Nparam;
+  stats->Nsamples=0;
+  stats->batchSize=1;
+  stats->Nbatches=0;
+  stats->Ncurrent=0;
+
+  stats->block=calloc((2*NBATCHMAX+3)*Nparam,sizeof(double));
+  if (stats->block==NULL)
+    {
+      printf("Error allocating memory for the diagnostics\n");
+      return ERROR_FILE;
+    }
+  stats->shift=stats->block;
+  stats->csum=stats->shift+Nparam;
+  stats->csumsq=stats->csum+Nparam;
+  stats->bsum=stats->csumsq+Nparam;
+  stats->bsumsq=stats->bsum+NBATCHMAX*Nparam;
+
+  return 0;
+}
+
+/*!
+\brief
+Frees the running sums of the diagnostics of a chain
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param stats a pointer to the running sums
+
+*/
+void freeStats(chainStats *stats)
+{
+  free(stats->block);
+  stats->block=NULL;
+}
+
+/*!
+\brief
+Adds one link of a chain to the running sums of its diagnostics
+
+\details
+Accumulates the link in the current batch and closes the batch once
+it has batchSize links. When NBATCHMAX batches are full, neighbouring
+pairs of batches are merged into NBATCHMAX/2 batches of twice the
+size.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param stats a pointer to the running sums
+
+@param Aparam[] an array of doubles with the parameters of the link
+
+*/
+void addStats(chainStats *stats, double Aparam[])
+{
+  int Nparam=stats->Nparam;
+  int iparam, ibatch;
+
+  if (stats->Nsamples==0)
+    for (iparam=1;iparam<=Nparam;iparam++)
+      stats->shift[iparam-1]=Aparam[iparam-1];
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      double delta=Aparam[iparam-1]-stats->shift[iparam-1];
+      stats->csum[iparam-1]+=delta;
+      stats->csumsq[iparam-1]+=delta*delta;
+    }
+  stats->Nsamples++;
+
+  if (++stats->Ncurrent<stats->batchSize)
+    return;
+
+  // close the current batch
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      stats->bsum[stats->Nbatches*Nparam+iparam-1]=stats->csum[iparam-1];
+      stats->bsumsq[stats->Nbatches*Nparam+iparam-1]=stats->csumsq[iparam-1];
+      stats->csum[iparam-1]=stats->csumsq[iparam-1]=0.0;
+    }
+  stats->Ncurrent=0;
+
+  if (++stats->Nbatches<NBATCHMAX)
+    return;
+
+  // merge neighbouring batches
+  for (ibatch=1;ibatch<=NBATCHMAX/2;ibatch++)
+    for (iparam=1;iparam<=Nparam;iparam++)
+      {
+	stats->bsum[(ibatch-1)*Nparam+iparam-1]=stats->bsum[(2*ibatch-2)*Nparam+iparam-1]+stats->bsum[(2*ibatch-1)*Nparam+iparam-1];
+	stats->bsumsq[(ibatch-1)*Nparam+iparam-1]=stats->bsumsq[(2*ibatch-2)*Nparam+iparam-1]+stats->bsumsq[(2*ibatch-1)*Nparam+iparam-1];
+      }
+  stats->Nbatches=NBATCHMAX/2;
+  stats->batchSize*=2;
+}
+
+/*!
+\brief
+Calculates the mean and variance of a range of batches
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param stats a pointer to the running sums
+
+@param iparam an int with the parameter (starting at 1)
+
+@param first an int with the first batch of the range (starting at 1)
+
+@param last an int with the last batch of the range
+
+@param mean a pointer to a double with the mean (relative to the shift) on return
+
+@param var a pointer to a double with the variance on return
+
+*/
+static void batchMoments(chainStats *stats, int iparam, int first, int last, double *mean, double *var)
+{
+  double sum=0.0, sumsq=0.0;
+  double Nlinks=(last-first+1)*(double)stats->batchSize;
+  int ibatch;
+
+  for (ibatch=first;ibatch<=last;ibatch++)
+    {
+      sum+=stats->bsum[(ibatch-1)*stats->Nparam+iparam-1];
+      sumsq+=stats->bsumsq[(ibatch-1)*stats->Nparam+iparam-1];
+    }
+
+  *mean=sum/Nlinks;
+  *var=(sumsq-sum*sum/Nlinks)/(Nlinks-1.0);
+}
+
+/*!
+\brief
+Estimates the integrated autocorrelation time of a chain
+
+\details
+Uses the batch-means estimator tau = b s_b^2 / s^2, where s_b^2 is the
+variance of the means of the full batches of b links and s^2 the
+variance of all the links in them.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param stats a pointer to the running sums
+
+@param iparam an int with the parameter (starting at 1)
+
+\return a double with the autocorrelation time in links, or a negative
+value if there are not enough batches yet or the chain has not moved
+
+*/
+double iatStats(chainStats *stats, int iparam)
+{
+  int Nbatches=stats->Nbatches;
+  double mean, var, varBatch=0.0;
+  int ibatch;
+
+  if (Nbatches<NBATCHMIN)
+    return -1.0;
+
+  batchMoments(stats,iparam,1,Nbatches,&mean,&var);
+  if (!(var>0.0))
+    return -1.0;
+
+  for (ibatch=1;ibatch<=Nbatches;ibatch++)
+    {
+      double delta=stats->bsum[(ibatch-1)*stats->Nparam+iparam-1]/stats->batchSize-mean;
+      varBatch+=delta*delta;
+    }
+  varBatch/=(Nbatches-1.0);
+
+  double tau=stats->batchSize*varBatch/var;
+  return (tau<1.0) ? 1.0 : tau;
+}
+
+/*!
+\brief
+Calculates the convergence diagnostics of a set of chains
+
+\details
+Fills, for each parameter, the autocorrelation time of the first
+chain, the effective sample size summed over the chains and the split
+R-hat over the halves of all the chains in conv, which must have room
+for Nparam values in each array. The chains must have the same number
+of links. Until there are enough batches, the sizes are zero and the
+autocorrelation times and R-hats negative.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from walkers() and multichain()
+
+@param Nchains an int with the number of chains
+
+@param stats[] an array of the running sums of each chain
+
+@param conv a pointer to the diagnostics, filled on return
+
+\return one if the stopping rule of conv is met, zero otherwise
+
+*/
+int checkConvergence(int Nchains, chainStats stats[], convergence *conv)
+{
+  int Nparam=stats[0].Nparam;
+  int Nhalf=stats[0].Nbatches/2;
+  int iparam, ichain;
+  int converged=(conv->essTarget>0.0);
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      double ess=0.0;
+      double tau=-1.0;
+
+      for (ichain=1;ichain<=Nchains;ichain++)
+	{
+	  double tauChain=iatStats(&stats[ichain-1],iparam);
+	  if (ichain==1)
+	    tau=tauChain;
+	  if (tauChain>0.0)
+	    ess+=(stats[ichain-1].Nbatches*(double)stats[ichain-1].batchSize)/tauChain;
+	}
+
+      // split R-hat from the first and last halves of the batches of each chain
+      double rhat=-1.0;
+      if (Nhalf>=NBATCHMIN/2)
+	{
+	  double Nlinks=Nhalf*(double)stats[0].batchSize;
+	  double meanSum=0.0, meanSumsq=0.0, W=0.0;
+	  int Nsplit=2*Nchains;
+
+	  for (ichain=1;ichain<=Nchains;ichain++)
+	    {
+	      double mean, var;
+	      int ihalf;
+	      for (ihalf=0;ihalf<=1;ihalf++)
+		{
+		  int first=(ihalf==0) ? 1 : stats[ichain-1].Nbatches-Nhalf+1;
+		  batchMoments(&stats[ichain-1],iparam,first,first+Nhalf-1,&mean,&var);
+		  // the chains have different shifts
+		  mean+=stats[ichain-1].shift[iparam-1];
+		  meanSum+=mean;
+		  meanSumsq+=mean*mean;
+		  W+=var;
+		}
+	    }
+	  W/=Nsplit;
+	  double varMeans=(meanSumsq-meanSum*meanSum/Nsplit)/(Nsplit-1.0);
+	  if (W>0.0)
+	    rhat=sqrt(((Nlinks-1.0)/Nlinks*W+(varMeans>0.0 ? varMeans : 0.0))/W);
+	}
+
+      conv->ess[iparam-1]=ess;
+      conv->iat[iparam-1]=tau;
+      conv->rhat[iparam-1]=rhat;
+
+      if (ess<conv->essTarget || rhat<0.0 || rhat>conv->rhatTarget)
+	converged=0;
+    }
+
+  return converged;
+}
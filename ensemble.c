@@ -0,0 +1,219 @@
+/*! \file
+  \brief
+  File with subroutines to run an affine-invariant ensemble sampler
+
+  \details
+  The ensemble sampler of Goodman & Weare (2010), as implemented in
+  emcee (Foreman-Mackey et al. 2013), evolves a population of walkers
+  in lock-step with the "stretch move". The walkers are split in two
+  halves; each half is moved using the positions of the other half, so
+  that all the proposals of one half can be evaluated as a single batch
+  with postBatch().
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+
+#include "mcmc.h"
+#include "instrument.h"
+
+#define STRETCH 2.0                // scale parameter a of the stretch move
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+Runs an affine-invariant ensemble of MCMC walkers
+
+\details
+Starts Nwalkers walkers in a small Gaussian ball of widths dev[] around
+the initial parameters Aparam[] and moves them for Nchain steps with the
+stretch move. At every step the two halves of the ensemble are updated
+in turn: for each walker k of a half, a walker j is drawn from the
+other half and the proposal is Y = X_j + z (X_k - X_j), with z drawn
+from g(z) ~ 1/sqrt(z) in [1/a,a]. The proposal is accepted with
+probability min(1, z^(Nparam-1) p(Y)/p(X_k)).
+
+After every step, the positions of all walkers are recorded in the
+file, one line per walker with the same columns as in walkers(),
+followed by the walker index. Only the steps after record->Nburn are
+recorded, thinned by record->thin in the file and all of them in
+record->summary if there is one (see recordLink()). With
+-DINSTRUMENT, the loop is timed (see instrument.h). Every step starts a
+new step of the generator (see nextStepMT()).
+
+\version 1.5
+
+\date Oct 14, 2026
+
+\pre It is called from main()
+
+@param fname a string with the filename where to record the chains
+
+@param format an int with the format of the file, CHAIN_TEXT or CHAIN_NPY
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
+@param Nchain an int with the number of steps of the ensemble
+
+@param Nwalkers an int with the number of walkers (even, at least 2*Nparam)
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial values of the model parameters
+
+@param dev[] an array of doubles with the widths of the initial ball of walkers
+
+@param seed a uint32 with the seed of the random numbers
+
+@param record a pointer to the rule of the links recorded in the file and the summary
+
+@param data a pointer to the data set prepared by prepareData()
+
+\return a double with the acceptance ratio of the ensemble; also on
+return, the array Aparam[] will have the model parameters of the most
+likely model.
+
+*/
+double ensemble(char fname[], int format, char *names[], int Nchain, int Nwalkers, int Nparam, double Aparam[], double dev[], uint32 seed, chainRecord *record, dataset *data)
+{
+  chainWriter chainfile;               // file to record MCMC chains
+  char *colnames[Nparam+1];            // names of the columns of the file
+
+  int ichain;                          // index counting ensemble steps
+  int iwalk;                           // index counting walkers
+  int iparam;                          // index counting parameters
+  int ihalf;                           // index counting the two halves
+
+  int Nhalf=Nwalkers/2;                // walkers in each half of the ensemble
+
+  double *Xwalk=malloc(Nwalkers*Nparam*sizeof(double)); // positions of walkers
+  double *probWalk=malloc(Nwalkers*sizeof(double));     // their posteriors
+  double *Ytrial=malloc(Nhalf*Nparam*sizeof(double));   // proposals for one half
+  double *probTrial=malloc(Nhalf*sizeof(double));       // their posteriors
+  double *zTrial=malloc(Nhalf*sizeof(double));          // their stretch factors
+  double *uTrial=malloc(2*Nhalf*sizeof(double));        // uniform deviates for them
+
+  double AparamMax[Nparam];            // parameters of most likely model
+  double postMax=-1.e34;               // maximum posterior
+
+  long accept=0;                       // number of accepted moves
+
+  mtState rng;                         // random number generator
+
+  if (Xwalk==NULL || probWalk==NULL || Ytrial==NULL || probTrial==NULL || zTrial==NULL || uTrial==NULL)
+    {
+      printf("Error allocating memory for %d walkers\n",Nwalkers);
+      free(Xwalk); free(probWalk); free(Ytrial); free(probTrial); free(zTrial); free(uTrial);
+      return ERROR_FILE;
+    }
+
+  // open file to output MCMC chain, with the walker index last
+  for (iparam=1;iparam<=Nparam;iparam++)
+    colnames[iparam-1]=(names==NULL) ? NULL : names[iparam-1];
+  colnames[Nparam]="walker";
+  if (openChain(&chainfile,fname,format,Nparam,1,recordedLinks(record,Nchain)*Nwalkers,colnames,seed)!=0)
+    {
+      free(Xwalk); free(probWalk); free(Ytrial); free(probTrial); free(zTrial); free(uTrial);
+      return ERROR_FILE;
+    }
+
+  seedMT(&rng,seed);                 // start the random number generator
+
+  // start the walkers in a small ball around the initial parameters
+  for (iwalk=1;iwalk<=Nwalkers;iwalk++)
+    for (iparam=1;iparam<=Nparam;iparam++)
+      Xwalk[(iwalk-1)*Nparam+iparam-1]=Aparam[iparam-1]+gauss(&rng,dev[iparam-1]);
+
+  postBatch(Nwalkers,Nparam,Xwalk,data,probWalk);
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    AparamMax[iparam-1]=Aparam[iparam-1];
+
+  INSTR_RUN_BEGIN();
+  for (ichain=1;ichain<=Nchain;ichain++)
+    {
+      nextStepMT(&rng);
+      for (ihalf=0;ihalf<=1;ihalf++)
+	{
+	  double *Xmove=Xwalk+ihalf*Nhalf*Nparam;        // the half being moved
+	  double *Xother=Xwalk+(1-ihalf)*Nhalf*Nparam;   // the complementary half
+	  double *probMove=probWalk+ihalf*Nhalf;
+
+	  // draw the stretch moves for all walkers of this half
+	  fillMT(&rng,2*Nhalf,uTrial);
+	  for (iwalk=1;iwalk<=Nhalf;iwalk++)
+	    {
+	      double zaux=(STRETCH-1.0)*uTrial[2*iwalk-2]+1.0;
+	      int jwalk=(int)(uTrial[2*iwalk-1]*Nhalf);
+	      if (jwalk>=Nhalf)
+		jwalk=Nhalf-1;
+
+	      zTrial[iwalk-1]=zaux*zaux/STRETCH;
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		{
+		  double xj=Xother[jwalk*Nparam+iparam-1];
+		  Ytrial[(iwalk-1)*Nparam+iparam-1]=xj+zTrial[iwalk-1]*(Xmove[(iwalk-1)*Nparam+iparam-1]-xj);
+		}
+	    }
+
+	  // evaluate all the proposals at once
+	  postBatch(Nhalf,Nparam,Ytrial,data,probTrial);
+
+	  // accept or reject each of them
+	  fillMT(&rng,Nhalf,uTrial);
+	  for (iwalk=1;iwalk<=Nhalf;iwalk++)
+	    {
+	      double probRandom=uTrial[iwalk-1];
+	      double lnratio=(Nparam-1)*log(zTrial[iwalk-1])+probTrial[iwalk-1]-probMove[iwalk-1];
+
+	      if (lnratio>=log(probRandom))
+		{
+		  for (iparam=1;iparam<=Nparam;iparam++)
+		    Xmove[(iwalk-1)*Nparam+iparam-1]=Ytrial[(iwalk-1)*Nparam+iparam-1];
+		  probMove[iwalk-1]=probTrial[iwalk-1];
+		  accept+=1;
+
+		  // check if this is the most likely value
+		  if (probTrial[iwalk-1]>postMax)
+		    {
+		      for (iparam=1;iparam<=Nparam;iparam++)
+			AparamMax[iparam-1]=Ytrial[(iwalk-1)*Nparam+iparam-1];
+		      postMax=probTrial[iwalk-1];
+		    }
+		}
+	    }
+	}
+
+      // record the positions of all walkers, with the walker index last
+      for (iwalk=1;iwalk<=Nwalkers;iwalk++)
+	{
+	  double row[Nparam+1];
+	  for (iparam=1;iparam<=Nparam;iparam++)
+	    row[iparam-1]=Xwalk[(iwalk-1)*Nparam+iparam-1];
+	  row[Nparam]=iwalk-1;
+	  recordLink(&chainfile,record,ichain,row);
+	}
+    }
+
+  // close file with chains
+  closeChain(&chainfile);
+  INSTR_RUN_END();
+
+  // return the most likely model values
+  for (iparam=1;iparam<=Nparam;iparam++)
+    Aparam[iparam-1]=AparamMax[iparam-1];
+
+  free(Xwalk); free(probWalk); free(Ytrial); free(probTrial); free(zTrial); free(uTrial);
+
+  // calculate and return the acceptance ratio
+  double acceptance=accept/(1.0*Nchain*Nwalkers);
+  return acceptance;
+}
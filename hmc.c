@@ -0,0 +1,615 @@
+/*! \file
+  \brief
+  File with a Hamiltonian Monte Carlo sampler that follows the gradient of the posterior
+
+  \details
+  Instead of random-walk steps, each link of the chain integrates
+  Hamiltonian dynamics over the log posterior with the leapfrog
+  scheme, using the log posterior and its gradient from one fused pass
+  over the data (see postGrad()). The momenta are drawn with a diagonal
+  mass matrix. With Nleapfrog=0, the number of leapfrog steps of each
+  link is chosen by the No-U-Turn Sampler (NUTS, Hoffman & Gelman
+  2014, the efficient version with slice sampling): the trajectory is
+  doubled in a random direction until it turns back on itself, and the
+  next link is drawn from the points of the trajectory. With
+  Nleapfrog>0, every link is a plain HMC trajectory of that many steps
+  followed by a Metropolis test.
+
+  During the first Nadapt links, the step size is tuned by dual
+  averaging to an average acceptance statistic of HMC_TARGET, and the
+  inverse mass matrix is set to the variance of the chain over the
+  windows [Nadapt/8,Nadapt/4), [Nadapt/4,Nadapt/2) and
+  [Nadapt/2,7Nadapt/8); the step size is then frozen at its average,
+  so that the links after burn-in sample the posterior exactly.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "mcmc.h"
+#include "instrument.h"
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+#define NUTS_MAXDEPTH 10           // max depth of the trajectories, 2^10 leapfrog steps
+#define NUTS_DELTAMAX 1000.        // error of the energy that stops a trajectory
+#define HMC_TARGET 0.8             // acceptance statistic the step size is tuned to
+#define DA_GAMMA 0.05              // shrinkage of the dual averaging
+#define DA_T0 10.                  // early iterations damped by the dual averaging
+#define DA_KAPPA 0.75              // decay of the weights of the averaged step size
+
+/*!
+\brief
+A subtree of a NUTS trajectory
+
+\details
+The points at its two ends, with their momenta and the gradients
+there, the point of the subtree proposed as the next link, and the
+counts that decide how the subtree is merged with the others.
+
+*/
+typedef struct
+{
+  double *thetaMinus;            //!< position at the backward end
+  double *rMinus;                //!< momentum at the backward end
+  double *gradMinus;             //!< gradient at the backward end
+  double *thetaPlus;             //!< position at the forward end
+  double *rPlus;                 //!< momentum at the forward end
+  double *gradPlus;              //!< gradient at the forward end
+  double *thetaProp;             //!< proposed position
+  double *gradProp;              //!< gradient at the proposed position
+  double logpProp;               //!< log posterior at the proposed position
+  double n;                      //!< number of points inside the slice
+  int s;                         //!< zero once the subtree has turned or diverged
+  double alpha;                  //!< sum of the acceptance statistics of the points
+  long Nalpha;                   //!< number of points in the sum of alpha
+} nutsTree;
+
+/*!
+\brief
+The state of a Hamiltonian chain
+
+*/
+typedef struct
+{
+  int Nparam;                    //!< number of model parameters
+  dataset *data;                 //!< the data being fit
+  mtState rng;                   //!< random number generator of the chain
+  double *block;                 //!< the storage of all the arrays
+  double *Minv;                  //!< diagonal of the inverse mass matrix
+  double eps;                    //!< leapfrog step size
+  double H0;                     //!< -energy at the start of the trajectory
+  double logu;                   //!< log of the slice variable of NUTS
+  long Ngrad;                    //!< number of evaluations of the gradient
+  double postMax;                //!< maximum log posterior of the points evaluated
+  double *AparamMax;             //!< parameters of the most likely point so far
+  nutsTree trees[NUTS_MAXDEPTH+2];  //!< subtrees of each depth, and the whole trajectory
+} hmcState;
+
+// evaluates the log posterior and its gradient, counting the evaluations
+// and keeping track of the most likely point
+static double evalPost(hmcState *hmc, double theta[], double grad[])
+{
+  double logp=postGrad(hmc->Nparam,theta,hmc->data,grad);
+
+  // treat overflows as points outside the support
+  if (!(logp>-1.e34))
+    logp=-1.e34;
+  hmc->Ngrad++;
+  if (logp>hmc->postMax)
+    {
+      hmc->postMax=logp;
+      memcpy(hmc->AparamMax,theta,hmc->Nparam*sizeof(double));
+    }
+
+  return logp;
+}
+
+// the kinetic energy of a momentum
+static double kinetic(hmcState *hmc, double r[])
+{
+  double result=0.0;
+  int iparam;
+
+  for (iparam=1;iparam<=hmc->Nparam;iparam++)
+    result+=r[iparam-1]*r[iparam-1]*hmc->Minv[iparam-1];
+
+  return 0.5*result;
+}
+
+// one leapfrog step of size eps, in place; returns the new log posterior
+static double leapfrog(hmcState *hmc, double theta[], double r[], double grad[], double eps)
+{
+  int iparam;
+
+  for (iparam=1;iparam<=hmc->Nparam;iparam++)
+    {
+      r[iparam-1]+=0.5*eps*grad[iparam-1];
+      theta[iparam-1]+=eps*hmc->Minv[iparam-1]*r[iparam-1];
+    }
+  double logp=evalPost(hmc,theta,grad);
+  for (iparam=1;iparam<=hmc->Nparam;iparam++)
+    r[iparam-1]+=0.5*eps*grad[iparam-1];
+
+  return logp;
+}
+
+// draws a momentum from the Gaussian of the mass matrix
+static void drawMomentum(hmcState *hmc, double r[])
+{
+  int iparam;
+
+  for (iparam=1;iparam<=hmc->Nparam;iparam++)
+    r[iparam-1]=gauss(&hmc->rng,1.0)/sqrt(hmc->Minv[iparam-1]);
+}
+
+// returns one if the trajectory between the ends of a tree has not turned back
+static int noUturn(hmcState *hmc, nutsTree *tree)
+{
+  double minus=0.0, plus=0.0, dtheta;
+  int iparam;
+
+  for (iparam=1;iparam<=hmc->Nparam;iparam++)
+    {
+      dtheta=tree->thetaPlus[iparam-1]-tree->thetaMinus[iparam-1];
+      minus+=dtheta*hmc->Minv[iparam-1]*tree->rMinus[iparam-1];
+      plus+=dtheta*hmc->Minv[iparam-1]*tree->rPlus[iparam-1];
+    }
+
+  return (minus>=0.0 && plus>=0.0);
+}
+
+/*!
+\brief
+Builds a NUTS subtree of 2^depth leapfrog steps
+
+\details
+Builds the subtree recursively from the point (theta,r,grad) in the
+direction dir (+1 or -1), as the BuildTree of Hoffman & Gelman
+(2014). The subtrees of depth-1 use hmc->trees[depth-1] as their
+scratch, so that out must not be one of hmc->trees[0..depth-1].
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param hmc a pointer to the state of the chain
+
+@param depth an int with the depth of the subtree
+
+@param dir an int with the direction of the steps
+
+@param theta[] an array of doubles with the position to start from
+
+@param r[] an array of doubles with the momentum to start from
+
+@param grad[] an array of doubles with the gradient to start from
+
+@param out a pointer to the subtree on return
+
+*/
+static void buildTree(hmcState *hmc, int depth, int dir, double theta[], double r[], double grad[], nutsTree *out)
+{
+  size_t size=hmc->Nparam*sizeof(double);
+
+  if (depth==0)
+    {
+      // one leapfrog step
+      memcpy(out->thetaPlus,theta,size);
+      memcpy(out->rPlus,r,size);
+      memcpy(out->gradPlus,grad,size);
+      double logp=leapfrog(hmc,out->thetaPlus,out->rPlus,out->gradPlus,dir*hmc->eps);
+      double joint=logp-kinetic(hmc,out->rPlus);
+
+      memcpy(out->thetaMinus,out->thetaPlus,size);
+      memcpy(out->rMinus,out->rPlus,size);
+      memcpy(out->gradMinus,out->gradPlus,size);
+      memcpy(out->thetaProp,out->thetaPlus,size);
+      memcpy(out->gradProp,out->gradPlus,size);
+      out->logpProp=logp;
+      out->n=(hmc->logu<=joint) ? 1.0 : 0.0;
+      out->s=(hmc->logu<NUTS_DELTAMAX+joint);
+      out->alpha=(joint>hmc->H0) ? 1.0 : exp(joint-hmc->H0);
+      out->Nalpha=1;
+      return;
+    }
+
+  // the first half, then the second half from its far end
+  buildTree(hmc,depth-1,dir,theta,r,grad,out);
+  if (!out->s)
+    return;
+
+  nutsTree *sub=&hmc->trees[depth-1];
+  if (dir==-1)
+    {
+      buildTree(hmc,depth-1,dir,out->thetaMinus,out->rMinus,out->gradMinus,sub);
+      memcpy(out->thetaMinus,sub->thetaMinus,size);
+      memcpy(out->rMinus,sub->rMinus,size);
+      memcpy(out->gradMinus,sub->gradMinus,size);
+    }
+  else
+    {
+      buildTree(hmc,depth-1,dir,out->thetaPlus,out->rPlus,out->gradPlus,sub);
+      memcpy(out->thetaPlus,sub->thetaPlus,size);
+      memcpy(out->rPlus,sub->rPlus,size);
+      memcpy(out->gradPlus,sub->gradPlus,size);
+    }
+
+  // propose a point of the second half in proportion to its points in the slice
+  if (sub->n>0.0 && uniform(&hmc->rng)*(out->n+sub->n)<sub->n)
+    {
+      memcpy(out->thetaProp,sub->thetaProp,size);
+      memcpy(out->gradProp,sub->gradProp,size);
+      out->logpProp=sub->logpProp;
+    }
+  out->n+=sub->n;
+  out->alpha+=sub->alpha;
+  out->Nalpha+=sub->Nalpha;
+  out->s=(sub->s && noUturn(hmc,out));
+}
+
+/*!
+\brief
+Takes one NUTS link
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param hmc a pointer to the state of the chain
+
+@param theta[] an array of doubles with the current position, and the next one on return
+
+@param grad[] an array of doubles with the gradient at theta, updated on return
+
+@param logp a pointer to the log posterior at theta, updated on return
+
+\return a double with the acceptance statistic of the link
+
+*/
+static double nutsLink(hmcState *hmc, double theta[], double grad[], double *logp)
+{
+  size_t size=hmc->Nparam*sizeof(double);
+  nutsTree *whole=&hmc->trees[NUTS_MAXDEPTH+1];
+  nutsTree *sub=&hmc->trees[NUTS_MAXDEPTH];
+  double alpha=0.0;
+  long Nalpha=1;
+  int depth;
+
+  // the trajectory starts as the current point with a fresh momentum
+  drawMomentum(hmc,whole->rMinus);
+  hmc->H0=*logp-kinetic(hmc,whole->rMinus);
+  hmc->logu=hmc->H0+log(uniform(&hmc->rng));
+  memcpy(whole->rPlus,whole->rMinus,size);
+  memcpy(whole->thetaMinus,theta,size);
+  memcpy(whole->thetaPlus,theta,size);
+  memcpy(whole->gradMinus,grad,size);
+  memcpy(whole->gradPlus,grad,size);
+  whole->n=1.0;
+  whole->s=1;
+
+  for (depth=0;whole->s && depth<NUTS_MAXDEPTH;depth++)
+    {
+      // double the trajectory in a random direction
+      if (uniform(&hmc->rng)<0.5)
+	{
+	  buildTree(hmc,depth,-1,whole->thetaMinus,whole->rMinus,whole->gradMinus,sub);
+	  memcpy(whole->thetaMinus,sub->thetaMinus,size);
+	  memcpy(whole->rMinus,sub->rMinus,size);
+	  memcpy(whole->gradMinus,sub->gradMinus,size);
+	}
+      else
+	{
+	  buildTree(hmc,depth,1,whole->thetaPlus,whole->rPlus,whole->gradPlus,sub);
+	  memcpy(whole->thetaPlus,sub->thetaPlus,size);
+	  memcpy(whole->rPlus,sub->rPlus,size);
+	  memcpy(whole->gradPlus,sub->gradPlus,size);
+	}
+
+      // move to the new half with the probability of its points in the slice
+      if (sub->s && uniform(&hmc->rng)*whole->n<sub->n)
+	{
+	  memcpy(theta,sub->thetaProp,size);
+	  memcpy(grad,sub->gradProp,size);
+	  *logp=sub->logpProp;
+	}
+      whole->n+=sub->n;
+      whole->s=(sub->s && noUturn(hmc,whole));
+      alpha=sub->alpha;
+      Nalpha=sub->Nalpha;
+    }
+
+  return alpha/Nalpha;
+}
+
+/*!
+\brief
+Takes one plain HMC link of Nleapfrog steps
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param hmc a pointer to the state of the chain
+
+@param Nleapfrog an int with the number of leapfrog steps
+
+@param theta[] an array of doubles with the current position, and the next one on return
+
+@param grad[] an array of doubles with the gradient at theta, updated on return
+
+@param logp a pointer to the log posterior at theta, updated on return
+
+\return a double with the acceptance probability of the trajectory
+
+*/
+static double hmcLink(hmcState *hmc, int Nleapfrog, double theta[], double grad[], double *logp)
+{
+  int Nparam=hmc->Nparam;
+  double thetaNew[Nparam], gradNew[Nparam], r[Nparam];
+  double logpNew=*logp;
+  int istep;
+
+  memcpy(thetaNew,theta,Nparam*sizeof(double));
+  memcpy(gradNew,grad,Nparam*sizeof(double));
+  drawMomentum(hmc,r);
+  double H0=*logp-kinetic(hmc,r);
+
+  for (istep=1;istep<=Nleapfrog && logpNew>-1.e34;istep++)
+    logpNew=leapfrog(hmc,thetaNew,r,gradNew,hmc->eps);
+
+  double H1=logpNew-kinetic(hmc,r);
+  double alpha=(H1>H0) ? 1.0 : exp(H1-H0);
+  if (uniform(&hmc->rng)<alpha)
+    {
+      memcpy(theta,thetaNew,Nparam*sizeof(double));
+      memcpy(grad,gradNew,Nparam*sizeof(double));
+      *logp=logpNew;
+    }
+
+  return alpha;
+}
+
+// finds a first step size, for which a single leapfrog step has an
+// acceptance probability of about one half (Hoffman & Gelman 2014)
+static double findStepSize(hmcState *hmc, double theta[], double grad[], double logp)
+{
+  int Nparam=hmc->Nparam;
+  double thetaNew[Nparam], gradNew[Nparam], r[Nparam], r0[Nparam];
+  double eps=1.0, ratio;
+  int iter, dir=0;
+
+  drawMomentum(hmc,r0);
+  double H0=logp-kinetic(hmc,r0);
+  for (iter=1;iter<=50;iter++)
+    {
+      memcpy(thetaNew,theta,Nparam*sizeof(double));
+      memcpy(gradNew,grad,Nparam*sizeof(double));
+      memcpy(r,r0,Nparam*sizeof(double));
+      ratio=leapfrog(hmc,thetaNew,r,gradNew,eps)-kinetic(hmc,r)-H0;
+      if (dir==0)
+	dir=(ratio>log(0.5)) ? 1 : -1;
+      if ((dir==1 && ratio<=log(0.5)) || (dir==-1 && ratio>log(0.5)))
+	break;
+      eps*=(dir==1) ? 2.0 : 0.5;
+    }
+
+  return eps;
+}
+
+/*!
+\brief
+Runs a Hamiltonian Monte Carlo chain
+
+\details
+Runs a chain of NUTS links (Nleapfrog=0) or of plain HMC links of
+Nleapfrog leapfrog steps, recording every link in the chain file like
+walkers(). The step size and the mass matrix adapt during the first
+Nadapt links (see the description of the file), which are left out of
+the convergence diagnostics; every conv->Ncheck links after them the
+chain stops early if the stopping rule of conv is met. Only the links
+after record->Nburn are recorded, as in walkers(). With -DINSTRUMENT,
+the loop is timed (see instrument.h). Every link starts a new step of
+the generator (see nextStepMT()).
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is called from main(); the model has a gradient kernel and the
+data set has no complex or closure terms
+
+@param fname a string with the filename where to record the chain
+
+@param format an int with the format of the file, CHAIN_TEXT or CHAIN_NPY
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
+@param Nchain an int with the length of the chain to be calculated
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial values of the model parameters
+
+@param dev[] an array of doubles with the initial scales of the parameters, for the mass matrix
+
+@param Nleapfrog an int with the leapfrog steps of each link, or 0 for NUTS
+
+@param Nadapt an int with the number of links of burn-in over which the sampler adapts
+
+@param seed a uint32 with the seed of the random numbers of the chain
+
+@param record a pointer to the rule of the links recorded in the file and the summary
+
+@param conv a pointer to the stopping rule, and the diagnostics on return
+
+@param data a pointer to the data set prepared by prepareData()
+
+@param stepSize a pointer to a double with the step size after burn-in on return
+
+@param Ngrad a pointer to a long with the number of evaluations of the gradient on return
+
+\return a double with the average acceptance statistic after burn-in,
+or ERROR_FILE; also on return, the array Aparam[] will have the model
+parameters of the most likely model.
+
+*/
+double hmc(char fname[], int format, char *names[], int Nchain, int Nparam, double Aparam[], double dev[], int Nleapfrog, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *stepSize, long *Ngrad)
+{
+  chainWriter chainfile;               // file to record MCMC chains
+  chainStats stats;                    // running sums of the diagnostics
+  hmcState hmc;                        // the state of the chain
+  double theta[Nparam], grad[Nparam];  // position of the chain and gradient there
+  double mean[Nparam], M2[Nparam];     // running variance over the window
+  long ichain, Nwindow=0;
+  int iparam, itree;
+
+  if (data->model->grad==NULL || data->Nterms>0)
+    {
+      printf("The model %s has no gradient for these data\n",data->model->name);
+      return ERROR_FILE;
+    }
+
+  // the arrays of the state and of all the trees
+  hmc.Nparam=Nparam;
+  hmc.data=data;
+  if (posix_memalign((void **)&hmc.block,DATA_ALIGN,(2+8*(NUTS_MAXDEPTH+2))*Nparam*sizeof(double))!=0)
+    {
+      printf("Error allocating memory for the HMC chain\n");
+      return ERROR_FILE;
+    }
+  hmc.Minv=hmc.block;
+  hmc.AparamMax=hmc.block+Nparam;
+  for (itree=1;itree<=NUTS_MAXDEPTH+2;itree++)
+    {
+      double **arrays[8];
+      nutsTree *tree=&hmc.trees[itree-1];
+      arrays[0]=&tree->thetaMinus; arrays[1]=&tree->rMinus; arrays[2]=&tree->gradMinus;
+      arrays[3]=&tree->thetaPlus;  arrays[4]=&tree->rPlus;  arrays[5]=&tree->gradPlus;
+      arrays[6]=&tree->thetaProp;  arrays[7]=&tree->gradProp;
+      for (iparam=1;iparam<=8;iparam++)
+	*arrays[iparam-1]=hmc.block+(2+8*(itree-1)+iparam-1)*Nparam;
+    }
+
+  if (initStats(&stats,Nparam)!=0)
+    {
+      free(hmc.block);
+      return ERROR_FILE;
+    }
+  if (openChain(&chainfile,fname,format,Nparam,0,recordedLinks(record,Nchain),names,seed)!=0)
+    {
+      freeStats(&stats);
+      free(hmc.block);
+      return ERROR_FILE;
+    }
+
+  seedMT(&hmc.rng,seed);
+  hmc.Ngrad=0;
+  hmc.postMax=-1.e35;
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      theta[iparam-1]=Aparam[iparam-1];
+      hmc.Minv[iparam-1]=dev[iparam-1]*dev[iparam-1];
+    }
+  double logp=evalPost(&hmc,theta,grad);
+
+  // dual averaging of the step size (Hoffman & Gelman 2014)
+  hmc.eps=findStepSize(&hmc,theta,grad,logp);
+  double mu=log(10.*hmc.eps), Hbar=0.0, logEpsBar=0.0;
+  long Nda=0;
+
+  // ends of the windows over which the mass matrix adapts
+  long windows[4]={Nadapt/8,Nadapt/4,Nadapt/2,7L*Nadapt/8};
+  int iwindow=1;
+
+  double alpha, alphaSum=0.0;
+  INSTR_RUN_BEGIN();
+  for (ichain=1;ichain<=Nchain;ichain++)
+    {
+      nextStepMT(&hmc.rng);
+      if (Nleapfrog>0)
+	alpha=hmcLink(&hmc,Nleapfrog,theta,grad,&logp);
+      else
+	alpha=nutsLink(&hmc,theta,grad,&logp);
+
+      recordLink(&chainfile,record,ichain,theta);
+
+      if (ichain<=Nadapt)
+	{
+	  // tune the step size to the target acceptance statistic
+	  Nda++;
+	  Hbar+=(HMC_TARGET-alpha-Hbar)/(Nda+DA_T0);
+	  double logEps=mu-sqrt((double)Nda)/DA_GAMMA*Hbar;
+	  double weight=pow((double)Nda,-DA_KAPPA);
+	  logEpsBar=weight*logEps+(1.0-weight)*logEpsBar;
+	  hmc.eps=exp(logEps);
+
+	  // the variance of the chain over the current window
+	  if (iwindow<=3 && ichain>windows[0])
+	    {
+	      Nwindow++;
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		{
+		  if (Nwindow==1)
+		    mean[iparam-1]=M2[iparam-1]=0.0;
+		  double delta=theta[iparam-1]-mean[iparam-1];
+		  mean[iparam-1]+=delta/Nwindow;
+		  M2[iparam-1]+=delta*(theta[iparam-1]-mean[iparam-1]);
+		}
+	    }
+
+	  // at the end of a window, take its variance as the inverse mass
+	  // matrix, regularized towards a small value, and restart the step size
+	  if (iwindow<=3 && ichain==windows[iwindow] && Nwindow>2)
+	    {
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		hmc.Minv[iparam-1]=(Nwindow/(Nwindow+5.0))*M2[iparam-1]/(Nwindow-1)+1.e-3*(5.0/(Nwindow+5.0));
+	      Nwindow=0;
+	      iwindow++;
+	      hmc.eps=findStepSize(&hmc,theta,grad,logp);
+	      mu=log(10.*hmc.eps);
+	      Hbar=logEpsBar=0.0;
+	      Nda=0;
+	    }
+
+	  // freeze the step size at the end of burn-in
+	  if (ichain==Nadapt)
+	    hmc.eps=exp(logEpsBar);
+	}
+      else
+	{
+	  alphaSum+=alpha;
+	  addStats(&stats,theta);
+	  if (conv->essTarget>0.0 && conv->Ncheck>0 && (ichain-Nadapt)%conv->Ncheck==0 && checkConvergence(1,&stats,conv))
+	    {
+	      ichain++;
+	      break;
+	    }
+	}
+    }
+  conv->Nlinks=ichain-1;
+  checkConvergence(1,&stats,conv);
+
+  closeChain(&chainfile);
+  INSTR_RUN_END();
+
+  // return the most likely model values
+  for (iparam=1;iparam<=Nparam;iparam++)
+    Aparam[iparam-1]=hmc.AparamMax[iparam-1];
+  *stepSize=hmc.eps;
+  *Ngrad=hmc.Ngrad;
+
+  double acceptance=(conv->Nlinks>Nadapt) ? alphaSum/(conv->Nlinks-Nadapt) : 0.0;
+
+  freeStats(&stats);
+  free(hmc.block);
+  return acceptance;
+}
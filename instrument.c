@@ -0,0 +1,426 @@
+/*! \file
+  \brief
+  File with subroutines to instrument the hot paths of the samplers
+
+  \details
+  Only compiled in with -DINSTRUMENT (see instrument.h). Every thread
+  accumulates the time it spends in the likelihood, in the recording of
+  the chains and in its sampler loop in counters of its own, so that the
+  hot paths take no locks; the counters of each thread are merged into
+  the totals of the run, under a mutex, when its sampler loop ends. The
+  time of a loop that is neither in the likelihood nor in the I/O goes
+  to the proposals and the bookkeeping of the sampler.
+
+  With -DINSTRUMENT_PERF, each thread also opens a group of hardware
+  counters (cycles, instructions and cache misses) the first time it
+  evaluates the likelihood, and enables it only for the duration of each
+  evaluation. If the kernel does not allow it (e.g., a container, or
+  /proc/sys/kernel/perf_event_paranoid above 2), the report says so and
+  the rest of the instrumentation goes on.
+
+  instrReport() writes the totals to mcmc.log.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning The hardware counters cost two system calls per evaluation of
+  the likelihood, which inflates its time in the same report
+
+*/
+#ifdef INSTRUMENT
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef INSTRUMENT_PERF
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "instrument.h"
+
+#define INSTRNCOUNTERS 3               // cycles, instructions, cache misses
+
+//! time and counts of one thread, or of the whole run
+typedef struct
+{
+  double tlike;                        //!< seconds in the likelihood
+  double tio;                          //!< seconds recording the chains
+  double trun;                         //!< seconds in the sampler loops
+  double start;                        //!< start of the current loop
+  long Nlike;                          //!< evaluations of the likelihood
+  long Nruns;                          //!< sampler loops
+  long Nbudget;                        //!< evaluations with an early exit allowed
+  long Nexit;                          //!< evaluations that stopped early
+  double pointsUsed;                   //!< data points summed by them
+  double pointsTotal;                  //!< data points they would have summed in full
+
+  int Nwindows;                        //!< windows of the acceptance ratio
+  long windowLength;                   //!< links per window
+  long lastAccept;                     //!< accepted links before the window
+  double rate[INSTRNWINDOWS];          //!< acceptance ratio in each window
+
+  int perf;                            //!< 0 unopened, 1 counting, -1 unavailable
+  int fd[INSTRNCOUNTERS];              //!< the group of hardware counters
+  unsigned long long counts[INSTRNCOUNTERS]; //!< counts of the group
+} instrCounters;
+
+static _Thread_local instrCounters local;
+static instrCounters total;
+static int perfFailed=0;               // threads without hardware counters
+static pthread_mutex_t totalLock=PTHREAD_MUTEX_INITIALIZER;
+
+/*!
+\brief
+Returns the time of a monotonic clock in seconds
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\return a double with the time in seconds
+
+*/
+double instrClock(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return now.tv_sec+1.e-9*now.tv_nsec;
+}
+
+#ifdef INSTRUMENT_PERF
+/*!
+\brief
+Opens the group of hardware counters of the calling thread
+
+\details
+The cycles lead the group, disabled, and the instructions and the
+cache misses follow it, so that one ioctl() enables or disables all
+three. Only user space is counted.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\return zero if the counters were opened, one otherwise
+
+*/
+static int openCounters(void)
+{
+  unsigned long long config[INSTRNCOUNTERS]={PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,PERF_COUNT_HW_CACHE_MISSES};
+  struct perf_event_attr attr;
+  int icounter, jcounter;
+
+  for (icounter=1;icounter<=INSTRNCOUNTERS;icounter++)
+    {
+      memset(&attr,0,sizeof(attr));
+      attr.size=sizeof(attr);
+      attr.type=PERF_TYPE_HARDWARE;
+      attr.config=config[icounter-1];
+      attr.disabled=(icounter==1);
+      attr.exclude_kernel=1;
+      attr.exclude_hv=1;
+      attr.read_format=PERF_FORMAT_GROUP;
+      local.fd[icounter-1]=syscall(SYS_perf_event_open,&attr,0,-1,(icounter==1) ? -1 : local.fd[0],0);
+      if (local.fd[icounter-1]<0)
+	{
+	  for (jcounter=1;jcounter<icounter;jcounter++)
+	    close(local.fd[jcounter-1]);
+	  return 1;
+	}
+      local.counts[icounter-1]=0;
+    }
+
+  return 0;
+}
+
+/*!
+\brief
+Reads and closes the group of hardware counters of the calling thread
+
+\version 1.0
+
+\date Oct 14, 2026
+
+*/
+static void closeCounters(void)
+{
+  unsigned long long group[INSTRNCOUNTERS+1];     // the number of counters, then the counts
+  int icounter;
+
+  if (read(local.fd[0],group,sizeof(group))==sizeof(group))
+    for (icounter=1;icounter<=INSTRNCOUNTERS;icounter++)
+      local.counts[icounter-1]=group[icounter];
+  for (icounter=1;icounter<=INSTRNCOUNTERS;icounter++)
+    close(local.fd[icounter-1]);
+}
+#endif
+
+/*!
+\brief
+Starts the timing of an evaluation of the likelihood
+
+\details
+With -DINSTRUMENT_PERF it also enables the hardware counters of the
+thread, opening them on its first evaluation.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\return a double with the start of the evaluation, for instrLikeEnd()
+
+*/
+double instrLikeBegin(void)
+{
+#ifdef INSTRUMENT_PERF
+  if (local.perf==0)
+    local.perf=(openCounters()==0) ? 1 : -1;
+  if (local.perf==1)
+    ioctl(local.fd[0],PERF_EVENT_IOC_ENABLE,0);
+#endif
+  return instrClock();
+}
+
+/*!
+\brief
+Ends the timing of an evaluation of the likelihood
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre start is the value returned by instrLikeBegin()
+
+@param start the start of the evaluation
+
+*/
+void instrLikeEnd(double start)
+{
+  local.tlike+=instrClock()-start;
+  local.Nlike++;
+#ifdef INSTRUMENT_PERF
+  if (local.perf==1)
+    ioctl(local.fd[0],PERF_EVENT_IOC_DISABLE,0);
+#endif
+}
+
+/*!
+\brief
+Ends the timing of the recording of a link
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre start is the value of instrClock() before the recording
+
+@param start the start of the recording
+
+*/
+void instrIOEnd(double start)
+{
+  local.tio+=instrClock()-start;
+}
+
+/*!
+\brief
+Starts the timing of a sampler loop in the calling thread
+
+\details
+Clears the times and the counts of the thread, which may have run a
+loop before, e.g., in a batch of data sets. The hardware counters stay
+open, since the evaluations of the likelihood that set up the chain
+come before the loop, and are reset.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+*/
+void instrRunBegin(void)
+{
+  int perf=local.perf;
+  int fd[INSTRNCOUNTERS];
+
+  memcpy(fd,local.fd,sizeof(fd));
+  memset(&local,0,sizeof(local));
+  local.perf=perf;
+  memcpy(local.fd,fd,sizeof(fd));
+#ifdef INSTRUMENT_PERF
+  if (local.perf==1)
+    ioctl(local.fd[0],PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+#endif
+  local.start=instrClock();
+}
+
+/*!
+\brief
+Ends the timing of a sampler loop and adds the counters of the
+calling thread to the totals of the run
+
+\details
+The acceptance ratios in windows come from the first loop that
+recorded them. The hardware counters are closed, to be opened again by
+the next evaluation of the likelihood in the thread.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+*/
+void instrRunEnd(void)
+{
+  int icounter;
+
+  local.trun=instrClock()-local.start;
+#ifdef INSTRUMENT_PERF
+  if (local.perf==1)
+    closeCounters();
+#endif
+
+  pthread_mutex_lock(&totalLock);
+  total.tlike+=local.tlike;
+  total.tio+=local.tio;
+  total.trun+=local.trun;
+  total.Nlike+=local.Nlike;
+  total.Nruns++;
+  total.Nbudget+=local.Nbudget;
+  total.Nexit+=local.Nexit;
+  total.pointsUsed+=local.pointsUsed;
+  total.pointsTotal+=local.pointsTotal;
+  if (total.Nwindows==0 && local.Nwindows>0)
+    {
+      total.Nwindows=local.Nwindows;
+      total.windowLength=local.windowLength;
+      memcpy(total.rate,local.rate,sizeof(local.rate));
+    }
+  if (local.perf==1)
+    {
+      total.perf=1;
+      for (icounter=1;icounter<=INSTRNCOUNTERS;icounter++)
+	total.counts[icounter-1]+=local.counts[icounter-1];
+    }
+  else if (local.perf==-1)
+    perfFailed++;
+  pthread_mutex_unlock(&totalLock);
+
+  if (local.perf==1)
+    {
+      local.perf=0;
+      for (icounter=1;icounter<=INSTRNCOUNTERS;icounter++)
+	local.fd[icounter-1]=-1;
+    }
+}
+
+/*!
+\brief
+Counts the data points summed by an evaluation with an early exit
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from likeBudget()
+
+@param Nused an int with the number of points summed
+
+@param Npad an int with the number of points of the data set, with the padding
+
+*/
+void instrExit(int Nused, int Npad)
+{
+  local.Nbudget++;
+  local.Nexit+=(Nused<Npad);
+  local.pointsUsed+=Nused;
+  local.pointsTotal+=Npad;
+}
+
+/*!
+\brief
+Follows the acceptance ratio of a chain in windows of its links
+
+\details
+Splits the Nlinks links of the chain in INSTRNWINDOWS windows and
+records the fraction of the links accepted in each of them.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called after every link of the chain
+
+@param ilink the number of the link, starting at 1
+@param Nlinks the total number of links of the chain
+@param Naccept the number of links accepted so far
+
+*/
+void instrAccept(long ilink, long Nlinks, long Naccept)
+{
+  long wlen=Nlinks/INSTRNWINDOWS;
+
+  if (wlen<1)
+    wlen=1;
+  if (ilink%wlen==0 && local.Nwindows<INSTRNWINDOWS)
+    {
+      local.rate[local.Nwindows]=(Naccept-local.lastAccept)/(double)wlen;
+      local.Nwindows++;
+      local.windowLength=wlen;
+      local.lastAccept=Naccept;
+    }
+}
+
+/*!
+\brief
+Writes the totals of the instrumentation to the log of the run
+
+\details
+The times are summed over the threads of the samplers, so that the
+fractions are of the thread time.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+@param logfile the log file of the run, open for writing
+
+*/
+void instrReport(FILE *logfile)
+{
+  int iwindow;
+
+  pthread_mutex_lock(&totalLock);
+  if (total.Nruns==0 || total.trun<=0.0)
+    {
+      pthread_mutex_unlock(&totalLock);
+      return;
+    }
+
+  double tother=total.trun-total.tlike-total.tio;
+  fprintf(logfile,"Instrumentation: %e s in %ld sampler loops, %.1f%% in the likelihood, %.1f%% recording the chains, %.1f%% in the proposals and the bookkeeping\n",total.trun,total.Nruns,100.*total.tlike/total.trun,100.*total.tio/total.trun,100.*tother/total.trun);
+  if (total.Nlike>0)
+    fprintf(logfile,"%ld evaluations of the likelihood, %e per second, %e ns each\n",total.Nlike,total.Nlike/total.trun,1.e9*total.tlike/total.Nlike);
+  if (total.Nbudget>0)
+    fprintf(logfile,"Early exit: %.1f%% of %ld evaluations stopped, %.1f%% of the data points skipped\n",100.*total.Nexit/total.Nbudget,total.Nbudget,100.*(1.0-total.pointsUsed/total.pointsTotal));
+  if (total.Nwindows>0)
+    {
+      fprintf(logfile,"Acceptance ratio in windows of %ld links:\n",total.windowLength);
+      for (iwindow=1;iwindow<=total.Nwindows;iwindow++)
+	fprintf(logfile,"%e\t%s",total.rate[iwindow-1],(iwindow==total.Nwindows) ? "\n" : "");
+    }
+#ifdef INSTRUMENT_PERF
+  if (total.perf==1 && total.Nlike>0)
+    fprintf(logfile,"Hardware counters per evaluation of the likelihood: %e cycles, %e instructions (%.2f per cycle), %e cache misses\n",(double)total.counts[0]/total.Nlike,(double)total.counts[1]/total.Nlike,(total.counts[0]>0) ? (double)total.counts[1]/total.counts[0] : 0.0,(double)total.counts[2]/total.Nlike);
+  if (perfFailed>0)
+    fprintf(logfile,"Hardware counters unavailable: perf_event_open failed in %d of the sampler threads\n",perfFailed);
+#endif
+  pthread_mutex_unlock(&totalLock);
+}
+
+#endif
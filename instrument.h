@@ -0,0 +1,81 @@
+/*! \file
+  \brief
+  Instrumentation of the hot paths of the samplers
+
+  \details
+  Defines the macros with which the likelihood, the chain files and the
+  sampler loops record where the time of a run goes. They expand to the
+  calls of instrument.c only if the code is compiled with -DINSTRUMENT
+  (make INSTRUMENT=1), and to nothing otherwise, so that a production
+  build does not pay for them.
+
+  INSTR_LIKE_BEGIN(t) and INSTR_LIKE_END(t) bracket an evaluation of the
+  likelihood, INSTR_IO_BEGIN(t) and INSTR_IO_END(t) the recording of a
+  link, e.g.,
+
+  INSTR_LIKE_BEGIN(tlike);
+  ...
+  INSTR_LIKE_END(tlike);
+
+  and INSTR_RUN_BEGIN() and INSTR_RUN_END() the loop of a sampler in
+  each of its threads. INSTR_ACCEPT(ilink,Nlinks,Naccept) follows the
+  acceptance ratio of one chain in windows of its links, and
+  INSTR_REPORT(logfile) writes the totals of the run to its log.
+  INSTR_EXIT(Nused,Npad) counts the data points summed by an evaluation
+  of the likelihood with an early exit (see likeBudget()).
+
+  With -DINSTRUMENT_PERF as well (make INSTRUMENT=perf), the likelihood
+  evaluations also count cycles, instructions and cache misses with the
+  hardware counters of linux (perf_event_open).
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdio.h>
+
+#define INSTRNWINDOWS 20               // windows of the running acceptance ratio
+
+#ifdef INSTRUMENT
+
+#define INSTR_LIKE_BEGIN(t)  double t=instrLikeBegin()
+#define INSTR_LIKE_END(t)    instrLikeEnd(t)
+#define INSTR_IO_BEGIN(t)    double t=instrClock()
+#define INSTR_IO_END(t)      instrIOEnd(t)
+#define INSTR_RUN_BEGIN()    instrRunBegin()
+#define INSTR_RUN_END()      instrRunEnd()
+#define INSTR_ACCEPT(ilink,Nlinks,Naccept) instrAccept(ilink,Nlinks,Naccept)
+#define INSTR_REPORT(logfile) instrReport(logfile)
+#define INSTR_EXIT(Nused,Npad) instrExit(Nused,Npad)
+
+double instrClock(void);
+double instrLikeBegin(void);
+void instrLikeEnd(double start);
+void instrIOEnd(double start);
+void instrRunBegin(void);
+void instrRunEnd(void);
+void instrAccept(long ilink, long Nlinks, long Naccept);
+void instrExit(int Nused, int Npad);
+void instrReport(FILE *logfile);
+
+#else
+
+#define INSTR_LIKE_BEGIN(t)
+#define INSTR_LIKE_END(t)
+#define INSTR_IO_BEGIN(t)
+#define INSTR_IO_END(t)
+#define INSTR_RUN_BEGIN()
+#define INSTR_RUN_END()
+#define INSTR_ACCEPT(ilink,Nlinks,Naccept)
+#define INSTR_REPORT(logfile)
+#define INSTR_EXIT(Nused,Npad)
+
+#endif
+
+#endif
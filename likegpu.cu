@@ -0,0 +1,428 @@
+/*! \file
+  \brief
+  The GPU backend of the batched likelihood, in CUDA or HIP
+
+  \details
+  Evaluates the chi-square of the visibility amplitudes of a batch of
+  parameter vectors on a GPU, for the samplers that move many walkers
+  at once (see postBatch()). Only built with make gpu (nvcc), or make
+  gpu GPUCC=hipcc for AMD GPUs, where the same source is compiled as
+  HIP through the gpu* names defined below.
+
+  The precomputed arrays of the data set (b02, uPh, vPh, Vis and
+  invVar, with the padding) are copied to the memory of the device once
+  by gpuOpen() and stay there for the whole run. Each call of gpuChi2()
+  then copies only the parameter vectors to the device and the
+  chi-squares back: one kernel launch evaluates the whole batch, with a
+  block of GPUTHREADS threads per parameter vector striding over the
+  data points, and a tree reduction in shared memory in a fixed order,
+  so that the result of a vector does not depend on the others in the
+  batch.
+
+  The kernels are those of models.c, point by point and in double
+  precision: the Gaussian models, specialized for their number of
+  components with a template (as the wrappers of models.c do with
+  forced inlining), and the ring.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning The sums are in another order than those of the SIMD
+  kernels, so that the chains agree with those of the CPU to rounding
+  only
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __HIPCC__
+#include <hip/hip_runtime.h>
+#define gpuError_t               hipError_t
+#define gpuSuccess               hipSuccess
+#define gpuMalloc                hipMalloc
+#define gpuFree                  hipFree
+#define gpuMemcpy                hipMemcpy
+#define gpuMemcpyHostToDevice    hipMemcpyHostToDevice
+#define gpuMemcpyDeviceToHost    hipMemcpyDeviceToHost
+#define gpuGetLastError          hipGetLastError
+#define gpuGetErrorString        hipGetErrorString
+#define gpuGetDevice             hipGetDevice
+#define gpuDeviceProp            hipDeviceProp_t
+#define gpuGetDeviceProperties   hipGetDeviceProperties
+#else
+#include <cuda_runtime.h>
+#define gpuError_t               cudaError_t
+#define gpuSuccess               cudaSuccess
+#define gpuMalloc                cudaMalloc
+#define gpuFree                  cudaFree
+#define gpuMemcpy                cudaMemcpy
+#define gpuMemcpyHostToDevice    cudaMemcpyHostToDevice
+#define gpuMemcpyDeviceToHost    cudaMemcpyDeviceToHost
+#define gpuGetLastError          cudaGetLastError
+#define gpuGetErrorString        cudaGetErrorString
+#define gpuGetDevice             cudaGetDevice
+#define gpuDeviceProp            cudaDeviceProp
+#define gpuGetDeviceProperties   cudaGetDeviceProperties
+#endif
+
+#include "likegpu.h"
+
+#define GPUTHREADS 256             // threads per parameter vector (a power of 2)
+#define GPUNARRAYS 5               // arrays of the data set on the device
+#define NGAUSSMAX 3                // largest number of Gaussian components
+#define MODEL_RING 0               // kind of the ring model; the Gaussians are 1..NGAUSSMAX
+
+#define ERROR_GPU 3                // error code for failures of the device
+
+//! a data set in the memory of the device
+struct gpuData
+{
+  int Npad;                        //!< number of points including the padding
+  int Nparam;                      //!< number of model parameters
+  int kind;                        //!< number of Gaussian components, or MODEL_RING
+  int Nmax;                        //!< parameter vectors the buffers have room for
+  double *block;                   //!< the arrays of the data set on the device
+  double *b02, *uPh, *vPh, *Vis, *invVar;
+  double *Aparam;                  //!< parameter vectors on the device
+  double *chi2;                    //!< chi-squares on the device
+  char device[256];                //!< name of the device
+};
+
+// prints the error of a call to the runtime, returning 1 if there is one
+static int gpuFailed(gpuError_t status, const char *call)
+{
+  if (status==gpuSuccess)
+    return 0;
+  printf("Error in %s on the GPU: %s\n",call,gpuGetErrorString(status));
+  return 1;
+}
+
+/*!
+\brief
+Sums the partial chi-squares of the threads of a block
+
+\details
+A tree reduction in shared memory, in the same order at every launch.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param partial[] an array of GPUTHREADS doubles in shared memory
+
+@param sum a double with the partial chi-square of the calling thread
+
+@param result a pointer to the chi-square of the block on return
+
+*/
+static __device__ void reduceBlock(double partial[], double sum, double *result)
+{
+  int stride;
+
+  partial[threadIdx.x]=sum;
+  __syncthreads();
+  for (stride=GPUTHREADS/2;stride>0;stride/=2)
+    {
+      if (threadIdx.x<stride)
+	partial[threadIdx.x]+=partial[threadIdx.x+stride];
+      __syncthreads();
+    }
+  if (threadIdx.x==0)
+    *result=partial[0];
+}
+
+/*!
+\brief
+Calculates the chi-square of NGAUSS Gaussian components for a batch of parameter vectors
+
+\details
+The same model as gaussChi2() in models.c; block b of the launch
+evaluates parameter vector b over all the data points.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+*/
+template<int NGAUSS>
+static __global__ void gaussKernel(int Npad, int Nparam, const double *Aparam, const double *b02, const double *uPh, const double *vPh, const double *Vis, const double *invVar, double *chi2)
+{
+  __shared__ double partial[GPUTHREADS];
+  const double aux=2.*M_PI*M_PI;   // aux quantity used a lot below
+  const double *A=Aparam+(size_t)blockIdx.x*Nparam;
+  double xdisp[NGAUSSMAX], ydisp[NGAUSSMAX], flux[NGAUSSMAX], width[NGAUSSMAX];
+  double sum=0.0;
+  int index, k;
+
+  // parameter combinations common to all data points
+  double flux1=A[0];
+  double width1=-aux*A[1]*A[1];
+  for (k=1;k<NGAUSS;k++)
+    {
+      xdisp[k]=A[4*k-2];
+      ydisp[k]=A[4*k-1];
+      flux[k]=A[4*k];
+      width[k]=-aux*A[4*k+1]*A[4*k+1];
+    }
+
+  for (index=threadIdx.x;index<Npad;index+=GPUTHREADS)
+    {
+      // Gaussian 1 (zero centered)
+      double Vr=flux1*exp(width1*b02[index]);
+      double Vi=0.0;
+
+      // amplitude, phase, real and imaginary parts of the displaced Gaussians
+#pragma unroll
+      for (k=1;k<NGAUSS;k++)
+	{
+	  double Vk=flux[k]*exp(width[k]*b02[index]);
+	  double sink, cosk;
+	  sincos(xdisp[k]*uPh[index]+ydisp[k]*vPh[index],&sink,&cosk);
+	  Vr+=Vk*cosk;
+	  Vi+=Vk*sink;
+	}
+
+      // difference between model amplitude and data
+      double variance=Vis[index]-sqrt(Vr*Vr+Vi*Vi);
+      sum+=variance*variance*invVar[index];
+    }
+
+  reduceBlock(partial,sum,chi2+blockIdx.x);
+}
+
+/*!
+\brief
+Calculates the chi-square of a blurred thin ring for a batch of parameter vectors
+
+\details
+The same model as ringChi2() in models.c; block b of the launch
+evaluates parameter vector b over all the data points.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+*/
+static __global__ void ringKernel(int Npad, int Nparam, const double *Aparam, const double *b02, const double *Vis, const double *invVar, double *chi2)
+{
+  __shared__ double partial[GPUTHREADS];
+  const double aux=2.*M_PI*M_PI;   // aux quantity used a lot below
+  const double *A=Aparam+(size_t)blockIdx.x*Nparam;
+  double sum=0.0;
+  int index;
+
+  double flux=A[0];
+  double kradius=2.*M_PI*A[1];
+  double width=-aux*A[2]*A[2];
+
+  for (index=threadIdx.x;index<Npad;index+=GPUTHREADS)
+    {
+      double V=flux*j0(kradius*sqrt(b02[index]))*exp(width*b02[index]);
+      double variance=Vis[index]-fabs(V);
+      sum+=variance*variance*invVar[index];
+    }
+
+  reduceBlock(partial,sum,chi2+blockIdx.x);
+}
+
+/*!
+\brief
+Copies a data set to the memory of the device
+
+\details
+Allocates one block of device memory for the GPUNARRAYS arrays the
+kernels read, each of Npad doubles, and copies them from the host,
+padding included. The buffers of the parameter vectors are allocated
+by the first gpuChi2().
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre A device is available; it is called from startGPU()
+
+@param Npad an int with the number of points including the padding
+
+@param b02[] an array of doubles with the baseline lengths squared
+
+@param uPh[] an array of doubles with the phase factors in u
+
+@param vPh[] an array of doubles with the phase factors in v
+
+@param Vis[] an array of doubles with the visibility amplitudes
+
+@param invVar[] an array of doubles with the inverse variances
+
+@param model a string with the name of the model (see models.c)
+
+@param Nparam an int with the number of model parameters
+
+\return a pointer to the data set on the device, or NULL if the model
+has no kernel here or the device failed
+
+*/
+extern "C" gpuData *gpuOpen(int Npad, double b02[], double uPh[], double vPh[], double Vis[], double invVar[], char model[], int Nparam)
+{
+  double *source[GPUNARRAYS]={b02,uPh,vPh,Vis,invVar};
+  gpuDeviceProp prop;
+  gpuData *gpu;
+  int kind, device, iarray;
+
+  // the models with a kernel here
+  if (strcmp(model,"ring")==0)
+    kind=MODEL_RING;
+  else if (strncmp(model,"gauss",5)==0 && (Nparam+2)%4==0 && (Nparam+2)/4>=1 && (Nparam+2)/4<=NGAUSSMAX)
+    kind=(Nparam+2)/4;
+  else
+    {
+      printf("The model %s has no GPU kernel\n",model);
+      return NULL;
+    }
+
+  if (gpuFailed(gpuGetDevice(&device),"gpuGetDevice") || gpuFailed(gpuGetDeviceProperties(&prop,device),"gpuGetDeviceProperties"))
+    return NULL;
+
+  gpu=(gpuData *)calloc(1,sizeof(gpuData));
+  if (gpu==NULL)
+    {
+      printf("Error allocating memory for the GPU\n");
+      return NULL;
+    }
+  gpu->Npad=Npad;
+  gpu->Nparam=Nparam;
+  gpu->kind=kind;
+  snprintf(gpu->device,sizeof(gpu->device),"%s",prop.name);
+
+  if (gpuFailed(gpuMalloc((void **)&gpu->block,(size_t)GPUNARRAYS*Npad*sizeof(double)),"gpuMalloc"))
+    {
+      free(gpu);
+      return NULL;
+    }
+  for (iarray=1;iarray<=GPUNARRAYS;iarray++)
+    if (gpuFailed(gpuMemcpy(gpu->block+(size_t)(iarray-1)*Npad,source[iarray-1],(size_t)Npad*sizeof(double),gpuMemcpyHostToDevice),"gpuMemcpy"))
+      {
+	gpuClose(gpu);
+	return NULL;
+      }
+  gpu->b02=gpu->block;
+  gpu->uPh=gpu->block+(size_t)Npad;
+  gpu->vPh=gpu->block+2*(size_t)Npad;
+  gpu->Vis=gpu->block+3*(size_t)Npad;
+  gpu->invVar=gpu->block+4*(size_t)Npad;
+
+  return gpu;
+}
+
+/*!
+\brief
+Calculates the chi-square of a batch of parameter vectors on the device
+
+\details
+Copies the Nbatch parameter vectors to the device, growing its
+buffers if the batch is larger than any before, launches the kernel of
+the model with one block per vector and copies the Nbatch
+chi-squares back, which waits for the kernel to finish.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The data set was copied to the device by gpuOpen()
+
+@param gpu a pointer to the data set on the device
+
+@param Nbatch an int with the number of parameter vectors
+
+@param Aparam[] an array of Nbatch*Nparam doubles with the model parameters
+
+@param chi2[] an array of Nbatch doubles with the chi-squares on return
+
+\return zero if all was OK, ERROR_GPU if the device failed
+
+*/
+extern "C" int gpuChi2(gpuData *gpu, int Nbatch, double Aparam[], double chi2[])
+{
+  if (Nbatch<=0)
+    return 0;
+
+  if (Nbatch>gpu->Nmax)
+    {
+      gpuFree(gpu->Aparam);
+      gpuFree(gpu->chi2);
+      gpu->Aparam=gpu->chi2=NULL;
+      gpu->Nmax=0;
+      if (gpuFailed(gpuMalloc((void **)&gpu->Aparam,(size_t)Nbatch*gpu->Nparam*sizeof(double)),"gpuMalloc") ||
+	  gpuFailed(gpuMalloc((void **)&gpu->chi2,(size_t)Nbatch*sizeof(double)),"gpuMalloc"))
+	return ERROR_GPU;
+      gpu->Nmax=Nbatch;
+    }
+
+  if (gpuFailed(gpuMemcpy(gpu->Aparam,Aparam,(size_t)Nbatch*gpu->Nparam*sizeof(double),gpuMemcpyHostToDevice),"gpuMemcpy"))
+    return ERROR_GPU;
+
+  switch (gpu->kind)
+    {
+    case 1:
+      gaussKernel<1><<<Nbatch,GPUTHREADS>>>(gpu->Npad,gpu->Nparam,gpu->Aparam,gpu->b02,gpu->uPh,gpu->vPh,gpu->Vis,gpu->invVar,gpu->chi2);
+      break;
+    case 2:
+      gaussKernel<2><<<Nbatch,GPUTHREADS>>>(gpu->Npad,gpu->Nparam,gpu->Aparam,gpu->b02,gpu->uPh,gpu->vPh,gpu->Vis,gpu->invVar,gpu->chi2);
+      break;
+    case 3:
+      gaussKernel<3><<<Nbatch,GPUTHREADS>>>(gpu->Npad,gpu->Nparam,gpu->Aparam,gpu->b02,gpu->uPh,gpu->vPh,gpu->Vis,gpu->invVar,gpu->chi2);
+      break;
+    default:
+      ringKernel<<<Nbatch,GPUTHREADS>>>(gpu->Npad,gpu->Nparam,gpu->Aparam,gpu->b02,gpu->Vis,gpu->invVar,gpu->chi2);
+      break;
+    }
+  if (gpuFailed(gpuGetLastError(),"the kernel launch"))
+    return ERROR_GPU;
+
+  if (gpuFailed(gpuMemcpy(chi2,gpu->chi2,(size_t)Nbatch*sizeof(double),gpuMemcpyDeviceToHost),"gpuMemcpy"))
+    return ERROR_GPU;
+
+  return 0;
+}
+
+/*!
+\brief
+Returns the name of the device of a data set
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param gpu a pointer to the data set on the device
+
+\return a string with the name of the device
+
+*/
+extern "C" const char *gpuDevice(gpuData *gpu)
+{
+  return gpu->device;
+}
+
+/*!
+\brief
+Frees the memory of a data set on the device
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param gpu a pointer to the data set on the device, or NULL
+
+*/
+extern "C" void gpuClose(gpuData *gpu)
+{
+  if (gpu==NULL)
+    return;
+
+  gpuFree(gpu->block);
+  gpuFree(gpu->Aparam);
+  gpuFree(gpu->chi2);
+  free(gpu);
+}
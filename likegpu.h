@@ -0,0 +1,42 @@
+/*! \file
+  \brief
+  The interface of the GPU backend of the batched likelihood
+
+  \details
+  Declares the functions of likegpu.cu, compiled with nvcc (CUDA) or
+  hipcc (HIP) in builds with USE_GPU (make gpu). The interface takes
+  plain arrays rather than a dataset, so that it can be included from
+  both the C files and the device code; the samplers reach it through
+  postBatch() (see startGPU() in chain.c).
+
+  gpuOpen() copies the precomputed arrays of a data set to the memory of
+  the device once, gpuChi2() evaluates the chi-square of a whole batch
+  of parameter vectors with one kernel launch, and gpuClose() releases
+  the device memory.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#ifndef LIKEGPU_H
+#define LIKEGPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gpuData gpuData;      //!< a data set in the memory of the device (see likegpu.cu)
+
+extern gpuData *gpuOpen(int Npad, double b02[], double uPh[], double vPh[], double Vis[], double invVar[], char model[], int Nparam);
+extern int gpuChi2(gpuData *gpu, int Nbatch, double Aparam[], double chi2[]);
+extern const char *gpuDevice(gpuData *gpu);
+extern void gpuClose(gpuData *gpu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1033 @@
+/*! \file
+  \brief
+  The likelihood engine: data preparation and the cache of the model
+
+  \details
+  The data are stored and precomputed here for the SIMD chi-square
+  kernels of the models (see models.c and simd.h), which are called
+  through chi2Data(), or through chi2Terms() when the data also have
+  complex or closure terms. For the 2-Gaussian model, the components of the
+  model can also be cached (see modelCache), so that steps in one
+  block of parameters re-evaluate only that block.
+
+  The chi-square of the amplitudes can also be calculated with the
+  single-precision kernels of the models, from a copy of the data in
+  floats (see singleData()), or with both kernels, to find how far the
+  single-precision one is from the double one on the proposals of a run.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mcmc.h"
+#include "simd.h"
+
+#define ERROR_MEMORY 2             // error code for failed allocations
+
+#define NSINGLE 5                  // number of the arrays in floats
+
+/*!
+\brief
+The differences between the single-precision and the double kernels
+
+\details
+Accumulated by chi2Data() with PRECISION_VALIDATE, under a lock, since
+the chains of a run may evaluate the likelihood concurrently.
+
+*/
+struct precisionCheck
+{
+  pthread_mutex_t lock;                //!< serializes the updates
+  long Nevals;                         //!< evaluations compared
+  double sumDiff;                      //!< sum of the differences (single minus double)
+  double sumDiff2;                     //!< sum of their squares
+  double maxDiff;                      //!< largest absolute difference
+  double maxRel;                       //!< largest difference relative to the chi-square
+};
+
+// the visibilities of chi2Terms(), kept by each thread, with the
+// number of data points they hold
+static pthread_key_t termsKey;
+static pthread_once_t termsOnce=PTHREAD_ONCE_INIT;
+static _Thread_local int termsNpad;
+
+// the key of the visibilities, which are freed when their thread exits
+static void makeTermsKey(void)
+{
+  pthread_key_create(&termsKey,free);
+}
+
+/*!
+\brief
+Allocates the storage of a data set
+
+\details
+Allocates a single block of memory, aligned to DATA_ALIGN bytes, that
+holds all the arrays of the data set with room for Nmax points each,
+and sets all the entries to zero. Nmax is rounded up to a multiple
+of DATA_PAD, so that every array in the block is aligned as well.
+
+The data points already in the data set (if any) are copied to the
+new storage, so that the function can be used to grow a data set
+while it is being read.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from readData() and prepareData()
+
+@param data a pointer to the data set
+
+@param Nmax an int with the number of points to make room for
+
+\return zero if all was OK, ERROR_MEMORY if the allocation failed
+
+*/
+int allocData(dataset *data, int Nmax)
+{
+  const int Narrays=8;            // number of arrays in the data set
+  double *block, **arrays[8];
+  void *ptr;
+  int iarray, Nold=data->Nmax;
+
+  Nmax=((Nmax+DATA_PAD-1)/DATA_PAD)*DATA_PAD;
+  if (Nmax<DATA_PAD)
+    Nmax=DATA_PAD;
+
+  if (posix_memalign(&ptr,DATA_ALIGN,(size_t)Narrays*Nmax*sizeof(double))!=0)
+    {
+      printf("Error allocating memory for %d data points\n",Nmax);
+      return ERROR_MEMORY;
+    }
+  block=(double *)ptr;
+  memset(block,0,(size_t)Narrays*Nmax*sizeof(double));
+
+  arrays[0]=&data->uCo;   arrays[1]=&data->vCo;
+  arrays[2]=&data->Vis;   arrays[3]=&data->Sigma;
+  arrays[4]=&data->b02;   arrays[5]=&data->uPh;
+  arrays[6]=&data->vPh;   arrays[7]=&data->invVar;
+
+  for (iarray=1;iarray<=Narrays;iarray++)
+    {
+      double *array=block+(size_t)(iarray-1)*Nmax;
+      if (data->block!=NULL && data->Npts>0)
+	memcpy(array,*arrays[iarray-1],(size_t)((data->Npts<Nold) ? data->Npts : Nold)*sizeof(double));
+      *arrays[iarray-1]=array;
+    }
+
+  free(data->block);
+  data->block=block;
+  data->Nmax=Nmax;
+
+  return 0;
+}
+
+/*!
+\brief
+Calculates the per-point quantities used by the likelihood kernel
+
+\details
+For each of the Npts points of the data set, calculates once the
+quantities that the model needs for every point: the baseline length
+squared and the phase factors (both in units of microarcsec, so that
+the model parameters can be used directly) and the inverse variance
+of each point. The padding points up to Npad have zero inverse
+variance, so they do not contribute to the chi-square.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from readData() and prepareData() once the data points are stored
+
+@param data a pointer to the data set with the data points stored
+
+*/
+void precomputeData(dataset *data)
+{
+  int index;
+
+  data->Npad=((data->Npts+DATA_PAD-1)/DATA_PAD)*DATA_PAD;
+
+  for (index=1;index<=data->Npts;index++)
+    {
+      double uCo=data->uCo[index-1], vCo=data->vCo[index-1];
+
+      data->b02[index-1]=(uCo*uCo+vCo*vCo)*muarcsecToRad*muarcsecToRad;
+      data->uPh[index-1]=-2.*M_PI*uCo*muarcsecToRad;
+      data->vPh[index-1]=-2.*M_PI*vCo*muarcsecToRad;
+      data->invVar[index-1]=1./(data->Sigma[index-1]*data->Sigma[index-1]);
+    }
+
+  // the padding is not a data point
+  for (index=data->Npts+1;index<=data->Npad;index++)
+    {
+      data->uCo[index-1]=data->vCo[index-1]=data->Vis[index-1]=data->Sigma[index-1]=0.0;
+      data->b02[index-1]=data->uPh[index-1]=data->vPh[index-1]=data->invVar[index-1]=0.0;
+    }
+}
+
+/*!
+\brief
+Prepares a data set for the likelihood kernel from plain arrays
+
+\details
+Allocates the storage of the data set, copies the Npts data points
+into it and calculates the quantities used by the likelihood kernel
+(see precomputeData()).
+
+\version 1.5
+
+\date Oct 14, 2026
+
+\pre It is called for data that were not read with readData()
+
+@param data a pointer to the data set to fill
+
+@param Npts an int with the number of data points
+
+@param uCo[] an array of doubles with the u-coordinates of the data
+
+@param vCo[] an array of doubles with the v-coordinates of the data
+
+@param Vis[] an array of doubles with the visibility amplitudes
+
+@param Sigma[] an array of doubles with the errors
+
+\return zero if all was OK, ERROR_MEMORY if an allocation failed
+
+*/
+int prepareData(dataset *data, int Npts, double uCo[], double vCo[], double Vis[], double Sigma[])
+{
+  int index;
+
+  data->block=NULL;
+  data->Npts=data->Npad=data->Nmax=0;
+  data->model=findModel(DEFAULT_MODEL);
+  data->Nterms=data->Nvis=data->Ncphase=data->Nlcamp=0;
+  data->termIndex=NULL;
+  data->termBlock=NULL;
+  data->chi2Offset=0.0;
+  data->earlyExit=0;
+  data->precision=PRECISION_DOUBLE;
+  data->blockf=NULL;
+  data->check=NULL;
+  data->pool=NULL;
+  data->gpu=NULL;
+
+  if (allocData(data,Npts)!=0)
+    return ERROR_MEMORY;
+
+  data->Npts=Npts;
+  for (index=1;index<=Npts;index++)
+    {
+      data->uCo[index-1]=uCo[index-1];
+      data->vCo[index-1]=vCo[index-1];
+      data->Vis[index-1]=Vis[index-1];
+      data->Sigma[index-1]=Sigma[index-1];
+    }
+
+  precomputeData(data);
+
+  return 0;
+}
+
+/*!
+\brief
+Sets up the single-precision kernel of a data set
+
+\details
+For PRECISION_SINGLE and PRECISION_VALIDATE, allocates a block of
+memory, aligned like that of the data set, with the precomputed
+arrays (b02, uPh, vPh, invVar) and the amplitudes rounded to floats,
+padding included, for the single-precision kernel of the model (see
+chi2Data()). The single-precision arrays take half the memory, and so
+half the bandwidth, of the double ones. For PRECISION_VALIDATE, it also
+sets up the differences of the two kernels, for reportPrecision().
+
+If the model has no single-precision kernel, the data set keeps to the
+double one.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main() after binData() and setModel(), since
+both change what the kernel needs
+
+@param data a pointer to the prepared data set
+
+@param precision an int with PRECISION_DOUBLE, PRECISION_SINGLE or PRECISION_VALIDATE
+
+\return zero if all was OK, ERROR_MEMORY if an allocation failed
+
+*/
+int singleData(dataset *data, int precision)
+{
+  double *source[NSINGLE]={data->b02,data->uPh,data->vPh,data->Vis,data->invVar};
+  float **arrays[NSINGLE]={&data->b02f,&data->uPhf,&data->vPhf,&data->Visf,&data->invVarf};
+  void *ptr;
+  int iarray, index;
+
+  data->precision=PRECISION_DOUBLE;
+  if (precision==PRECISION_DOUBLE)
+    return 0;
+  if (data->model->chi2f==NULL)
+    {
+      printf("The model %s has no single-precision kernel, using the double one\n",data->model->name);
+      return 0;
+    }
+
+  if (posix_memalign(&ptr,DATA_ALIGN,(size_t)NSINGLE*data->Npad*sizeof(float))!=0)
+    {
+      printf("Error allocating memory for %d data points in single precision\n",data->Npad);
+      return ERROR_MEMORY;
+    }
+  free(data->blockf);
+  data->blockf=ptr;
+
+  // Npad is a multiple of DATA_PAD, so every array is aligned
+  for (iarray=1;iarray<=NSINGLE;iarray++)
+    {
+      float *array=data->blockf+(size_t)(iarray-1)*data->Npad;
+      for (index=1;index<=data->Npad;index++)
+	array[index-1]=(float)source[iarray-1][index-1];
+      *arrays[iarray-1]=array;
+    }
+
+  if (precision==PRECISION_VALIDATE && data->check==NULL)
+    {
+      data->check=calloc(1,sizeof(precisionCheck));
+      if (data->check==NULL)
+	{
+	  printf("Error allocating memory for the validation of the single-precision kernel\n");
+	  return ERROR_MEMORY;
+	}
+      pthread_mutex_init(&data->check->lock,NULL);
+    }
+
+  data->precision=precision;
+  return 0;
+}
+
+/*!
+\brief
+Frees the storage of a data set
+
+\version 1.4
+
+\date Oct 14, 2026
+
+@param data a pointer to the data set
+
+*/
+void freeData(dataset *data)
+{
+  stopPool(data);
+  free(data->block);
+  free(data->termIndex);
+  free(data->termBlock);
+  free(data->blockf);
+  if (data->check!=NULL)
+    pthread_mutex_destroy(&data->check->lock);
+  free(data->check);
+
+  data->block=NULL;
+  data->uCo=data->vCo=data->Vis=data->Sigma=NULL;
+  data->b02=data->uPh=data->vPh=data->invVar=NULL;
+  data->Npts=data->Npad=data->Nmax=0;
+  data->termIndex=NULL;
+  data->termBlock=NULL;
+  data->Nterms=data->Nvis=data->Ncphase=data->Nlcamp=0;
+  data->chi2Offset=0.0;
+  data->precision=PRECISION_DOUBLE;
+  data->blockf=NULL;
+  data->b02f=data->uPhf=data->vPhf=data->Visf=data->invVarf=NULL;
+  data->check=NULL;
+}
+
+/*!
+\brief
+The cell of the (u,v) plane of a data point, for binData()
+
+*/
+typedef struct
+{
+  double ucell;                        //!< u index of the cell (or u itself)
+  double vcell;                        //!< v index of the cell (or v itself)
+  int index;                           //!< data point (from 0)
+} uvCell;
+
+// orders the data points by cell, for qsort()
+static int compareCells(const void *a, const void *b)
+{
+  const uvCell *ca=a, *cb=b;
+
+  if (ca->ucell!=cb->ucell)
+    return (ca->ucell<cb->ucell) ? -1 : 1;
+  if (ca->vcell!=cb->vcell)
+    return (ca->vcell<cb->vcell) ? -1 : 1;
+  return ca->index-cb->index;
+}
+
+/*!
+\brief
+Merges the data points of redundant baselines into weighted bins
+
+\details
+Groups the data points that fall in the same cell of size
+binSize x binSize of the (u,v) plane, or that have the same baseline
+if binSize is zero, and replaces each group by a single point with
+inverse-variance weight W = sum 1/Sigma_i^2 at the weighted mean
+baseline, with the weighted mean amplitude Vbar and error 1/sqrt(W).
+Because the visibility amplitude of a baseline (u,v) is the same as
+that of (-u,-v), the baselines are first folded to u>0.
+
+For a group of points with the same model amplitude V, the
+chi-square is exactly
+   sum (V_i - V)^2/Sigma_i^2 = W (Vbar - V)^2 + sum (V_i - Vbar)^2/Sigma_i^2,
+so the last sum, which does not depend on the model, is added to
+data->chi2Offset and the chi-square of the bins equals that of the
+original points. This is exact for identical baselines and an
+approximation, which improves with smaller cells, otherwise.
+
+The per-point quantities of the likelihood kernel are recalculated
+for the bins (see precomputeData()).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main() after readData() and before readClosures()
+
+@param data a pointer to the data set, read by readData()
+
+@param binSize a double with the size of the cells, in the units of
+uCo and vCo, or zero to merge identical baselines only
+
+\return zero if all was OK, ERROR_MEMORY if an allocation failed or
+the data set has complex or closure terms, which index the points
+
+*/
+int binData(dataset *data, double binSize)
+{
+  int Npts=data->Npts;
+  int index, ibin, Nbins;
+  uvCell *cells;
+
+  if (data->Nterms>0)
+    {
+      printf("Data with complex or closure terms can not be binned\n");
+      return ERROR_MEMORY;
+    }
+
+  cells=malloc((Npts+1)*sizeof(uvCell));
+  if (cells==NULL)
+    {
+      printf("Error allocating memory for the bins of %d data points\n",Npts);
+      return ERROR_MEMORY;
+    }
+
+  // fold the baselines to u>0 (or u=0, v>=0) and find their cells
+  for (index=1;index<=Npts;index++)
+    {
+      double uCo=data->uCo[index-1], vCo=data->vCo[index-1];
+
+      if (uCo<0.0 || (uCo==0.0 && vCo<0.0))
+	{
+	  data->uCo[index-1]=uCo=-uCo;
+	  data->vCo[index-1]=vCo=-vCo;
+	}
+      cells[index-1].ucell=(binSize>0.0) ? floor(uCo/binSize) : uCo;
+      cells[index-1].vcell=(binSize>0.0) ? floor(vCo/binSize) : vCo;
+      cells[index-1].index=index-1;
+    }
+  qsort(cells,Npts,sizeof(uvCell),compareCells);
+
+  // copy the points out in the sorted order, so that the bins can be
+  // written back in place
+  double *copy=malloc(4*(size_t)(Npts+1)*sizeof(double));
+  if (copy==NULL)
+    {
+      printf("Error allocating memory for the bins of %d data points\n",Npts);
+      free(cells);
+      return ERROR_MEMORY;
+    }
+  for (index=1;index<=Npts;index++)
+    {
+      int ipt=cells[index-1].index;
+      copy[4*(index-1)]=data->uCo[ipt];
+      copy[4*(index-1)+1]=data->vCo[ipt];
+      copy[4*(index-1)+2]=data->Vis[ipt];
+      copy[4*(index-1)+3]=data->Sigma[ipt];
+    }
+
+  // merge each run of points in the same cell
+  Nbins=0;
+  for (index=1;index<=Npts;)
+    {
+      double W=0.0, Wu=0.0, Wv=0.0, WVis=0.0;
+      int first=index;
+
+      for (;index<=Npts && cells[index-1].ucell==cells[first-1].ucell &&
+	     cells[index-1].vcell==cells[first-1].vcell;index++)
+	{
+	  double *point=copy+4*(index-1);
+	  double weight=1./(point[3]*point[3]);
+	  W+=weight;
+	  Wu+=weight*point[0];
+	  Wv+=weight*point[1];
+	  WVis+=weight*point[2];
+	}
+
+      // a point alone in its cell is kept as it is
+      if (index==first+1)
+	{
+	  data->uCo[Nbins]=copy[4*(first-1)];
+	  data->vCo[Nbins]=copy[4*(first-1)+1];
+	  data->Vis[Nbins]=copy[4*(first-1)+2];
+	  data->Sigma[Nbins]=copy[4*(first-1)+3];
+	  Nbins++;
+	  continue;
+	}
+
+      double Vbar=WVis/W;
+      for (ibin=first;ibin<index;ibin++)
+	{
+	  double *point=copy+4*(ibin-1);
+	  data->chi2Offset+=(point[2]-Vbar)*(point[2]-Vbar)/(point[3]*point[3]);
+	}
+
+      data->uCo[Nbins]=Wu/W;
+      data->vCo[Nbins]=Wv/W;
+      data->Vis[Nbins]=Vbar;
+      data->Sigma[Nbins]=1./sqrt(W);
+      Nbins++;
+    }
+
+  free(copy);
+  free(cells);
+
+  data->Npts=Nbins;
+  precomputeData(data);
+
+  return 0;
+}
+
+/*!
+\brief
+Calculates the chi-square of the model over a range of data points
+
+\details
+Calls the SIMD kernel of the model fit to the data set (see setModel()),
+so that the choice of model costs one indirect call per evaluation of
+the likelihood rather than one per data point.
+
+With PRECISION_SINGLE, the kernel is the single-precision one of the
+model (see singleData()). With PRECISION_VALIDATE, both kernels are
+called, the difference of their results is added to those of the data
+set (see reportPrecision()) and the result is that of the double one,
+so that the chains are those of PRECISION_DOUBLE.
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from like()
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+\return a double with the chi-square of the points in the range
+
+*/
+double chi2Data(int Nparam, double Aparam[], dataset *data, int first, int last)
+{
+  if (data->precision==PRECISION_SINGLE)
+    return data->model->chi2f(Nparam,Aparam,data,first,last);
+
+  double result=data->model->chi2(Nparam,Aparam,data,first,last);
+
+  if (data->precision==PRECISION_VALIDATE)
+    {
+      precisionCheck *check=data->check;
+      double diff=data->model->chi2f(Nparam,Aparam,data,first,last)-result;
+
+      pthread_mutex_lock(&check->lock);
+      check->Nevals++;
+      check->sumDiff+=diff;
+      check->sumDiff2+=diff*diff;
+      if (fabs(diff)>check->maxDiff)
+	check->maxDiff=fabs(diff);
+      if (result>0.0 && fabs(diff)/result>check->maxRel)
+	check->maxRel=fabs(diff)/result;
+      pthread_mutex_unlock(&check->lock);
+    }
+
+  return result;
+}
+
+/*!
+\brief
+Writes the differences between the single-precision and the double kernels to the log of the run
+
+\details
+The differences are those of the chi-square, i.e., of minus the log
+likelihood; the difference of the log posteriors of two positions,
+on which a Metropolis test depends, is off by at most twice the
+largest of them. The kernels are called once per evaluation, or once
+per block of points with the early exit (see likeBudget()).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The run had PRECISION_VALIDATE (see singleData())
+
+@param logfile the log file of the run, open for writing
+
+@param data a pointer to the data set
+
+*/
+void reportPrecision(FILE *logfile, dataset *data)
+{
+  precisionCheck *check=data->check;
+
+  if (check==NULL || check->Nevals==0)
+    return;
+
+  double mean=check->sumDiff/check->Nevals;
+  double rms=sqrt(check->sumDiff2/check->Nevals);
+  fprintf(logfile,"Single-precision chi-square against the double one in %ld calls of the kernels: differences of %e on average, %e rms, %e at most (%e relative)\n",check->Nevals,mean,rms,check->maxDiff,check->maxRel);
+}
+
+/*!
+\brief
+Calculates the chi-square of the amplitudes and of the complex and closure terms
+
+\details
+Evaluates the complex visibilities of the model once at every data
+point, with the kernel of the model, and from them calculates in a
+single pass:
+
+- the chi-square of the visibility amplitudes of the points with
+  nonzero inverse variance,
+
+- the chi-square of the complex visibilities, sum |V - V_model|^2 /
+  Sigma^2, with the error Sigma of the point in each of the real and
+  imaginary parts,
+
+- the chi-square of the closure phases, sum 2 (1 - cos(phi -
+  phi_model)) / sigma^2, where the model closure phase is that of the
+  bispectrum of the three points of the triangle (conjugated for
+  negative indices), so that no arctangent is needed,
+
+- the chi-square of the log closure amplitudes, sum (lnA - lnA_model)^2
+  / sigma^2, with lnA = ln(|V1||V2|/(|V3||V4|)) over the four points of
+  the quadrangle.
+
+Each closure term reuses the visibilities of its points instead of
+evaluating the model again. The visibilities go to storage that each
+thread allocates on its first call and keeps, growing it only for a
+larger data set, so that the chains of a run can call it at once.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from like() when the data set has terms read by readClosures()
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+\return a double with the chi-square
+
+*/
+double chi2Terms(int Nparam, double Aparam[], dataset *data)
+{
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  double *Vr, *Vi;
+  void *ptr;
+  int index, lane, iterm;
+
+  pthread_once(&termsOnce,makeTermsKey);
+  ptr=pthread_getspecific(termsKey);
+  if (ptr==NULL || termsNpad<data->Npad)
+    {
+      free(ptr);
+      pthread_setspecific(termsKey,NULL);
+      termsNpad=0;
+      if (posix_memalign(&ptr,DATA_ALIGN,2*(size_t)data->Npad*sizeof(double))!=0)
+	{
+	  printf("Error allocating memory for %d visibilities\n",data->Npad);
+	  return 1.e34;
+	}
+      pthread_setspecific(termsKey,ptr);
+      termsNpad=data->Npad;
+    }
+  Vr=ptr;
+  Vi=Vr+data->Npad;
+
+  // one evaluation of the model per data point
+  data->model->vis(Nparam,Aparam,data,0,data->Npad,Vr,Vi);
+
+  // visibility amplitudes
+  vdouble chi2=vset(0.0);
+  for (index=0;index<data->Npad;index+=VLEN)
+    {
+      vdouble Vreal=vload(Vr+index), Vimag=vload(Vi+index);
+      vdouble variance=vload(data->Vis+index)-vsqrt(Vreal*Vreal+Vimag*Vimag);
+      chi2+=variance*variance*vload(data->invVar+index);
+    }
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  // complex visibilities
+  for (iterm=1;iterm<=data->Nvis;iterm++)
+    {
+      int ipt=data->visIndex[iterm-1]-1;
+      double dr=data->visRe[iterm-1]-Vr[ipt];
+      double di=data->visIm[iterm-1]-Vi[ipt];
+      result+=(dr*dr+di*di)/(data->Sigma[ipt]*data->Sigma[ipt]);
+    }
+
+  // closure phases, from the bispectrum of each triangle
+  for (iterm=1;iterm<=data->Ncphase;iterm++)
+    {
+      double Br=1.0, Bi=0.0;
+      int ivert;
+      for (ivert=1;ivert<=3;ivert++)
+	{
+	  int ipt=data->cphaseIndex[3*(iterm-1)+ivert-1];
+	  double Vreal=Vr[abs(ipt)-1];
+	  double Vimag=(ipt>0) ? Vi[ipt-1] : -Vi[-ipt-1];
+	  double Bnew=Br*Vreal-Bi*Vimag;
+	  Bi=Br*Vimag+Bi*Vreal;
+	  Br=Bnew;
+	}
+      double Bamp=sqrt(Br*Br+Bi*Bi);
+      // cosine of the difference between the measured and model closure phases
+      double cosDiff=(Bamp>0.0) ? (data->cphaseCos[iterm-1]*Br+data->cphaseSin[iterm-1]*Bi)/Bamp : 0.0;
+      result+=2.*(1.-cosDiff)*data->cphaseInvVar[iterm-1];
+    }
+
+  // log closure amplitudes of each quadrangle
+  for (iterm=1;iterm<=data->Nlcamp;iterm++)
+    {
+      int *ipt=data->lcampIndex+4*(iterm-1);
+      double V1=Vr[ipt[0]-1]*Vr[ipt[0]-1]+Vi[ipt[0]-1]*Vi[ipt[0]-1];
+      double V2=Vr[ipt[1]-1]*Vr[ipt[1]-1]+Vi[ipt[1]-1]*Vi[ipt[1]-1];
+      double V3=Vr[ipt[2]-1]*Vr[ipt[2]-1]+Vi[ipt[2]-1]*Vi[ipt[2]-1];
+      double V4=Vr[ipt[3]-1]*Vr[ipt[3]-1]+Vi[ipt[3]-1]*Vi[ipt[3]-1];
+      double delta=data->lcamp[iterm-1]-0.5*log((V1*V2)/(V3*V4));
+      result+=delta*delta*data->lcampInvVar[iterm-1];
+    }
+
+  return result;
+}
+
+/*!
+\brief
+Calculates the chi-square from the cached components of the model
+
+\details
+Combines, for every data point, the real part of Gaussian 1, the
+amplitude of Gaussian 2 and the cosine and sine of its phase into the
+model amplitude, in the same order of operations as chi2Data(), so
+that the two agree to rounding.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from fillCache() and chi2Block()
+
+@param Vr1[] an array with the real part of Gaussian 1 at each point
+
+@param V2[] an array with the amplitude of Gaussian 2 at each point
+
+@param cph[] an array with the cosine of the phase of Gaussian 2 at each point
+
+@param sph[] an array with the sine of the phase of Gaussian 2 at each point
+
+@param data a pointer to the prepared data set
+
+\return a double with the chi-square
+
+*/
+static double chi2Components(double Vr1[], double V2[], double cph[], double sph[], dataset *data)
+{
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  int index, lane;
+
+  vdouble chi2=vset(0.0);
+
+  for (index=0;index<data->Npad;index+=VLEN)
+    {
+      vdouble Vamp2=vload(V2+index);
+      vdouble Vr=vload(Vr1+index)+Vamp2*vload(cph+index);
+      vdouble Vi=Vamp2*vload(sph+index);
+
+      vdouble variance=vload(data->Vis+index)-vsqrt(Vr*Vr+Vi*Vi);
+      chi2+=variance*variance*vload(data->invVar+index);
+    }
+
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  return result;
+}
+
+/*!
+\brief
+Calculates the component of the model that depends on one block of parameters
+
+\details
+Block 0 (flux and width of Gaussian 1) gives the real part of Gaussian
+1 in out1[]; block 1 (the displacement of Gaussian 2) gives the cosine
+and sine of its phase in out1[] and out2[]; block 2 (flux and width of
+Gaussian 2) gives its amplitude in out1[].
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param iblock an int with the block of parameters
+
+@param Aparam[] an array of doubles with the values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param out1[] an array with the first component on return
+
+@param out2[] an array with the second component on return (block 1 only)
+
+*/
+static void blockComponents(int iblock, double Aparam[], dataset *data, double out1[], double out2[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  int index;
+
+  if (iblock==1)
+    {
+      vdouble xdisp=vset(Aparam[2]);
+      vdouble ydisp=vset(Aparam[3]);
+      for (index=0;index<data->Npad;index+=VLEN)
+	{
+	  vdouble phase2=xdisp*vload(data->uPh+index)+ydisp*vload(data->vPh+index);
+	  vdouble cos2, sin2;
+	  vsincos(phase2,sin2,cos2);
+	  vstore(out1+index,cos2);
+	  vstore(out2+index,sin2);
+	}
+    }
+  else
+    {
+      vdouble flux=vset(Aparam[2*iblock]);
+      vdouble width=vset(-aux*Aparam[2*iblock+1]*Aparam[2*iblock+1]);
+      for (index=0;index<data->Npad;index+=VLEN)
+	vstore(out1+index,flux*vexp(width*vload(data->b02+index)));
+    }
+}
+
+/*!
+\brief
+Allocates the cache of the model components for a data set
+
+\details
+The cache holds, for every data point, the components of the
+2-Gaussian model that depend on each block of parameters (see
+blockComponents()) at the current position of a chain, plus two
+arrays for the components at a proposed position.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from initChain()
+
+@param cache a pointer to the cache
+
+@param data a pointer to the prepared data set
+
+\return zero if all was OK, ERROR_MEMORY if the allocation failed
+
+*/
+int initCache(modelCache *cache, dataset *data)
+{
+  void *ptr;
+  int Npad=(data->Npad>0) ? data->Npad : DATA_PAD;
+
+  if (posix_memalign(&ptr,DATA_ALIGN,6*(size_t)Npad*sizeof(double))!=0)
+    {
+      printf("Error allocating memory for the model cache\n");
+      cache->block=NULL;
+      return ERROR_MEMORY;
+    }
+  cache->block=(double *)ptr;
+  memset(cache->block,0,6*(size_t)Npad*sizeof(double));
+
+  cache->Vr1=cache->block;
+  cache->V2=cache->block+Npad;
+  cache->cph=cache->block+2*Npad;
+  cache->sph=cache->block+3*Npad;
+  cache->trial1=cache->block+4*Npad;
+  cache->trial2=cache->block+5*Npad;
+
+  return 0;
+}
+
+/*!
+\brief
+Frees the cache of the model components
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param cache a pointer to the cache
+
+*/
+void freeCache(modelCache *cache)
+{
+  free(cache->block);
+  cache->block=NULL;
+}
+
+/*!
+\brief
+Fills the cache of the model components at a position
+
+\details
+Calculates all the components of the model at the parameters Aparam[]
+and returns the chi-square there, which agrees with that of
+chi2Data() to rounding.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from initChain()
+
+@param cache a pointer to the cache
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the values of the model parameters
+
+@param data a pointer to the prepared data set
+
+\return a double with the chi-square at Aparam[]
+
+*/
+double fillCache(modelCache *cache, int Nparam, double Aparam[], dataset *data)
+{
+  blockComponents(0,Aparam,data,cache->Vr1,NULL);
+  blockComponents(1,Aparam,data,cache->cph,cache->sph);
+  blockComponents(2,Aparam,data,cache->V2,NULL);
+
+  return chi2Components(cache->Vr1,cache->V2,cache->cph,cache->sph,data);
+}
+
+/*!
+\brief
+Calculates the chi-square after a change of one block of parameters
+
+\details
+Given parameters Aparam[] that differ from those of the cached
+position only in block iblock, recalculates the components that depend
+on that block into the trial arrays of the cache and combines them
+with the cached components of the other blocks. The transcendental
+functions are evaluated only for the changed block.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from blockStep()
+
+@param cache a pointer to the cache, filled at the current position
+
+@param iblock an int with the block of parameters that changed
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the proposed values of the model parameters
+
+@param data a pointer to the prepared data set
+
+\return a double with the chi-square at Aparam[]
+
+*/
+double chi2Block(modelCache *cache, int iblock, int Nparam, double Aparam[], dataset *data)
+{
+  blockComponents(iblock,Aparam,data,cache->trial1,cache->trial2);
+
+  if (iblock==0)
+    return chi2Components(cache->trial1,cache->V2,cache->cph,cache->sph,data);
+  else if (iblock==1)
+    return chi2Components(cache->Vr1,cache->V2,cache->trial1,cache->trial2,data);
+  else
+    return chi2Components(cache->Vr1,cache->trial1,cache->cph,cache->sph,data);
+}
+
+/*!
+\brief
+Moves the cache to the proposed position after an accepted block update
+
+\details
+Exchanges the trial arrays calculated by chi2Block() with the cached
+components of block iblock.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from blockStep()
+
+@param cache a pointer to the cache
+
+@param iblock an int with the block of parameters that changed
+
+*/
+void acceptBlock(modelCache *cache, int iblock)
+{
+  double *aux;
+
+  if (iblock==1)
+    {
+      aux=cache->cph; cache->cph=cache->trial1; cache->trial1=aux;
+      aux=cache->sph; cache->sph=cache->trial2; cache->trial2=aux;
+    }
+  else if (iblock==0)
+    {
+      aux=cache->Vr1; cache->Vr1=cache->trial1; cache->trial1=aux;
+    }
+  else
+    {
+      aux=cache->V2; cache->V2=cache->trial1; cache->trial1=aux;
+    }
+}
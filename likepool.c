@@ -0,0 +1,322 @@
+/*! \file
+  \brief
+  File with a pool of threads that share the chi-square of large data sets
+
+  \details
+  For data sets with many points, the chi-square of one evaluation of
+  the likelihood is split into chunks of LIKECHUNK data points, which
+  are calculated by the SIMD kernel of the model (see chi2Data()) in
+  the helper threads of a pool and in the calling thread itself. The
+  partial sums of the chunks are added in the order of the chunks, so
+  the chi-square depends only on the data and the parameters, not on
+  the number of threads or on which thread took which chunk: runs are
+  reproducible.
+
+  A single pool is attached to a data set and shared by all the chains
+  that use it, each call to chi2Pool() queueing its chunks for the
+  helpers. The helpers, which wait on a condition variable when there
+  is no work, plus the threads of the chains should not exceed the
+  number of cores (see main()).
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<stdlib.h>
+#include<pthread.h>
+
+#include "mcmc.h"
+
+#define LIKECHUNK 4096             // data points per chunk (a multiple of DATA_PAD)
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+One evaluation of the chi-square, split into chunks
+
+*/
+typedef struct likeTask
+{
+  int Nparam;                    //!< number of model parameters
+  double *Aparam;                //!< the model parameters
+  dataset *data;                 //!< the data set
+  int Nchunks;                   //!< number of chunks
+  int next;                      //!< next chunk to calculate
+  int Ndone;                     //!< chunks calculated
+  double *partial;               //!< the chi-square of each chunk
+  struct likeTask *nextTask;     //!< next task in the queue of the pool
+} likeTask;
+
+/*!
+\brief
+A pool of helper threads for the chi-square
+
+*/
+struct likePool
+{
+  pthread_mutex_t mutex;         //!< protects the queue and the counters
+  pthread_cond_t work;           //!< signals new chunks to the helpers
+  pthread_cond_t done;           //!< signals finished chunks to the callers
+  likeTask *queue;               //!< tasks with chunks left to start
+  int stop;                      //!< set when the helpers must exit
+  int Nhelpers;                  //!< number of helper threads
+  int Nmin;                      //!< data points from which the pool is used
+  pthread_t *tid;                //!< the helper threads
+};
+
+/*!
+\brief
+Takes the next chunk of the first task in the queue
+
+\pre The mutex of the pool is locked
+
+*/
+static likeTask *takeChunk(likePool *pool, int *ichunk)
+{
+  likeTask *task=pool->queue;
+
+  if (task==NULL)
+    return NULL;
+
+  *ichunk=task->next++;
+  // all chunks of the task are started
+  if (task->next==task->Nchunks)
+    pool->queue=task->nextTask;
+
+  return task;
+}
+
+/*!
+\brief
+Calculates a chunk of a task and records it as done
+
+\pre The mutex of the pool is locked; it is unlocked while calculating
+
+*/
+static void runChunk(likePool *pool, likeTask *task, int ichunk)
+{
+  int first=(ichunk-1)*LIKECHUNK;
+  int last=(ichunk==task->Nchunks) ? task->data->Npad : first+LIKECHUNK;
+
+  pthread_mutex_unlock(&pool->mutex);
+  task->partial[ichunk-1]=chi2Data(task->Nparam,task->Aparam,task->data,first,last);
+  pthread_mutex_lock(&pool->mutex);
+
+  if (++task->Ndone==task->Nchunks)
+    pthread_cond_broadcast(&pool->done);
+}
+
+// the work of a helper thread: calculate chunks until the pool stops
+static void *runHelper(void *arg)
+{
+  likePool *pool=arg;
+  likeTask *task;
+  int ichunk;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1)
+    {
+      while (!pool->stop && pool->queue==NULL)
+	pthread_cond_wait(&pool->work,&pool->mutex);
+      if (pool->stop)
+	break;
+      task=takeChunk(pool,&ichunk);
+      // chunks are numbered from 1
+      runChunk(pool,task,ichunk+1);
+    }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/*!
+\brief
+Starts a pool of threads for the chi-square of a data set
+
+\details
+Starts Nhelpers helper threads and attaches them to the data set, for
+the data sets with at least Nmin points. With Nhelpers<=0 the pool has
+no helpers and the calling thread calculates all the chunks itself,
+so that the chi-square is the same whatever the number of cores.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from main() after the data are read (and binned)
+
+@param data a pointer to the data set
+
+@param Nhelpers an int with the number of helper threads
+
+@param Nmin an int with the number of data points from which the pool is used
+
+\return zero if all was OK, ERROR_FILE if the threads could not be started
+
+*/
+int startPool(dataset *data, int Nhelpers, int Nmin)
+{
+  likePool *pool;
+  int ithread;
+
+  data->pool=NULL;
+  if (Nhelpers<0)
+    Nhelpers=0;
+
+  pool=malloc(sizeof(likePool));
+  if (pool==NULL || (pool->tid=malloc((Nhelpers+1)*sizeof(pthread_t)))==NULL)
+    {
+      printf("Error allocating memory for the likelihood threads\n");
+      free(pool);
+      return ERROR_FILE;
+    }
+
+  pthread_mutex_init(&pool->mutex,NULL);
+  pthread_cond_init(&pool->work,NULL);
+  pthread_cond_init(&pool->done,NULL);
+  pool->queue=NULL;
+  pool->stop=0;
+  pool->Nmin=Nmin;
+
+  for (ithread=1;ithread<=Nhelpers;ithread++)
+    if (pthread_create(&pool->tid[ithread-1],NULL,runHelper,pool)!=0)
+      break;
+  pool->Nhelpers=ithread-1;
+  data->pool=pool;
+
+  if (ithread<=Nhelpers)
+    {
+      printf("Error starting the likelihood threads\n");
+      stopPool(data);
+      return ERROR_FILE;
+    }
+
+  return 0;
+}
+
+/*!
+\brief
+Stops the pool of threads of a data set
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre No chain is using the data set
+
+@param data a pointer to the data set
+
+*/
+void stopPool(dataset *data)
+{
+  likePool *pool=data->pool;
+  int ithread;
+
+  if (pool==NULL)
+    return;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop=1;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (ithread=1;ithread<=pool->Nhelpers;ithread++)
+    pthread_join(pool->tid[ithread-1],NULL);
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+  free(pool->tid);
+  free(pool);
+  data->pool=NULL;
+}
+
+/*!
+\brief
+Calculates the chi-square of all the data points, in parallel for large data sets
+
+\details
+If the data set has a pool and at least Nmin points, splits the
+points into chunks of LIKECHUNK, queues them for the helpers, takes
+chunks itself until none are left to start, waits for the helpers to
+finish theirs and adds the partial sums in the order of the chunks;
+without helpers, it calculates the chunks in turn and adds them in the
+same order. Otherwise, it is the same as chi2Data() over all the
+points.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from like(); it can be called by several chains at once
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+\return a double with the chi-square
+
+*/
+double chi2Pool(int Nparam, double Aparam[], dataset *data)
+{
+  likePool *pool=data->pool;
+  likeTask task, **last;
+  int Nchunks=(data->Npad+LIKECHUNK-1)/LIKECHUNK;
+  int ichunk;
+  double result=0.0;
+
+  if (pool==NULL || data->Npts<pool->Nmin || Nchunks<2)
+    return chi2Data(Nparam,Aparam,data,0,data->Npad);
+
+  // the same sum as with helpers, with no locking
+  if (pool->Nhelpers==0)
+    {
+      for (ichunk=1;ichunk<=Nchunks;ichunk++)
+	result+=chi2Data(Nparam,Aparam,data,(ichunk-1)*LIKECHUNK,(ichunk==Nchunks) ? data->Npad : ichunk*LIKECHUNK);
+      return result;
+    }
+
+  double partial[Nchunks];
+  task.Nparam=Nparam;
+  task.Aparam=Aparam;
+  task.data=data;
+  task.Nchunks=Nchunks;
+  task.next=0;
+  task.Ndone=0;
+  task.partial=partial;
+  task.nextTask=NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  // queue the task behind those of the other chains
+  for (last=&pool->queue;*last!=NULL;last=&(*last)->nextTask)
+    ;
+  *last=&task;
+  pthread_cond_broadcast(&pool->work);
+
+  // help with the own chunks, then wait for the others
+  while (task.next<task.Nchunks)
+    {
+      // the task is still in the queue, but maybe not at its head
+      for (last=&pool->queue;*last!=&task;last=&(*last)->nextTask)
+	;
+      ichunk=task.next++;
+      if (task.next==task.Nchunks)
+	*last=task.nextTask;
+      runChunk(pool,&task,ichunk+1);
+    }
+  while (task.Ndone<task.Nchunks)
+    pthread_cond_wait(&pool->done,&pool->mutex);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (ichunk=1;ichunk<=Nchunks;ichunk++)
+    result+=partial[ichunk-1];
+
+  return result;
+}
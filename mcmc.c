@@ -4,13 +4,17 @@
   \details
   A MCMC algorithm to fit interferometric data with simple models.
 
-  The data are in a filename stored in variable "filename[]" in a simple ASCII format, defined and described in readdata.c
+  The settings of a run are read from a configuration file and the command line (see config.c); "./mcmc -h" lists them with their defaults
 
-  If the parameter VERBOSE is set to 1, a log file will be created called "mcmc.log" with general information on the performance of the algorithm
+  The data are in a file with name stored in setting "filename" in a simple ASCII format, defined and described in readdata.c
 
-  The MCMC chains are recorded in a file with name stored in variable "chainfname[]"
+  If the setting "verbose" is set to 1, a log file will be created called "mcmc.log" (setting "logfname") with general information on the performance of the algorithm
 
-  The comparison of the model with the highest posterior to the data is recorded in a file with name stored in variable "modelfname[]"
+  The MCMC chains are recorded in a file with name stored in setting "chainfname", leaving out the first "Nburn" links and keeping every "thin"-th link after them
+
+  If the setting "summaryfname" is set, the links after burn-in are also summarized as they are run (mean, covariance, quantiles and histograms, see summary.c) in a file with that name
+
+  The comparison of the model with the highest posterior to the data is recorded in a file with name stored in setting "modelfname"
 
   \author D.Psaltis
   
@@ -23,18 +27,46 @@
 */
 #include <stdio.h>
 #include <math.h>
+#include <unistd.h>
 
+#include "mcmc.h"
+#include "instrument.h"
+#ifdef USE_GPU
+#include "likegpu.h"
+#endif
 
-#define NPTSMAX 1024             //!< max number of data points
-#define NPARAMMAX 16             //!< max number of model parameters
-#define FNAMELENGTH 24           //!< max length of filename for data
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 
-#define VERBOSE 1                //!< if VERBOSE==1, print a lot of remarks
 
 #define ERROR_FILE 1             //!< error code for file i/o errors
 
-extern double model(double uCo, double vCo, int Nparam, double Aparam[]);
-extern double walkers(char fname[], int Nchain, int Nparam, double Aparam[], double dev[], int Npts, double uCo[], double vCo[], double Vis[], double Sigma[]);
+/*!
+\brief
+Ends a run that failed
+
+\details
+In builds with USE_MPI, aborts every rank of the job, since the others
+may be waiting for this one in a collective operation; otherwise it
+only returns the error code.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param err an int with the error code
+
+\return err, for main() to return
+
+*/
+static int failRun(int err)
+{
+#ifdef USE_MPI
+  MPI_Abort(MPI_COMM_WORLD,err);
+#endif
+  return err;
+}
 
 /*!
 \brief 
@@ -43,87 +75,391 @@ Main function
 \details 
 Main function
 
+The settings of the run start from the defaults of defaultConfig()
+and are changed by the command line, e.g.
+"./mcmc -c run.cfg Nchain=100000 sampler=multi" (see parseArgs()).
+
+In builds with USE_MPI, main() is the body of every rank of the MPI
+job; all ranks read the data and sample, and only rank 0 writes the
+log and the best-fit model. An error in any rank aborts the whole job
+(see failRun()).
+
+In builds with USE_GPU, the ensemble sampler can evaluate its walkers
+on a GPU (setting "gpu", see likegpu.cu).
+
+In builds with INSTRUMENT, the log also has the time spent in the
+likelihood, in the proposals and in the I/O of the samplers.
+
+The generator of the random numbers (setting "rng") is chosen before
+any chain is seeded or any thread started (see setGeneratorMT()).
+
+With optStarts>0, a multi-start Nelder-Mead search for the best fit
+(see optimize()) replaces the initial parameters before sampling, so
+that the chains and the walkers start near the mode.
+
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.11
 
-\date Nov 26, 2018
+\date Oct 14, 2026
+
+@param argc an int with the number of command line arguments
+
+@param argv[] an array of strings with the command line arguments
 
 */
-int main(void)
+int main(int argc, char *argv[])
 {
-  double uCo[NPTSMAX];            // array with u-coordinates of data points
-  double vCo[NPTSMAX];            // array with v-coordinates of data points
-  double Vis[NPTSMAX];            // array with visibility amplitudes
-  double Sigma[NPTSMAX];          // array with uncertainties
-  double Aparam[NPARAMMAX];       // array with model parameters
-  double dev[NPARAMMAX];          // array with dispersion of Gaussian steps
-
-  int Npts;                      // number of data points
+  dataset data;                  // data, prepared for the likelihood
 
-  char filename[FNAMELENGTH]="synth_data.dat";  // filename with data
-  char chainfname[FNAMELENGTH]="chains.dat";    // filename with chains
-  char modelfname[FNAMELENGTH]="model.dat";     // filename with model
+  int rank=0, Nranks=1;          // MPI rank of this process, and number of ranks
+#ifdef USE_MPI
+  MPI_Init(NULL,NULL);
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&Nranks);
+#endif
 
+  // the settings of the run; under MPI, the chains go to one binary file per rank
+  runConfig cfg;
+  defaultConfig(&cfg);
+#ifdef USE_MPI
+  cfg.sampler=SAMPLER_MPI;
+  cfg.format=CHAIN_NPY;
+#endif
   int result;                    // dummy for results of operations
 
+  result=parseArgs(argc,argv,&cfg);
+  if (result!=0)
+    {
+#ifdef USE_MPI
+      MPI_Finalize();
+#endif
+      return (result<0) ? 0 : 1;
+    }
+#ifndef USE_MPI
+  if (cfg.sampler==SAMPLER_MPI)
+    {
+      printf("The mpi sampler needs a build with USE_MPI (make mpi)\n");
+      return 1;
+    }
+#endif
+#ifndef USE_GPU
+  if (cfg.gpu)
+    {
+      printf("The gpu setting needs a build with USE_GPU (make gpu)\n");
+      return failRun(1);
+    }
+#endif
+
+  setGeneratorMT(cfg.rng);
+
   int index;                     // generic index variable
 
-  FILE *logfile;                 // file to store a log
+  FILE *logfile=NULL;            // file to store a log, if verbose
   FILE *modelfile;               // file to store the best-fit model
-  
-  result=readData(filename,&Npts,uCo,vCo,Vis,Sigma);
+
+  int Nchain=cfg.Nchain;         // number of chain links
+  int sampler=cfg.sampler;       // which sampler to run (see mcmc.h)
+  int format=cfg.format | ((cfg.async) ? CHAIN_ASYNC : 0);  // format of the
+                                 // chains file (see mcmc.h)
+  int proposal=cfg.proposal;     // steps of SAMPLER_MH/MULTI chains (see mcmc.h)
+  int Nadapt=cfg.Nadapt;         // burn-in links, over which PROPOSAL_ADAPTIVE adapts
+                                 // and which are left out of the diagnostics
+
+  // links recorded in the chains file, and in the summary if there is one
+  chainSummary summary;
+  chainRecord record;
+  record.Nburn=cfg.Nburn;
+  record.thin=cfg.thin;
+  record.summary=NULL;
+
+  // stopping rule of SAMPLER_MH/MULTI
+  convergence conv;
+  conv.essTarget=cfg.essTarget;
+  conv.rhatTarget=cfg.rhatTarget;
+  conv.Ncheck=cfg.Ncheck;
+  conv.Nlinks=Nchain;
+
+  // fit every data set of the manifest instead, each with SAMPLER_MH chains
+  if (cfg.manifest[0]!='\0')
+    {
+      // the other ranks stay idle, rather than fitting the same data sets
+      int Nfailed=0;
+      int Nthreads=(cfg.batchThreads>0) ? cfg.batchThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+      int Njobs=(rank>0) ? 0 : batch(cfg.manifest,Nthreads,format,Nchain,proposal,Nadapt,cfg.Ncheckpoint,cfg.restart,cfg.frac,cfg.seed,&record,&conv,&Nfailed);
+      if (Njobs<0)
+	{
+	  printf("Error in reading the manifest %s\n",cfg.manifest);
+	  return failRun(1);
+	}
+      if (cfg.verbose==1 && rank==0)
+	{
+	  if ((logfile=fopen(cfg.logfname,"w"))==NULL)
+	    {
+	      printf("Error opening file %s for writing\n",cfg.logfname);
+	      return failRun(ERROR_FILE);
+	    }
+	  fprintf(logfile,"Fitted %d of %d data sets from the manifest %s\n",Njobs-Nfailed,Njobs,cfg.manifest);
+	  INSTR_REPORT(logfile);
+	  fclose(logfile);
+	}
+#ifdef USE_MPI
+      MPI_Finalize();
+#endif
+      return (Nfailed>0);
+    }
+
+  result=readData(cfg.filename,&data,cfg.dataCache);
 
   if (result!=0)
     {
       printf("Error in reading data\n");
-      return 1;
+      return failRun(1);
+    }
+
+  if (cfg.closurefname[0]!='\0' && readClosures(cfg.closurefname,&data)!=0)
+    {
+      printf("Error in reading the closure terms\n");
+      return failRun(1);
+    }
+
+  int Nraw=data.Npts;
+  if (cfg.binSize>=0. && binData(&data,cfg.binSize)!=0)
+    {
+      printf("Error in binning data\n");
+      return failRun(1);
     }
 
-  if (VERBOSE==1)
+  if (cfg.verbose==1 && rank==0)
     {
-      if ((logfile=fopen("mcmc.log","w"))==NULL)
+      if ((logfile=fopen(cfg.logfname,"w"))==NULL)
 	{
-	  printf("Error opening file mcmc.log for writing\n");
-	  return ERROR_FILE;
+	  printf("Error opening file %s for writing\n",cfg.logfname);
+	  return failRun(ERROR_FILE);
 	}
       
-      fprintf(logfile,"Read %d data points from file %s\n",Npts,filename);
+      fprintf(logfile,"Read %d data points from file %s\n",Nraw,cfg.filename);
+      if (cfg.binSize>=0.)
+	fprintf(logfile,"Merged into %d bins, with a chi-square of %e within the bins\n",data.Npts,data.chi2Offset);
+      if (data.Nterms>0)
+	fprintf(logfile,"Read %d complex visibilities, %d closure phases and %d log closure amplitudes from file %s\n",data.Nvis,data.Ncphase,data.Nlcamp,cfg.closurefname);
+      fprintf(logfile,"Settings of the run:\n");
+      writeConfig(logfile,&cfg);
     }
   
-  int Nchain=50000;              // number of chain links
-  int Nparam=6;                  // number of model parameters
+  // the model fit to the data (see models.c)
+  if (setModel(&data,cfg.model)!=0)
+    return failRun(1);
+
+  int Nparam=data.model->Nparam; // number of model parameters
+  if (cfg.Ninit!=0 && cfg.Ninit!=Nparam)
+    {
+      printf("%d initial parameters given, the model %s has %d\n",cfg.Ninit,data.model->name,Nparam);
+      return failRun(1);
+    }
+
+  double Aparam[Nparam];         // array with model parameters
+  double dev[Nparam];            // array with dispersion of Gaussian steps
+
+  int Nwalkers=cfg.Nwalkers;     // number of walkers for SAMPLER_ENSEMBLE
+  if (sampler==SAMPLER_ENSEMBLE && Nwalkers<2*Nparam)
+    {
+      printf("The ensemble sampler needs at least %d walkers for the %d parameters of the model %s\n",2*Nparam,Nparam,data.model->name);
+      return failRun(1);
+    }
+
+  int Nchains=cfg.Nchains;       // number of chains (threads) for SAMPLER_MULTI
+  int tempering=cfg.tempering;   // if 1, the chains form a tempering ladder
+  double swapRate=0.0;           // acceptance ratio of the swaps
+
+  int likeThreads=cfg.likeThreads;  // helper threads for the chi-square of large
+                                    // data sets (-1 for the cores left by the chains)
+
+  // convergence diagnostics of SAMPLER_MH/MULTI
+  double ess[Nparam], iat[Nparam], rhat[Nparam];
+  conv.ess=ess; conv.iat=iat; conv.rhat=rhat;
+
+  // names of the model parameters, recorded with binary chains
+  char **names=data.model->names;
+
+  // only models with the blocks of modelCache can take block steps,
+  // and only on visibility amplitudes
+  if (proposal==PROPOSAL_BLOCK && (data.model->Nblocks!=MODELNBLOCKS || data.Nterms>0))
+    {
+      printf("The model %s cannot take block steps with these data, taking full steps\n",data.model->name);
+      proposal=PROPOSAL_FULL;
+    }
+
+  // only models with a gradient kernel can follow the gradient, and
+  // only on visibility amplitudes
+  if (sampler==SAMPLER_NUTS && (data.model->grad==NULL || data.Nterms>0))
+    {
+      printf("The model %s has no gradient for these data, running a Metropolis chain\n",data.model->name);
+      sampler=SAMPLER_MH;
+    }
+
+  // the early exit of the Metropolis steps sums the chi-square of the
+  // data points alone, in the thread of the chain
+  if (cfg.earlyExit && data.Nterms>0)
+    printf("The early exit needs data without complex or closure terms, summing the chi-square in full\n");
+  else if (cfg.earlyExit && proposal==PROPOSAL_BLOCK)
+    printf("The early exit does not apply to block steps, summing the chi-square in full\n");
+  else
+    data.earlyExit=cfg.earlyExit;
+
+  // the single-precision kernel takes the place of the double one for
+  // the chi-square of the amplitudes alone, outside the block cache and
+  // the gradient
+  if (cfg.precision!=PRECISION_DOUBLE && data.Nterms>0)
+    printf("The single-precision kernel needs data without complex or closure terms, using the double one\n");
+  else if (cfg.precision!=PRECISION_DOUBLE && proposal==PROPOSAL_BLOCK)
+    printf("Block steps cache the model in double precision, using the double kernel\n");
+  else if (cfg.precision!=PRECISION_DOUBLE && sampler==SAMPLER_NUTS)
+    printf("The gradient kernel is in double precision, using the double kernel\n");
+  else if (singleData(&data,cfg.precision)!=0)
+    return failRun(1);
+
+#ifdef USE_GPU
+  // the GPU evaluates the batches of walkers of the ensemble sampler,
+  // from the amplitudes alone and in double precision
+  if (cfg.gpu && sampler!=SAMPLER_ENSEMBLE)
+    printf("Only the ensemble sampler evaluates batches of walkers, evaluating the likelihood on the CPU\n");
+  else if (cfg.gpu && data.Nterms>0)
+    printf("The GPU kernels need data without complex or closure terms, evaluating the likelihood on the CPU\n");
+  else if (cfg.gpu && startGPU(&data)!=0)
+    printf("Evaluating the likelihood on the CPU\n");
+#endif
+
+  // unless named, the chains go to chains.dat, or to a NumPy file if binary
+  char *chainfname=cfg.chainfname;
+  if (chainfname[0]=='\0')
+    chainfname=((format & ~CHAIN_ASYNC)==CHAIN_NPY) ? "chains.npy" : "chains.dat";
 
   // initialize the model parameters for the chains
-  Aparam[0]=4.5;                 // flux of first Gaussian component
-  Aparam[1]=4.8;                  // width of first Gaussian component
-  Aparam[2]=-11.5;                // x-displacement of 2nd Gaussian component
-  Aparam[3]=13.6;                 // y-displacement of 2nd Gaussian component
-  Aparam[4]=1.4;                 // flux of 2nd Gaussian component
-  Aparam[5]=3.1;                  // width of 2nd Gaussian component
-
-  /* BEST-FIT parameters for synth_data.dat
-  Aparam[0]=4.0;                 // flux of first Gaussian component
-  Aparam[1]=5.;                  // width of first Gaussian component
-  Aparam[2]=-12.;                // x-displacement of 2nd Gaussian component
-  Aparam[3]=13.;                 // y-displacement of 2nd Gaussian component
-  Aparam[4]=1.2;                 // flux of 2nd Gaussian component
-  Aparam[5]=3.;                  // width of 2nd Gaussian component
-  */
+  for (index=1;index<=Nparam;index++)
+    {
+      Aparam[index-1]=(cfg.Ninit>0) ? cfg.init[index-1] : data.model->init[index-1];
+    }
+
+  // search for the best fit, from which the chains start; under MPI,
+  // rank 0 searches and the other ranks take its result
+  if (cfg.optStarts>0)
+    {
+      optimizer opt;
+      opt.Nstarts=cfg.optStarts;
+      opt.Nthreads=(cfg.optThreads>0) ? cfg.optThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+      opt.scale=cfg.optScale;
+      opt.Nmax=cfg.optNmax;
+      if (rank==0 && optimize(Nparam,Aparam,cfg.seed,&opt,&data)!=0)
+	return failRun(1);
+#ifdef USE_MPI
+      MPI_Bcast(Aparam,Nparam,MPI_DOUBLE,0,MPI_COMM_WORLD);
+#endif
+      if (logfile!=NULL)
+	{
+	  fprintf(logfile,"Best fit from %d Nelder-Mead starts in %d threads (%d converged): log posterior %e, from %e at the initial parameters, found by start %d after %ld evaluations of the posterior\n",opt.Nstarts,opt.Nthreads,opt.Nconverged,opt.postMax,opt.postInit,opt.best,opt.Neval);
+	  for (index=1;index<=Nparam;index++)
+	    fprintf(logfile,"%e\t%s",Aparam[index-1],(index==Nparam) ? "\n" : "");
+	}
+    }
   
-  // set gaussian width of the MCMC steps to be a ...
-  double frac=0.01;               // ... fraction of each parameter value
+  // set gaussian width of the MCMC steps to be a fraction of each parameter value
   for (index=1;index<=Nparam;index++)
     {
-      dev[index-1]=frac*Aparam[index-1];
+      dev[index-1]=cfg.frac*Aparam[index-1];
     }
   
-  double acc=walkers(chainfname,Nchain,Nparam,Aparam,dev,Npts,uCo,vCo,Vis,Sigma);
+  // share the chi-square of large data sets among threads, without
+  // running more threads than cores (but for the early exit, for the
+  // validation, which compares the kernels on whole evaluations, and
+  // when the GPU evaluates the walkers)
+  if (likeThreads<0)
+    {
+      long Ncores=sysconf(_SC_NPROCESSORS_ONLN);
+      int Nlocal=1;              // chains on this node
+#ifdef USE_MPI
+      MPI_Comm node;
+      MPI_Comm_split_type(MPI_COMM_WORLD,MPI_COMM_TYPE_SHARED,rank,MPI_INFO_NULL,&node);
+      MPI_Comm_size(node,&Nlocal);
+      MPI_Comm_free(&node);
+#endif
+      if (sampler==SAMPLER_MULTI)
+	Nlocal=Nchains;
+      // the ranks of a node share its cores
+      likeThreads=((int)Ncores-Nlocal)/((sampler==SAMPLER_MPI) ? Nlocal : 1);
+    }
+  if (!data.earlyExit && data.precision!=PRECISION_VALIDATE && data.gpu==NULL && data.Npts>=cfg.likeNmin && startPool(&data,likeThreads,cfg.likeNmin)!=0)
+    return failRun(1);
+
+  // the summary follows the posterior, that is, rank 0 under MPI
+  if (cfg.summaryfname[0]!='\0' && rank==0)
+    {
+      if (initSummary(&summary,Nparam,cfg.Nbins)!=0)
+	return failRun(1);
+      record.summary=&summary;
+    }
+
+  double acc;                    // acceptance ratio of the sampler
+  double stepSize=0.0;           // leapfrog step size of SAMPLER_NUTS
+  long Ngrad=0;                  // evaluations of the gradient of SAMPLER_NUTS
+  if (sampler==SAMPLER_ENSEMBLE)
+    {
+      // same total number of samples, shared among the walkers
+      Nchain=Nchain/Nwalkers;
+      acc=ensemble(chainfname,format,names,Nchain,Nwalkers,Nparam,Aparam,dev,cfg.seed,&record,&data);
+    }
+#ifdef USE_MPI
+  else if (sampler==SAMPLER_MPI)
+    acc=mpichain(chainfname,format,names,Nchain,tempering,cfg.Tmax,cfg.Nswap,Nparam,Aparam,dev,proposal,Nadapt,cfg.seed,&record,&conv,&data,&swapRate);
+#endif
+  else if (sampler==SAMPLER_NUTS)
+    acc=hmc(chainfname,format,names,Nchain,Nparam,Aparam,dev,cfg.Nleapfrog,Nadapt,cfg.seed,&record,&conv,&data,&stepSize,&Ngrad);
+  else if (sampler==SAMPLER_MULTI)
+    acc=multichain(chainfname,format,names,Nchain,Nchains,tempering,cfg.Tmax,cfg.Nswap,Nparam,Aparam,dev,proposal,Nadapt,cfg.seed,&record,&conv,&data,&swapRate);
+  else
+    acc=walkers(chainfname,format,names,Nchain,Nparam,Aparam,dev,proposal,Nadapt,cfg.Ncheckpoint,cfg.restart,cfg.seed,&record,&conv,&data);
+
+  // the summary of the links after burn-in
+  int summarized=0;
+  if (record.summary!=NULL)
+    {
+      summarized=(writeSummary(cfg.summaryfname,&summary,names)==0);
+      freeSummary(&summary);
+    }
 
   // if we want a verbose output of the results
-  if (VERBOSE==1)
+  if (logfile!=NULL)
     {
-      fprintf(logfile,"%d chains completed with an acceptance ratio of %e\n",Nchain,acc);
+      fprintf(logfile,"%ld chains completed with an acceptance ratio of %e\n",(sampler==SAMPLER_ENSEMBLE) ? (long)Nchain : conv.Nlinks,acc);
+      if (sampler==SAMPLER_MULTI && tempering)
+	fprintf(logfile,"%d tempered chains with a swap acceptance ratio of %e\n",Nchains,swapRate);
+      if (cfg.thin==0)
+	fprintf(logfile,"No links recorded in %s\n",chainfname);
+      else if (cfg.Nburn>0 || cfg.thin>1)
+	fprintf(logfile,"The first %d %s left out of %s, then every %d-th recorded\n",cfg.Nburn,(sampler==SAMPLER_ENSEMBLE) ? "steps" : "links",chainfname,cfg.thin);
+      if (summarized)
+	fprintf(logfile,"Summary of %ld links after burn-in in %s\n",summary.Nlinks,cfg.summaryfname);
+      if (sampler==SAMPLER_NUTS)
+	fprintf(logfile,"%s links with a step size of %e, %ld gradient evaluations (%e per link)\n",(cfg.Nleapfrog>0) ? "HMC" : "NUTS",stepSize,Ngrad,Ngrad/(double)conv.Nlinks);
+      if (sampler==SAMPLER_MPI)
+	fprintf(logfile,"%d %s chains on MPI ranks, with a swap acceptance ratio of %e\n",Nranks,(tempering) ? "tempered" : "independent",swapRate);
+
+      if (sampler!=SAMPLER_ENSEMBLE)
+	{
+	  fprintf(logfile,"Effective sample sizes, autocorrelation times and split R-hats after burn-in:\n");
+	  for(index=1;index<=Nparam;index++)
+	    fprintf(logfile,"%e\t%s",ess[index-1],(index==Nparam) ? "\n" : "");
+	  for(index=1;index<=Nparam;index++)
+	    fprintf(logfile,"%e\t%s",iat[index-1],(index==Nparam) ? "\n" : "");
+	  for(index=1;index<=Nparam;index++)
+	    fprintf(logfile,"%e\t%s",rhat[index-1],(index==Nparam) ? "\n" : "");
+	}
+      reportPrecision(logfile,&data);
+#ifdef USE_GPU
+      if (data.gpu!=NULL)
+	fprintf(logfile,"Likelihood of the walkers evaluated on the GPU %s\n",gpuDevice(data.gpu));
+#endif
+      INSTR_REPORT(logfile);
 
       fprintf(logfile,"Most likely values of the parameters:\n");
        
@@ -132,19 +468,30 @@ int main(void)
     }
 
   // To record the best fit model together with the data
-  if ((modelfile=fopen(modelfname,"w"))==NULL)
-    {
-      printf("Error opening file %s for writing\n",modelfname);
-      return ERROR_FILE;
-    }
-  fprintf(modelfile,"uCo,vCo,VisAmp,Sigma,Model\n");
-  for (index=1;index<=Npts;index++)
+  if (rank==0)
     {
-      fprintf(modelfile, "%e, %e, %e, %e, %e\n",uCo[index-1],vCo[index-1],Vis[index-1],Sigma[index-1],model(uCo[index-1],vCo[index-1],Nparam,Aparam));
+      if ((modelfile=fopen(cfg.modelfname,"w"))==NULL)
+	{
+	  printf("Error opening file %s for writing\n",cfg.modelfname);
+	  return failRun(ERROR_FILE);
+	}
+      fprintf(modelfile,"uCo,vCo,VisAmp,Sigma,Model\n");
+      for (index=1;index<=data.Npts;index++)
+	{
+	  fprintf(modelfile, "%e, %e, %e, %e, %e\n",data.uCo[index-1],data.vCo[index-1],data.Vis[index-1],data.Sigma[index-1],model(data.uCo[index-1],data.vCo[index-1],Nparam,Aparam,&data));
+	}
+      fclose(modelfile);
     }
-  fclose(modelfile);
 
-  if (VERBOSE==1)
+#ifdef USE_GPU
+  stopGPU(&data);
+#endif
+  freeData(&data);
+
+  if (logfile!=NULL)
     fclose(logfile);
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
   return 0;           // all is well
 }
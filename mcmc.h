@@ -0,0 +1,634 @@
+/*! \file
+  \brief
+  Declarations shared between the files of the MCMC code
+
+  \details
+  This file holds the data structures and the prototypes of the
+  subroutines that are called across files.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#ifndef MCMC_H
+#define MCMC_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define muarcsecToRad 4.8481368110954e-12   //!< microarcsec to radians
+
+#define SEEDNO 4357U             //!< initial seed for random number generator
+
+#define SAMPLER_MH 0             //!< single random-walk Metropolis chain, walkers()
+#define SAMPLER_ENSEMBLE 1       //!< affine-invariant ensemble of walkers, ensemble()
+#define SAMPLER_MULTI 2          //!< several chains in threads, multichain()
+#define SAMPLER_MPI 3            //!< one chain per MPI rank, mpichain() (with USE_MPI)
+#define SAMPLER_NUTS 4           //!< Hamiltonian Monte Carlo with the gradient, hmc()
+
+#define PROPOSAL_FULL 0          //!< Metropolis steps in all parameters at once, mhStep()
+#define PROPOSAL_BLOCK 1         //!< steps in one block of parameters at a time, blockStep()
+#define PROPOSAL_ADAPTIVE 2      //!< steps with the covariance learned during burn-in, mhStep()
+#define MODELNBLOCKS 3           //!< number of blocks of parameters of the model
+
+#define PRECISION_DOUBLE 0       //!< the chi-square of the amplitudes in double precision
+#define PRECISION_SINGLE 1       //!< ... with the single-precision kernel, summed in double
+#define PRECISION_VALIDATE 2     //!< ... in double precision, compared to the single-precision kernel
+
+#define CHAIN_TEXT 0             //!< chains recorded as ASCII text
+#define CHAIN_NPY 1              //!< chains recorded as a binary NumPy .npy file
+#define CHAIN_ASYNC 16           //!< added to a format: write from a separate I/O thread
+#define CHAINNBLOCKS 8           //!< number of slots in the ring of the I/O thread
+
+#define MTLENGTH 624             //!< length of the Mersenne Twister state vector
+
+#define RNG_MT 0                 //!< Mersenne Twister streams (see twister.c)
+#define RNG_PHILOX 1             //!< Philox4x32-10 counter-based streams (see philox.c)
+
+typedef unsigned int uint32;
+
+/*!
+\brief
+The state of a Mersenne Twister random number generator
+
+\details
+Each chain owns one of these, so that chains can run concurrently.
+The structure is initialized with seedMT(). With RNG_PHILOX (see
+setGeneratorMT()), the numbers come instead from the counter of a
+Philox stream, and the state vector is not used.
+
+*/
+typedef struct
+{
+  uint32 state[MTLENGTH+1];      //!< state vector + 1 extra to not violate ANSI C
+  uint32 *next;                  //!< next random value is computed from here
+  int left;                      //!< can *next++ this many times before reloading
+  int hasGauss;                  //!< if 1, gaussSpare holds an unused normal deviate
+  double gaussSpare;             //!< second deviate of the last polar Box-Muller pair
+
+  int philox;                    //!< if 1, the numbers come from a Philox stream (see philox.c)
+  uint32 key[2];                 //!< key of the Philox stream
+  unsigned long long step;       //!< step of the counter (see nextStepMT())
+  uint32 block;                  //!< next block of four numbers of the step
+  uint32 out[4];                 //!< the last block of four numbers
+  int nout;                      //!< numbers of out[] left to draw
+} mtState;
+
+typedef struct likePool likePool;   //!< a pool of threads for the chi-square (see likepool.c)
+typedef struct precisionCheck precisionCheck;   //!< differences of the two kernels (see singleData())
+
+#define DATA_ALIGN 64            //!< alignment (in bytes) of the data arrays
+#define DATA_PAD 16              //!< data arrays are padded to a multiple of this
+
+/*!
+\brief
+A data set prepared for the evaluation of the likelihood
+
+\details
+The data points are stored as a structure of arrays, each aligned to
+DATA_ALIGN bytes and padded with zero-weight points to a multiple of
+DATA_PAD entries, so that the likelihood kernel can process them in
+full SIMD lanes without a remainder loop. All the arrays live in a
+single block of memory, sized for Nmax points by allocData().
+
+In addition to the data themselves, the quantities that depend only
+on the data (the baseline length squared, the phase factors and the
+inverse variances) are calculated once by precomputeData(). The
+points of redundant baselines can be merged into weighted bins by
+binData(), which keeps the chi-square of the points within the bins in
+chi2Offset.
+
+The data points can also enter the likelihood through complex
+visibilities, closure phases over triangles of points and log closure
+amplitudes over quadrangles of points, listed in index tables read by
+readClosures(). A point fit as a complex visibility has zero inverse
+variance, so that its amplitude is not counted twice. In a triangle, a
+negative index -k stands for the conjugate of point k, i.e., the
+baseline in the opposite direction.
+
+For the single-precision kernels, singleData() keeps a copy of the
+precomputed arrays and of the amplitudes in floats, in a block of its
+own laid out like the first one.
+
+*/
+typedef struct
+{
+  int Npts;                      //!< number of data points
+  int Npad;                      //!< number of points including the padding
+  int Nmax;                      //!< number of points the storage has room for
+  double *block;                 //!< the storage of all the arrays
+
+  double *uCo;                   //!< u-coordinates of the data points
+  double *vCo;                   //!< v-coordinates of the data points
+  double *Vis;                   //!< visibility amplitudes
+  double *Sigma;                 //!< uncertainties
+
+  double *b02;                   //!< baseline length squared, in 1/microarcsec^2
+  double *uPh;                   //!< -2 pi u, in 1/microarcsec
+  double *vPh;                   //!< -2 pi v, in 1/microarcsec
+  double *invVar;                //!< 1/Sigma^2 (zero for the padding)
+
+  int precision;                 //!< PRECISION_DOUBLE, PRECISION_SINGLE or PRECISION_VALIDATE
+  float *blockf;                 //!< the storage of the arrays in floats, or NULL
+  float *b02f;                   //!< b02 in floats
+  float *uPhf;                   //!< uPh in floats
+  float *vPhf;                   //!< vPh in floats
+  float *Visf;                   //!< Vis in floats
+  float *invVarf;                //!< invVar in floats
+  struct precisionCheck *check;  //!< differences of the kernels with PRECISION_VALIDATE, or NULL
+
+  double chi2Offset;             //!< chi-square of the points within their bins (see binData())
+  int earlyExit;                 //!< if 1, Metropolis steps stop the chi-square of sure rejections (see likeBudget())
+  struct likePool *pool;         //!< threads sharing the chi-square, or NULL (see likepool.c)
+  struct gpuData *gpu;           //!< the data on a GPU, or NULL (see startGPU())
+  struct modelSpec *model;       //!< the model fit to the data (see models.c)
+
+  // optional complex and closure terms, read by readClosures()
+  int Nterms;                    //!< total number of the terms below
+  int Nvis;                      //!< number of complex visibilities
+  int Ncphase;                   //!< number of closure phases
+  int Nlcamp;                    //!< number of log closure amplitudes
+  int *termIndex;                //!< the storage of the index tables
+  double *termBlock;             //!< the storage of the measured terms
+  int *visIndex;                 //!< data point (from 1) of each complex visibility
+  int *cphaseIndex;              //!< 3 signed data points (from 1) of each triangle
+  int *lcampIndex;               //!< 4 data points (from 1) of each quadrangle
+  double *visRe;                 //!< real parts of the complex visibilities
+  double *visIm;                 //!< imaginary parts of the complex visibilities
+  double *cphaseCos;             //!< cosines of the closure phases
+  double *cphaseSin;             //!< sines of the closure phases
+  double *cphaseInvVar;          //!< 1/sigma^2 of the closure phases, in 1/rad^2
+  double *lcamp;                 //!< log closure amplitudes
+  double *lcampInvVar;           //!< 1/sigma^2 of the log closure amplitudes
+} dataset;
+
+#define DEFAULT_MODEL "gauss2"   //!< the model fit unless setModel() chooses another
+
+/*!
+\brief
+A model that can be fit to the data
+
+\details
+The entries of the registry in models.c. The chi-square kernel
+evaluates the model over a range of data points of a data set prepared
+by prepareData(), and the complex visibility kernel stores its real
+and imaginary parts at the data points for the complex and closure
+terms; the scalar function model() evaluates its amplitude at one
+point of the (u,v) plane and agrees with the kernels to rounding. Models with
+Nblocks=MODELNBLOCKS have the 2-Gaussian structure cached by
+modelCache and can take block steps; the others take full steps only.
+Models with a gradient kernel, which returns the chi-square together
+with its derivatives in one pass over the data, can be sampled with
+SAMPLER_NUTS. Models with a single-precision kernel evaluate the
+chi-square from the arrays in floats of singleData(), with twice the
+lanes of the double kernel.
+
+*/
+typedef struct modelSpec
+{
+  char *name;                    //!< name of the model
+  int Nparam;                    //!< number of model parameters
+  char **names;                  //!< names of the parameters
+  double *init;                  //!< initial values of the parameters
+  int Nblocks;                   //!< blocks of parameters for block steps, or zero
+  //! returns one if the parameters are in the support of the prior
+  int (*valid)(int Nparam, double Aparam[]);
+  //! returns the log prior
+  double (*prior)(int Nparam, double Aparam[]);
+  //! returns the visibility amplitude at (uCo,vCo)
+  double (*model)(double uCo, double vCo, int Nparam, double Aparam[]);
+  //! returns the chi-square of the data points from first to last-1
+  double (*chi2)(int Nparam, double Aparam[], dataset *data, int first, int last);
+  //! stores the complex visibilities of the data points from first to last-1 in Vr[] and Vi[]
+  void (*vis)(int Nparam, double Aparam[], dataset *data, int first, int last, double Vr[], double Vi[]);
+  //! returns the chi-square of the data points from first to last-1 and stores its derivatives in gradient[], or NULL
+  double (*grad)(int Nparam, double Aparam[], dataset *data, int first, int last, double gradient[]);
+  //! returns the log prior and stores its derivatives in gradient[], or NULL
+  double (*priorGrad)(int Nparam, double Aparam[], double gradient[]);
+  //! returns the chi-square of the data points from first to last-1 from the arrays in floats, or NULL
+  double (*chi2f)(int Nparam, double Aparam[], dataset *data, int first, int last);
+} modelSpec;
+
+/*!
+\brief
+The components of the model at the current position of a chain
+
+\details
+The 2-Gaussian model separates into terms that each depend on one
+block of two parameters: the real part of Gaussian 1 on (A0,A1), the
+phase of Gaussian 2 on (A2,A3) and its amplitude on (A4,A5). Caching
+these terms for every data point lets a step that changes a single
+block re-evaluate only the transcendental functions of that block.
+All the arrays live in a single block of memory, aligned like those
+of the dataset. The structure is set up with initCache().
+
+*/
+typedef struct
+{
+  double *block;                 //!< the storage of all the arrays
+  double *Vr1;                   //!< real part of Gaussian 1, block 0
+  double *cph;                   //!< cosine of the phase of Gaussian 2, block 1
+  double *sph;                   //!< sine of the phase of Gaussian 2, block 1
+  double *V2;                    //!< amplitude of Gaussian 2, block 2
+  double *trial1;                //!< first component at the proposed position
+  double *trial2;                //!< second component at the proposed position
+} modelCache;
+
+/*!
+\brief
+The state of a single Metropolis chain
+
+\details
+Everything needed to advance a chain by one link with chainStep(): the
+current and proposed positions, the best model found so far, the
+inverse temperature of the chain and its own random number generator.
+The structure is set up with initChain() and released with freeChain().
+
+*/
+typedef struct
+{
+  int Nparam;                    //!< number of model parameters
+  double *Aparam;                //!< current position of the chain
+  double *AparamPlusOne;         //!< proposed position of the chain
+  double *AparamMax;             //!< parameters of the most likely model so far
+  double *dev;                   //!< standard deviations of the Gaussian steps
+
+  double priorpre;               //!< log prior at the current position
+  double likepre;                //!< log likelihood at the current position
+  double probpre;                //!< tempered log posterior at the current position
+  double postMax;                //!< maximum (untempered) log posterior so far
+
+  double beta;                   //!< inverse temperature (1 for the posterior)
+  long accept;                   //!< number of accepted steps
+
+  int proposal;                  //!< PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
+  int iblock;                    //!< block of parameters of the next block step
+  modelCache *cache;             //!< components of the model, or NULL for full steps
+
+  long Nlinks;                   //!< number of links taken (adaptive steps)
+  long Nadapt;                   //!< number of links over which the proposal adapts
+  int Nfactor;                   //!< number of factorizations of the covariance so far
+  double *mean;                  //!< running mean of the chain (adaptive steps)
+  double *M2;                    //!< running sum of squared deviations from the mean
+  double *chol;                  //!< Cholesky factor of the proposal covariance
+
+  mtState rng;                   //!< random number generator of the chain
+  dataset *data;                 //!< the data being fit
+} chainState;
+
+#define NBATCHMAX 64             //!< max number of batches of the convergence diagnostics
+
+/*!
+\brief
+The running sums for the convergence diagnostics of one chain
+
+\details
+The links are summed in batches of batchSize links, relative to the
+first link (shift); see diagnostics.c. The structure is set up with
+initStats() and fed with addStats().
+
+*/
+typedef struct
+{
+  int Nparam;                    //!< number of model parameters
+  long Nsamples;                 //!< number of links added
+  long batchSize;                //!< number of links per batch
+  int Nbatches;                  //!< number of full batches
+  long Ncurrent;                 //!< number of links in the current batch
+  double *block;                 //!< the storage of all the arrays
+  double *shift;                 //!< the first link, subtracted from all the others
+  double *csum;                  //!< sums of the current batch
+  double *csumsq;                //!< sums of squares of the current batch
+  double *bsum;                  //!< sums of the full batches, NBATCHMAX x Nparam
+  double *bsumsq;                //!< sums of squares of the full batches
+} chainStats;
+
+/*!
+\brief
+The convergence diagnostics of a run and its stopping rule
+
+\details
+The sampler stops once, for every parameter, the effective sample size
+is at least essTarget and the split R-hat at most rhatTarget; it
+checks every Ncheck links after burn-in. On return, the arrays (with
+room for Nparam values each, provided by the caller) hold the final
+diagnostics and Nlinks the number of links run by each chain.
+
+*/
+typedef struct
+{
+  double essTarget;              //!< effective sample size to stop at (0 to never stop early)
+  double rhatTarget;             //!< largest split R-hat to stop at
+  int Ncheck;                    //!< number of links between checks of the rule
+  long Nlinks;                   //!< number of links of each chain on return
+  double *ess;                   //!< effective sample sizes, summed over chains
+  double *iat;                   //!< integrated autocorrelation times of the first chain
+  double *rhat;                  //!< split R-hats
+} convergence;
+
+/*!
+\brief
+The settings and the results of a search for the best fit
+
+\details
+The search runs Nstarts Nelder-Mead simplexes in Nthreads threads,
+each of at most Nmax evaluations of the posterior (see optimize()).
+On return, the other fields hold the results.
+
+*/
+typedef struct
+{
+  int Nstarts;                   //!< number of starts
+  int Nthreads;                  //!< threads running the starts (the number used, on return)
+  double scale;                  //!< spread of the starts and size of the first simplex, as a fraction of each parameter
+  int Nmax;                      //!< evaluations of the posterior per start
+  double postInit;               //!< log posterior of the initial parameters, on return
+  double postMax;                //!< log posterior of the best fit, on return
+  long Neval;                    //!< evaluations of the posterior of the search, on return
+  int Nconverged;                //!< starts that converged within Nmax evaluations, on return
+  int best;                      //!< the start that found the best fit, from 1, on return
+} optimizer;
+
+/*!
+\brief
+A buffered writer for the file of an MCMC chain
+
+\details
+Set up with openChain(), fed one row at a time with writeChain() and
+finalized with closeChain(); see chainio.c for the file formats and
+the asynchronous I/O thread.
+
+*/
+typedef struct
+{
+  int format;                    //!< CHAIN_TEXT or CHAIN_NPY
+  int async;                     //!< if 1, the rows are written by an I/O thread
+  int Nparam;                    //!< number of model parameters per row
+  int Ncol;                      //!< number of columns per row
+  long Nchain;                   //!< expected number of rows (metadata)
+  uint32 seed;                   //!< seed of the random numbers (metadata)
+  char names[512];               //!< comma separated column names (metadata)
+
+  FILE *file;                    //!< the open file
+  double *buffer;                //!< block of rows being filled
+  char *textbuf;                 //!< stdio buffer of the text format
+  int Nbuf;                      //!< capacity of the block in rows
+  int Nrows;                     //!< rows currently in the block
+  long Ntotal;                   //!< rows recorded so far
+  int status;                    //!< nonzero if the I/O thread failed to write
+
+  double *blocks;                //!< ring of blocks shared with the I/O thread
+  int blockRows[CHAINNBLOCKS];              //!< number of rows in each block of the ring
+  atomic_long head;              //!< number of blocks published by the sampler
+  atomic_long tail;              //!< number of blocks written by the I/O thread
+  atomic_int done;               //!< set when no more blocks will be published
+  pthread_t thread;              //!< the I/O thread
+} chainWriter;
+
+#define SUMMARYNQUANT 5          //!< quantiles of each parameter in a chainSummary
+#define SUMMARYNRANGE 1000       //!< links that set the ranges of the histograms
+
+/*!
+\brief
+The streaming summary of the links of a chain
+
+\details
+Holds the running mean and covariance of the parameters, P-square
+estimates of their quantiles and their 1D and 2D histograms, in
+memory that does not grow with the length of the chain; see
+summary.c. The structure is set up with initSummary(), fed with
+addSummary() and written out with writeSummary(); block and counts
+hold its whole state, which a checkpoint saves (see writeCheckpoint()).
+
+*/
+typedef struct
+{
+  int Nparam;                    //!< number of model parameters
+  int Nbins;                     //!< bins of each histogram
+  long Nlinks;                   //!< number of links added
+  long Nblock;                   //!< number of doubles in block
+  long Ncounts;                  //!< number of longs in counts
+  double *block;                 //!< the storage of all the arrays of doubles
+  double *mean;                  //!< running mean of the parameters
+  double *comoment;              //!< running sums of products of the deviations, Nparam x Nparam
+  double *height;                //!< heights of the P-square markers, Nparam x SUMMARYNQUANT x 5
+  double *position;              //!< positions of the markers
+  double *desired;               //!< desired positions of the markers
+  double *first;                 //!< the first SUMMARYNRANGE links, which set the ranges
+  double *lower;                 //!< lower edge of the histograms of each parameter
+  double *width;                 //!< width of the bins of each parameter
+  long *counts;                  //!< the storage of all the histograms
+  long *hist1;                   //!< 1D histograms, Nparam x Nbins
+  long *hist2;                   //!< 2D histograms of the pairs of parameters, Nbins x Nbins each
+  long *Nout;                    //!< links outside the histograms of each parameter
+} chainSummary;
+
+/*!
+\brief
+The links of a chain that are recorded
+
+\details
+The first Nburn links are left out; of the others, every thin-th link
+goes to the chains file and all go to the summary, if there is one.
+A sampler passes each link through recordLink() (see summary.c).
+
+*/
+typedef struct
+{
+  long Nburn;                    //!< first links left out of the file and the summary
+  int thin;                      //!< record every thin-th link after them, 0 for none
+  chainSummary *summary;         //!< summary of the links after burn-in, or NULL
+} chainRecord;
+
+#define CONFIGNAMELENGTH 256     //!< max length of the strings of a runConfig
+#define CONFIGMAXPARAM 64        //!< max number of initial parameters of a runConfig
+
+/*!
+\brief
+The settings of a run
+
+\details
+Set to the defaults with defaultConfig() and changed by a
+configuration file and the command line with parseArgs(); see
+config.c for the names of the settings.
+
+*/
+typedef struct
+{
+  char filename[CONFIGNAMELENGTH];     //!< file with the data
+  char closurefname[CONFIGNAMELENGTH]; //!< file with the complex and closure terms, or ""
+  char chainfname[CONFIGNAMELENGTH];   //!< file with the chains, or "" for the default
+  char modelfname[CONFIGNAMELENGTH];   //!< file with the best-fit model
+  char logfname[CONFIGNAMELENGTH];     //!< file with the log of the run
+  char manifest[CONFIGNAMELENGTH];     //!< manifest of data sets to fit, or ""
+  char model[CONFIGNAMELENGTH];        //!< name of the model (see models.c)
+  int Ninit;                     //!< number of initial parameters given (0 for those of the model)
+  double init[CONFIGMAXPARAM];   //!< initial parameters
+  double frac;                   //!< width of the steps, as a fraction of each parameter
+  uint32 seed;                   //!< seed of the random numbers
+  int rng;                       //!< RNG_MT or RNG_PHILOX (see setGeneratorMT())
+  int verbose;                   //!< if 1, write the log of the run
+
+  int dataCache;                 //!< if 1, keep a binary cache of the data
+  double binSize;                //!< if >=0, merge the points in (u,v) cells of this size
+
+  int Nchain;                    //!< number of chain links
+  int sampler;                   //!< SAMPLER_MH, SAMPLER_ENSEMBLE, ...
+  int format;                    //!< CHAIN_TEXT or CHAIN_NPY
+  int async;                     //!< if 1, write the chains from an I/O thread
+  int proposal;                  //!< PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
+  int Nadapt;                    //!< burn-in links (-1 for Nchain/5)
+  int Nburn;                     //!< first links left out of the chains file and the summary
+  int thin;                      //!< record every thin-th link after them (0 for none)
+  char summaryfname[CONFIGNAMELENGTH]; //!< file with the summary of the links, or ""
+  int Nbins;                     //!< bins of the histograms of the summary
+  int Ncheckpoint;               //!< links between checkpoints (0 for none)
+  int restart;                   //!< if 1, continue from the last checkpoint
+
+  int Nwalkers;                  //!< number of walkers of SAMPLER_ENSEMBLE
+  int Nchains;                   //!< number of chains of SAMPLER_MULTI
+  int tempering;                 //!< if 1, the chains form a tempering ladder
+  double Tmax;                   //!< highest temperature of the ladder
+  int Nswap;                     //!< chain links between swap proposals
+  int Nleapfrog;                 //!< leapfrog steps of SAMPLER_NUTS links (0 for NUTS)
+
+  int likeThreads;               //!< helper threads for the chi-square (-1 for the free cores)
+  int likeNmin;                  //!< data points from which the helpers are used
+  int earlyExit;                 //!< if 1, stop the chi-square of sure rejections early
+  int precision;                 //!< PRECISION_DOUBLE, PRECISION_SINGLE or PRECISION_VALIDATE
+  int gpu;                       //!< if 1, evaluate the walkers of SAMPLER_ENSEMBLE on a GPU
+  int batchThreads;              //!< threads fitting a manifest (0 for one per core)
+
+  int optStarts;                 //!< starts of the search for the best fit (0 for none)
+  int optThreads;                //!< threads of the search (0 for one per core)
+  double optScale;               //!< spread of the starts, as a fraction of each parameter
+  int optNmax;                   //!< evaluations of the posterior per start
+
+  double essTarget;              //!< effective sample size to stop at (0 for never)
+  double rhatTarget;             //!< largest split R-hat to stop at
+  int Ncheck;                    //!< links between checks of the stopping rule
+} runConfig;
+
+// in chainio.c
+extern int openChain(chainWriter *writer, char fname[], int format, int Nparam, int Nextra, long Nchain, char *names[], uint32 seed);
+extern int appendChain(chainWriter *writer, char fname[], int format, int Nparam, int Nextra, long Nchain, char *names[], uint32 seed, long Nrows, long offset);
+extern int writeChain(chainWriter *writer, double row[]);
+extern int flushChain(chainWriter *writer, long *offset);
+extern int closeChain(chainWriter *writer);
+
+// in twister.c
+extern void seedMT(mtState *mt, uint32 seed);
+extern uint32 streamSeedMT(uint32 seed, int stream);
+extern uint32 randomMT(mtState *mt);
+extern void fillMT(mtState *mt, int Nfill, double result[]);
+extern void setGeneratorMT(int generator);
+extern void nextStepMT(mtState *mt);
+
+// in philox.c
+extern void philox4x32(uint32 key[], uint32 ctr[], uint32 out[]);
+extern void seedPhilox(mtState *mt, uint32 seed);
+extern void seekPhilox(mtState *mt, unsigned long long step, uint32 block, int nout);
+extern uint32 randomPhilox(mtState *mt);
+extern void fillPhilox(mtState *mt, int Nfill, double result[]);
+
+// in likelihood.c
+extern int allocData(dataset *data, int Nmax);
+extern void precomputeData(dataset *data);
+extern int prepareData(dataset *data, int Npts, double uCo[], double vCo[], double Vis[], double Sigma[]);
+extern void freeData(dataset *data);
+extern int binData(dataset *data, double binSize);
+extern double chi2Data(int Nparam, double Aparam[], dataset *data, int first, int last);
+extern int singleData(dataset *data, int precision);
+extern void reportPrecision(FILE *logfile, dataset *data);
+extern double chi2Terms(int Nparam, double Aparam[], dataset *data);
+extern int initCache(modelCache *cache, dataset *data);
+extern void freeCache(modelCache *cache);
+extern double fillCache(modelCache *cache, int Nparam, double Aparam[], dataset *data);
+extern double chi2Block(modelCache *cache, int iblock, int Nparam, double Aparam[], dataset *data);
+extern void acceptBlock(modelCache *cache, int iblock);
+
+// in chain.c
+extern double model(double uCo, double vCo, int Nparam, double Aparam[], dataset *data);
+extern double prior(int Nparam, double Aparam[], dataset *data);
+extern double like(int Nparam, double Aparam[], dataset *data);
+extern double likeBudget(int Nparam, double Aparam[], dataset *data, double chi2Max, int *Nused);
+extern double post(int Nparam, double Aparam[], dataset *data);
+extern double postGrad(int Nparam, double Aparam[], dataset *data, double gradient[]);
+extern void postBatch(int Nbatch, int Nparam, double Aparam[], dataset *data, double result[]);
+extern double gauss(mtState *mt, double sigma);
+extern void gaussFill(mtState *mt, int Ngauss, double result[]);
+extern double uniform(mtState *mt);
+extern int initChain(chainState *chain, int Nparam, double Aparam[], double dev[], double beta, uint32 seed, int proposal, dataset *data);
+extern void freeChain(chainState *chain);
+extern int mhStep(chainState *chain);
+extern int blockStep(chainState *chain);
+extern int chainStep(chainState *chain);
+extern double walkers(char fname[], int format, char *names[], int Nchain, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, int Ncheckpoint, int restart, uint32 seed, chainRecord *record, convergence *conv, dataset *data);
+
+// in hmc.c
+extern double hmc(char fname[], int format, char *names[], int Nchain, int Nparam, double Aparam[], double dev[], int Nleapfrog, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *stepSize, long *Ngrad);
+
+// in checkpoint.c
+extern int writeCheckpoint(char fname[], chainState *chain, chainStats *stats, chainSummary *summary, long Ndone, long Nrows, long offset);
+extern int readCheckpoint(char fname[], chainState *chain, chainStats *stats, chainSummary *summary, long *Ndone, long *Nrows, long *offset);
+
+// in diagnostics.c
+extern int initStats(chainStats *stats, int Nparam);
+extern void freeStats(chainStats *stats);
+extern void addStats(chainStats *stats, double Aparam[]);
+extern double iatStats(chainStats *stats, int iparam);
+extern int checkConvergence(int Nchains, chainStats stats[], convergence *conv);
+
+// in ensemble.c
+extern double ensemble(char fname[], int format, char *names[], int Nchain, int Nwalkers, int Nparam, double Aparam[], double dev[], uint32 seed, chainRecord *record, dataset *data);
+
+// in multichain.c
+extern void chainFileName(char out[], char fname[], int ichain);
+extern double multichain(char fname[], int format, char *names[], int Nchain, int Nchains, int tempering, double Tmax, int Nswap, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *swapRate);
+
+// in optimize.c
+extern int optimize(int Nparam, double Aparam[], uint32 seed, optimizer *opt, dataset *data);
+
+// in summary.c
+extern int initSummary(chainSummary *summary, int Nparam, int Nbins);
+extern void freeSummary(chainSummary *summary);
+extern void addSummary(chainSummary *summary, double row[]);
+extern int writeSummary(char fname[], chainSummary *summary, char *names[]);
+extern int recordLink(chainWriter *writer, chainRecord *record, long ilink, double row[]);
+extern long recordedLinks(chainRecord *record, long Nchain);
+
+// in likepool.c
+extern int startPool(dataset *data, int Nhelpers, int Nmin);
+extern void stopPool(dataset *data);
+extern double chi2Pool(int Nparam, double Aparam[], dataset *data);
+
+// in models.c
+extern modelSpec *findModel(char name[]);
+extern int setModel(dataset *data, char name[]);
+
+// in batch.c
+extern int batch(char manifest[], int Nthreads, int format, int Nchain, int proposal, int Nadapt, int Ncheckpoint, int restart, double frac, uint32 seed, chainRecord *record, convergence *conv, int *Nfailed);
+
+// in config.c
+extern void defaultConfig(runConfig *cfg);
+extern int setConfig(runConfig *cfg, char key[], char value[]);
+extern int readConfig(char fname[], runConfig *cfg);
+extern void writeConfig(FILE *file, runConfig *cfg);
+extern int parseArgs(int argc, char *argv[], runConfig *cfg);
+
+// in chain.c (only in builds with USE_GPU)
+extern int startGPU(dataset *data);
+extern void stopGPU(dataset *data);
+
+// in mpichain.c (only in builds with USE_MPI)
+extern double mpichain(char fname[], int format, char *names[], int Nchain, int tempering, double Tmax, int Nswap, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *swapRate);
+
+// in readdata.c
+extern int readData(char filename[], dataset *data, int cache);
+extern int readClosures(char filename[], dataset *data);
+
+#endif
@@ -0,0 +1,832 @@
+/*! \file
+  \brief
+  File with the models that can be fit to the data
+
+  \details
+  Each model is described by a modelSpec in the registry models[]: its
+  name, its number of parameters and their names and initial values,
+  and the functions that give its prior, its support, its visibility
+  amplitude at a point of the (u,v) plane, the chi-square of the
+  amplitudes of a range of data points and their complex visibilities,
+  and, for the gradient-based samplers, the chi-square together with its
+  derivatives.
+  A model is chosen for a data set by name with setModel(), and the
+  likelihood calls its chi-square kernel once per evaluation, never per
+  data point; when the data also have complex or closure terms, it
+  calls the kernel of the complex visibilities instead, once for all
+  the data points (see chi2Terms()).
+
+  The Gaussian models also have a single-precision chi-square kernel,
+  which evaluates the model from the arrays in floats of singleData()
+  in twice as many lanes, and sums the terms of the points in double
+  precision.
+
+  The kernels of models that come in families (e.g., N Gaussian
+  components) are written once as static inline functions of the size
+  of the family, forced inline into one wrapper per member of the
+  family with a constant size. The compiler thus specializes every
+  member, fully unrolling the loops over components, much as a C++
+  template would.
+
+  The models are:
+
+  - "gauss1", "gauss2", "gauss3": a zero-centered Gaussian, with flux F1
+    and width sigma1, plus N-1 displaced Gaussians, each with
+    displacement (x,y), flux F and width sigma; "gauss2" is the
+    original 2-Gaussian model with parameters F1, sigma1, x2, y2, F2,
+    sigma2.
+
+  - "ring": a thin ring of flux F and radius R blurred by a Gaussian of
+    width sigma, a simple model of the shadow of a black hole.
+
+  All lengths are in microarcsec.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "mcmc.h"
+#include "simd.h"
+
+#define NGAUSSMAX 3                // largest number of Gaussian components
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+Calculates the visibility amplitude of NGAUSS Gaussian components
+
+\details
+The first component is zero centered; component k>=1 has parameters
+(x,y,F,sigma) in Aparam[4k-2..4k+1].
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param uCo a double with the u-coordinate for the evaluation of the model
+
+@param vCo a double with the v-coordinate for the evaluation of the model
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+\return a double with the visibility amplitude
+
+*/
+static inline __attribute__((always_inline)) double gaussModel(const int NGAUSS, double uCo, double vCo, double Aparam[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double b02=uCo*uCo+vCo*vCo;     // baseline length squared
+  int k;
+
+  b02*=muarcsecToRad*muarcsecToRad;
+  // real and imaginary parts of Gaussian 1 (zero centered)
+  double Vr=Aparam[0]*exp(-aux*Aparam[1]*Aparam[1]*b02);
+  double Vi=0.0;
+
+  // amplitude, real and imaginary parts of the displaced Gaussians
+  for (k=1;k<NGAUSS;k++)
+    {
+      double Vk=Aparam[4*k]*exp(-aux*Aparam[4*k+1]*Aparam[4*k+1]*b02);
+      double phasek=-2.*M_PI*(uCo*Aparam[4*k-2]+vCo*Aparam[4*k-1])*muarcsecToRad;
+      Vr+=Vk*cos(phasek);
+      Vi+=Vk*sin(phasek);
+    }
+
+  // the modulus of the sum
+  return sqrt(Vr*Vr+Vi*Vi);
+}
+
+/*!
+\brief
+Calculates the chi-square of NGAUSS Gaussian components over a range of data points
+
+\details
+Evaluates the same model as gaussModel() for VLEN data points at a
+time, using the per-point quantities precomputed by precomputeData().
+The parameter combinations that are common to all points are
+calculated once per call.
+
+The lanes are accumulated separately and summed in a fixed order at
+the end, so that the result does not depend on anything but the
+range of points.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+\return a double with the chi-square of the points in the range
+
+*/
+static inline __attribute__((always_inline)) double gaussChi2(const int NGAUSS, double Aparam[], dataset *data, int first, int last)
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  int index, lane, k;
+
+  // parameter combinations common to all data points
+  vdouble flux1=vset(Aparam[0]);
+  vdouble width1=vset(-aux*Aparam[1]*Aparam[1]);
+  vdouble xdisp[NGAUSSMAX], ydisp[NGAUSSMAX], flux[NGAUSSMAX], width[NGAUSSMAX];
+  for (k=1;k<NGAUSS;k++)
+    {
+      xdisp[k]=vset(Aparam[4*k-2]);
+      ydisp[k]=vset(Aparam[4*k-1]);
+      flux[k]=vset(Aparam[4*k]);
+      width[k]=vset(-aux*Aparam[4*k+1]*Aparam[4*k+1]);
+    }
+
+  vdouble chi2=vset(0.0);
+
+  for (index=first;index<last;index+=VLEN)
+    {
+      vdouble b02=vload(data->b02+index);
+
+      // Gaussian 1 (zero centered)
+      vdouble Vr=flux1*vexp(width1*b02);
+      vdouble Vi=vset(0.0);
+
+      // amplitude, phase, real and imaginary parts of the displaced Gaussians
+#pragma GCC unroll 8
+      for (k=1;k<NGAUSS;k++)
+	{
+	  vdouble Vk=flux[k]*vexp(width[k]*b02);
+	  vdouble phasek=xdisp[k]*vload(data->uPh+index)+ydisp[k]*vload(data->vPh+index);
+	  vdouble cosk, sink;
+	  vsincos(phasek,sink,cosk);
+	  Vr+=Vk*cosk;
+	  Vi+=Vk*sink;
+	}
+
+      // difference between model amplitude and data
+      vdouble variance=vload(data->Vis+index)-vsqrt(Vr*Vr+Vi*Vi);
+      chi2+=variance*variance*vload(data->invVar+index);
+    }
+
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  return result;
+}
+
+/*!
+\brief
+Calculates the chi-square of NGAUSS Gaussian components over a range of data points, in single precision
+
+\details
+The same model as gaussChi2(), evaluated in floats from the arrays of
+singleData(), VLENF data points at a time. The parameter combinations
+are formed in double precision and only then rounded to floats. The
+term of each point is also calculated in floats, but the terms are
+summed in double precision (see vfwiden()), so that the rounding errors
+of the points do not grow with their number.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set, with the arrays in floats
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+\return a double with the chi-square of the points in the range
+
+*/
+static inline __attribute__((always_inline)) double gaussChi2f(const int NGAUSS, double Aparam[], dataset *data, int first, int last)
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  int index, lane, k;
+
+  // parameter combinations common to all data points
+  vfloat flux1=vfset(Aparam[0]);
+  vfloat width1=vfset(-aux*Aparam[1]*Aparam[1]);
+  vfloat xdisp[NGAUSSMAX], ydisp[NGAUSSMAX], flux[NGAUSSMAX], width[NGAUSSMAX];
+  for (k=1;k<NGAUSS;k++)
+    {
+      xdisp[k]=vfset(Aparam[4*k-2]);
+      ydisp[k]=vfset(Aparam[4*k-1]);
+      flux[k]=vfset(Aparam[4*k]);
+      width[k]=vfset(-aux*Aparam[4*k+1]*Aparam[4*k+1]);
+    }
+
+  vdouble chi2=vset(0.0);
+
+  for (index=first;index<last;index+=VLENF)
+    {
+      vfloat b02=vfload(data->b02f+index);
+
+      // Gaussian 1 (zero centered)
+      vfloat Vr=flux1*vfexp(width1*b02);
+      vfloat Vi=vfset(0.0);
+
+      // amplitude, phase, real and imaginary parts of the displaced Gaussians
+#pragma GCC unroll 8
+      for (k=1;k<NGAUSS;k++)
+	{
+	  vfloat Vk=flux[k]*vfexp(width[k]*b02);
+	  vfloat phasek=xdisp[k]*vfload(data->uPhf+index)+ydisp[k]*vfload(data->vPhf+index);
+	  vfloat cosk, sink;
+	  vfsincos(phasek,sink,cosk);
+	  Vr+=Vk*cosk;
+	  Vi+=Vk*sink;
+	}
+
+      // difference between model amplitude and data
+      vfloat variance=vfload(data->Visf+index)-vfsqrt(Vr*Vr+Vi*Vi);
+      chi2+=vfwiden(variance*variance*vfload(data->invVarf+index));
+    }
+
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  return result;
+}
+
+/*!
+\brief
+Calculates the complex visibilities of NGAUSS Gaussian components over a range of data points
+
+\details
+Evaluates the real and imaginary parts of the same model as
+gaussChi2(), for VLEN data points at a time, and stores them in Vr[]
+and Vi[] (aligned to DATA_ALIGN), for the complex and closure terms of
+chi2Terms().
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+@param Vr[] an array of doubles with the real parts on return
+
+@param Vi[] an array of doubles with the imaginary parts on return
+
+*/
+static inline __attribute__((always_inline)) void gaussVis(const int NGAUSS, double Aparam[], dataset *data, int first, int last, double Vr[], double Vi[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  int index, k;
+
+  // parameter combinations common to all data points
+  vdouble flux1=vset(Aparam[0]);
+  vdouble width1=vset(-aux*Aparam[1]*Aparam[1]);
+  vdouble xdisp[NGAUSSMAX], ydisp[NGAUSSMAX], flux[NGAUSSMAX], width[NGAUSSMAX];
+  for (k=1;k<NGAUSS;k++)
+    {
+      xdisp[k]=vset(Aparam[4*k-2]);
+      ydisp[k]=vset(Aparam[4*k-1]);
+      flux[k]=vset(Aparam[4*k]);
+      width[k]=vset(-aux*Aparam[4*k+1]*Aparam[4*k+1]);
+    }
+
+  for (index=first;index<last;index+=VLEN)
+    {
+      vdouble b02=vload(data->b02+index);
+
+      // Gaussian 1 (zero centered)
+      vdouble Vreal=flux1*vexp(width1*b02);
+      vdouble Vimag=vset(0.0);
+
+      // amplitude, phase, real and imaginary parts of the displaced Gaussians
+#pragma GCC unroll 8
+      for (k=1;k<NGAUSS;k++)
+	{
+	  vdouble Vk=flux[k]*vexp(width[k]*b02);
+	  vdouble phasek=xdisp[k]*vload(data->uPh+index)+ydisp[k]*vload(data->vPh+index);
+	  vdouble cosk, sink;
+	  vsincos(phasek,sink,cosk);
+	  Vreal+=Vk*cosk;
+	  Vimag+=Vk*sink;
+	}
+
+      vstore(Vr+index,Vreal);
+      vstore(Vi+index,Vimag);
+    }
+}
+
+/*!
+\brief
+Calculates the chi-square of NGAUSS Gaussian components and its gradient over a range of data points
+
+\details
+Evaluates the same model as gaussChi2(), for VLEN data points at a
+time, and in the same pass the derivatives of the chi-square with
+respect to all the parameters, from the exponentials, cosines and
+sines already calculated for the model. With the model amplitude
+|V|=sqrt(Vr^2+Vi^2), each point adds
+
+d chi2/dA = -2 (Vis-|V|) invVar (Vr dVr/dA + Vi dVi/dA)/|V|
+
+so the per-point weights g Vr and g Vi, with g=-2 (Vis-|V|) invVar/|V|,
+are formed once and multiply the derivatives of the real and imaginary
+parts of every component. The factors common to all the points (e.g.,
+d width/d sigma) are applied once at the end. The padding has zero
+invVar, and so does not contribute.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+@param gradient[] an array of doubles with the derivatives of the chi-square on return
+
+\return a double with the chi-square of the points in the range
+
+*/
+static inline __attribute__((always_inline)) double gaussGrad(const int NGAUSS, double Aparam[], dataset *data, int first, int last, double gradient[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  int index, lane, k, iparam;
+
+  // parameter combinations common to all data points
+  vdouble flux1=vset(Aparam[0]);
+  vdouble width1=vset(-aux*Aparam[1]*Aparam[1]);
+  vdouble xdisp[NGAUSSMAX], ydisp[NGAUSSMAX], flux[NGAUSSMAX], width[NGAUSSMAX];
+  for (k=1;k<NGAUSS;k++)
+    {
+      xdisp[k]=vset(Aparam[4*k-2]);
+      ydisp[k]=vset(Aparam[4*k-1]);
+      flux[k]=vset(Aparam[4*k]);
+      width[k]=vset(-aux*Aparam[4*k+1]*Aparam[4*k+1]);
+    }
+
+  // running sums of the derivatives, in the order of the parameters
+  vdouble chi2=vset(0.0);
+  vdouble dsum[4*NGAUSSMAX-2];
+  for (iparam=1;iparam<=4*NGAUSS-2;iparam++)
+    dsum[iparam-1]=vset(0.0);
+
+  for (index=first;index<last;index+=VLEN)
+    {
+      vdouble b02=vload(data->b02+index);
+      vdouble uPh=vload(data->uPh+index);
+      vdouble vPh=vload(data->vPh+index);
+
+      // Gaussian 1 (zero centered)
+      vdouble e1=vexp(width1*b02);
+      vdouble Vr=flux1*e1;
+      vdouble Vi=vset(0.0);
+
+      // amplitude, phase, real and imaginary parts of the displaced Gaussians
+      vdouble ek[NGAUSSMAX], cosk[NGAUSSMAX], sink[NGAUSSMAX];
+#pragma GCC unroll 8
+      for (k=1;k<NGAUSS;k++)
+	{
+	  vdouble phasek=xdisp[k]*uPh+ydisp[k]*vPh;
+	  ek[k]=vexp(width[k]*b02);
+	  vsincos(phasek,sink[k],cosk[k]);
+	  Vr+=flux[k]*ek[k]*cosk[k];
+	  Vi+=flux[k]*ek[k]*sink[k];
+	}
+
+      // difference between model amplitude and data
+      vdouble amp=vsqrt(Vr*Vr+Vi*Vi);
+      vdouble invVar=vload(data->invVar+index);
+      vdouble variance=vload(data->Vis+index)-amp;
+      chi2+=variance*variance*invVar;
+
+      // weights of the derivatives of the real and imaginary parts
+      vdouble g=vset(-2.0)*variance*invVar/amp;
+      vdouble gr=g*Vr, gi=g*Vi;
+
+      dsum[0]+=gr*e1;                          // F1
+      dsum[1]+=gr*e1*b02;                      // sigma1, but for F1 d width1/d sigma1
+#pragma GCC unroll 8
+      for (k=1;k<NGAUSS;k++)
+	{
+	  vdouble along=(gr*cosk[k]+gi*sink[k])*ek[k];
+	  vdouble across=(gi*cosk[k]-gr*sink[k])*ek[k];
+	  dsum[4*k-2]+=across*uPh;             // x, but for F
+	  dsum[4*k-1]+=across*vPh;             // y, but for F
+	  dsum[4*k]+=along;                    // F
+	  dsum[4*k+1]+=along*b02;              // sigma, but for F d width/d sigma
+	}
+    }
+
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  for (iparam=1;iparam<=4*NGAUSS-2;iparam++)
+    {
+      vstore(sum,dsum[iparam-1]);
+      gradient[iparam-1]=0.0;
+      for (lane=0;lane<VLEN;lane++)
+	gradient[iparam-1]+=sum[lane];
+    }
+
+  // the factors common to all the points
+  gradient[1]*=-2.*aux*Aparam[1]*Aparam[0];
+  for (k=1;k<NGAUSS;k++)
+    {
+      gradient[4*k-2]*=Aparam[4*k];
+      gradient[4*k-1]*=Aparam[4*k];
+      gradient[4*k+1]*=-2.*aux*Aparam[4*k+1]*Aparam[4*k];
+    }
+
+  return result;
+}
+
+/*!
+\brief
+Checks that the fluxes and widths of NGAUSS Gaussian components are not negative
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+\return one if the parameters are allowed, zero otherwise
+
+*/
+static inline __attribute__((always_inline)) int gaussValid(const int NGAUSS, double Aparam[])
+{
+  int k;
+
+  if (Aparam[0]<0 || Aparam[1]<0)
+    return 0;
+  for (k=1;k<NGAUSS;k++)
+    if (Aparam[4*k]<0 || Aparam[4*k+1]<0)
+      return 0;
+
+  return 1;
+}
+
+/*!
+\brief
+Calculates the prior of NGAUSS Gaussian components
+
+\details
+For each Gaussian component, the prior is inversely proportional to
+the two scale parameters, normalization and width.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+\return a double with the log prior
+
+*/
+static inline __attribute__((always_inline)) double gaussPrior(const int NGAUSS, double Aparam[])
+{
+  double scales=Aparam[0]*Aparam[1];
+  int k;
+
+  // NB: no check for zeros, to increase efficiency
+  for (k=1;k<NGAUSS;k++)
+    scales*=Aparam[4*k]*Aparam[4*k+1];
+
+  return -log(scales);
+}
+
+/*!
+\brief
+Calculates the prior of NGAUSS Gaussian components and its gradient
+
+\details
+The same prior as gaussPrior(); its derivative is -1/A for each of the
+scale parameters and zero for the displacements.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param NGAUSS an int with the number of Gaussian components
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param gradient[] an array of doubles with the derivatives of the log prior on return
+
+\return a double with the log prior
+
+*/
+static inline __attribute__((always_inline)) double gaussPriorGrad(const int NGAUSS, double Aparam[], double gradient[])
+{
+  int k;
+
+  gradient[0]=-1.0/Aparam[0];
+  gradient[1]=-1.0/Aparam[1];
+  for (k=1;k<NGAUSS;k++)
+    {
+      gradient[4*k-2]=gradient[4*k-1]=0.0;
+      gradient[4*k]=-1.0/Aparam[4*k];
+      gradient[4*k+1]=-1.0/Aparam[4*k+1];
+    }
+
+  return gaussPrior(NGAUSS,Aparam);
+}
+
+// one specialized copy of the functions above for each number of components
+#define GAUSS_MODEL(NGAUSS)						\
+  static double gauss##NGAUSS##Model(double uCo, double vCo, int Nparam, double Aparam[]) \
+  { return gaussModel(NGAUSS,uCo,vCo,Aparam); }				\
+  static double gauss##NGAUSS##Chi2(int Nparam, double Aparam[], dataset *data, int first, int last) \
+  { return gaussChi2(NGAUSS,Aparam,data,first,last); }			\
+  static void gauss##NGAUSS##Vis(int Nparam, double Aparam[], dataset *data, int first, int last, double Vr[], double Vi[]) \
+  { gaussVis(NGAUSS,Aparam,data,first,last,Vr,Vi); }			\
+  static int gauss##NGAUSS##Valid(int Nparam, double Aparam[])		\
+  { return gaussValid(NGAUSS,Aparam); }					\
+  static double gauss##NGAUSS##Prior(int Nparam, double Aparam[])	\
+  { return gaussPrior(NGAUSS,Aparam); }					\
+  static double gauss##NGAUSS##Grad(int Nparam, double Aparam[], dataset *data, int first, int last, double gradient[]) \
+  { return gaussGrad(NGAUSS,Aparam,data,first,last,gradient); }		\
+  static double gauss##NGAUSS##PriorGrad(int Nparam, double Aparam[], double gradient[]) \
+  { return gaussPriorGrad(NGAUSS,Aparam,gradient); }			\
+  static double gauss##NGAUSS##Chi2f(int Nparam, double Aparam[], dataset *data, int first, int last) \
+  { return gaussChi2f(NGAUSS,Aparam,data,first,last); }
+
+GAUSS_MODEL(1)
+GAUSS_MODEL(2)
+GAUSS_MODEL(3)
+
+/*!
+\brief
+Calculates the visibility amplitude of a blurred thin ring
+
+\details
+A thin ring of flux F=Aparam[0] and radius R=Aparam[1] has visibility
+F J0(2 pi R b) at baseline length b; blurring it with a Gaussian of
+width sigma=Aparam[2] multiplies it by exp(-2 pi^2 sigma^2 b^2).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param uCo a double with the u-coordinate for the evaluation of the model
+
+@param vCo a double with the v-coordinate for the evaluation of the model
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+\return a double with the visibility amplitude
+
+*/
+static double ringModel(double uCo, double vCo, int Nparam, double Aparam[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double b02=(uCo*uCo+vCo*vCo)*muarcsecToRad*muarcsecToRad;
+
+  return fabs(Aparam[0]*j0(2.*M_PI*Aparam[1]*sqrt(b02))*exp(-aux*Aparam[2]*Aparam[2]*b02));
+}
+
+/*!
+\brief
+Calculates the chi-square of a blurred thin ring over a range of data points
+
+\details
+Evaluates the same model as ringModel() for VLEN data points at a time.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+\return a double with the chi-square of the points in the range
+
+*/
+static double ringChi2(int Nparam, double Aparam[], dataset *data, int first, int last)
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  double sum[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  double result=0.0;
+  int index, lane;
+
+  vdouble flux=vset(Aparam[0]);
+  vdouble kradius=vset(2.*M_PI*Aparam[1]);
+  vdouble width=vset(-aux*Aparam[2]*Aparam[2]);
+
+  vdouble chi2=vset(0.0);
+
+  for (index=first;index<last;index+=VLEN)
+    {
+      vdouble b02=vload(data->b02+index);
+      vdouble V=flux*vj0(kradius*vsqrt(b02))*vexp(width*b02);
+
+      vdouble variance=vload(data->Vis+index)-vsqrt(V*V);
+      chi2+=variance*variance*vload(data->invVar+index);
+    }
+
+  vstore(sum,chi2);
+  for (lane=0;lane<VLEN;lane++)
+    result+=sum[lane];
+
+  return result;
+}
+
+/*!
+\brief
+Calculates the complex visibilities of a blurred thin ring over a range of data points
+
+\details
+The ring is centered, so its visibility is real; stores it in Vr[]
+and zeros in Vi[] (aligned to DATA_ALIGN).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the current values of the model parameters
+
+@param data a pointer to the prepared data set
+
+@param first an int with the first data point of the range (a multiple of DATA_PAD)
+
+@param last an int with one past the last data point of the range (a multiple of DATA_PAD)
+
+@param Vr[] an array of doubles with the real parts on return
+
+@param Vi[] an array of doubles with the imaginary parts on return
+
+*/
+static void ringVis(int Nparam, double Aparam[], dataset *data, int first, int last, double Vr[], double Vi[])
+{
+  double aux=2.*M_PI*M_PI;        // aux quantity used a lot below
+  int index;
+
+  vdouble flux=vset(Aparam[0]);
+  vdouble kradius=vset(2.*M_PI*Aparam[1]);
+  vdouble width=vset(-aux*Aparam[2]*Aparam[2]);
+
+  for (index=first;index<last;index+=VLEN)
+    {
+      vdouble b02=vload(data->b02+index);
+
+      vstore(Vr+index,flux*vj0(kradius*vsqrt(b02))*vexp(width*b02));
+      vstore(Vi+index,vset(0.0));
+    }
+}
+
+static int ringValid(int Nparam, double Aparam[])
+{
+  return (Aparam[0]>=0 && Aparam[1]>=0 && Aparam[2]>=0);
+}
+
+static double ringPrior(int Nparam, double Aparam[])
+{
+  // inversely proportional to the flux, radius and width
+  return -log(Aparam[0]*Aparam[1]*Aparam[2]);
+}
+
+// the parameters of the models and their initial values
+static char *gauss1Names[]={"F1","sigma1"};
+static double gauss1Init[]={4.5,4.8};
+
+static char *gauss2Names[]={"F1","sigma1","x2","y2","F2","sigma2"};
+static double gauss2Init[]={
+  4.5,                            // flux of first Gaussian component
+  4.8,                            // width of first Gaussian component
+  -11.5,                          // x-displacement of 2nd Gaussian component
+  13.6,                           // y-displacement of 2nd Gaussian component
+  1.4,                            // flux of 2nd Gaussian component
+  3.1                             // width of 2nd Gaussian component
+};
+/* BEST-FIT parameters for synth_data.dat
+  4.0, 5., -12., 13., 1.2, 3.
+*/
+
+static char *gauss3Names[]={"F1","sigma1","x2","y2","F2","sigma2","x3","y3","F3","sigma3"};
+static double gauss3Init[]={4.5,4.8,-11.5,13.6,1.4,3.1,10.,-10.,0.5,3.};
+
+static char *ringNames[]={"F","R","sigma"};
+static double ringInit[]={5.,20.,5.};
+
+//! the models that can be fit, the first one being the default
+static modelSpec models[]={
+  {"gauss2",6,gauss2Names,gauss2Init,MODELNBLOCKS,gauss2Valid,gauss2Prior,gauss2Model,gauss2Chi2,gauss2Vis,gauss2Grad,gauss2PriorGrad,gauss2Chi2f},
+  {"gauss1",2,gauss1Names,gauss1Init,0,gauss1Valid,gauss1Prior,gauss1Model,gauss1Chi2,gauss1Vis,gauss1Grad,gauss1PriorGrad,gauss1Chi2f},
+  {"gauss3",10,gauss3Names,gauss3Init,0,gauss3Valid,gauss3Prior,gauss3Model,gauss3Chi2,gauss3Vis,gauss3Grad,gauss3PriorGrad,gauss3Chi2f},
+  {"ring",3,ringNames,ringInit,0,ringValid,ringPrior,ringModel,ringChi2,ringVis,NULL,NULL,NULL}
+};
+
+/*!
+\brief
+Finds a model in the registry by name
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param name a string with the name of the model, or NULL for the default one
+
+\return a pointer to the model, or NULL if there is no model with that name
+
+*/
+modelSpec *findModel(char name[])
+{
+  int imodel;
+
+  if (name==NULL)
+    return &models[0];
+
+  for (imodel=1;imodel<=(int)(sizeof(models)/sizeof(models[0]));imodel++)
+    if (strcmp(models[imodel-1].name,name)==0)
+      return &models[imodel-1];
+
+  return NULL;
+}
+
+/*!
+\brief
+Chooses the model to fit to a data set
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main() after readData()
+
+@param data a pointer to the data set
+
+@param name a string with the name of the model (see models.c)
+
+\return zero if all was OK, ERROR_FILE if there is no model with that name
+
+*/
+int setModel(dataset *data, char name[])
+{
+  modelSpec *model=findModel(name);
+  int imodel;
+
+  if (model==NULL)
+    {
+      printf("Unknown model %s; the models are:",name);
+      for (imodel=1;imodel<=(int)(sizeof(models)/sizeof(models[0]));imodel++)
+	printf(" %s",models[imodel-1].name);
+      printf("\n");
+      return ERROR_FILE;
+    }
+
+  data->model=model;
+  return 0;
+}
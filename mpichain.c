@@ -0,0 +1,408 @@
+/*! \file
+  \brief
+  File with subroutines to run MCMC chains across the ranks of an MPI job
+
+  \details
+  The MPI counterpart of multichain.c: each rank runs one chain, with
+  its own random number generator seeded from a separate stream (see
+  streamSeedMT()), and records it in its own file, so that nothing is
+  gathered on rank 0 but the diagnostics and the best fit. The chains
+  are either independent copies of the posterior or the rungs of a
+  parallel-tempering ladder with one temperature per rank.
+
+  Swaps between temperatures only involve neighbouring ranks: every
+  Nswap links, either the even or the odd pairs of ranks (in turn)
+  exchange their positions and log likelihoods in a single message
+  each way, and the colder rank of each pair draws the decision and
+  sends it to the hotter one.
+
+  This file is only compiled in builds with USE_MPI (see the Makefile).
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#ifdef USE_MPI
+
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+#include<mpi.h>
+
+#include "mcmc.h"
+#include "instrument.h"
+
+#define CHAINFNAMELENGTH 256       // max length of the per-chain filenames
+
+#define TAG_STATE 1                // message with the position of a chain
+#define TAG_SWAP 2                 // message with the decision of a swap
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+Proposes a swap with a neighbouring rank of a tempering ladder
+
+\details
+Exchanges the position, log prior and log likelihood of the chain with
+those of the rank partner. The colder rank accepts the swap with probability
+min(1, exp[(beta1-beta2)(L2-L1)]), as in swapChains(), and sends its
+decision to the hotter rank; if the swap is accepted, both chains take
+the position of the other and update their tempered posteriors and the
+cached components of the model, if any. Every decision starts a new
+step of the generator of the swaps (see nextStepMT()).
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from mpichain() by both ranks of the pair at once
+
+@param chain a pointer to the chain of this rank
+
+@param partner an int with the rank of the neighbouring temperature
+
+@param betaPartner a double with the inverse temperature of the partner
+
+@param rng a pointer to the random number generator for the swaps
+
+@param buffer an array of Nparam+2 doubles, to receive the position of the partner
+
+\return one if the swap was accepted, zero otherwise
+
+*/
+static int swapRanks(chainState *chain, int partner, double betaPartner, mtState *rng, double buffer[])
+{
+  int Nparam=chain->Nparam;
+  int rank, accept, iparam;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+
+  // the positions cross in one message each way
+  double send[Nparam+2];
+  send[0]=chain->priorpre;
+  send[1]=chain->likepre;
+  for (iparam=1;iparam<=Nparam;iparam++)
+    send[iparam+1]=chain->Aparam[iparam-1];
+  MPI_Sendrecv(send,Nparam+2,MPI_DOUBLE,partner,TAG_STATE,
+	       buffer,Nparam+2,MPI_DOUBLE,partner,TAG_STATE,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+
+  // the colder chain (of lower rank) decides
+  if (rank<partner)
+    {
+      double lnratio=(chain->beta-betaPartner)*(buffer[1]-chain->likepre);
+      nextStepMT(rng);
+      accept=(lnratio>=log(uniform(rng)));
+      MPI_Send(&accept,1,MPI_INT,partner,TAG_SWAP,MPI_COMM_WORLD);
+    }
+  else
+    MPI_Recv(&accept,1,MPI_INT,partner,TAG_SWAP,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+
+  if (!accept)
+    return 0;
+
+  chain->priorpre=buffer[0];
+  chain->likepre=buffer[1];
+  for (iparam=1;iparam<=Nparam;iparam++)
+    chain->Aparam[iparam-1]=buffer[iparam+1];
+  chain->probpre=chain->priorpre+chain->beta*chain->likepre;
+  if (chain->cache!=NULL)
+    fillCache(chain->cache,Nparam,chain->Aparam,chain->data);
+
+  return 1;
+}
+
+/*!
+\brief
+Checks the stopping rule over the chains of all ranks
+
+\details
+Gathers the running sums of the diagnostics of the first Nstats ranks
+on rank 0, which checks the stopping rule with checkConvergence() and
+broadcasts the decision. On return, conv holds the diagnostics on rank
+0 only.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from mpichain() by all ranks at once
+
+@param stats a pointer to the running sums of the chain of this rank
+
+@param Nstats an int with the number of ranks whose chains count
+
+@param conv a pointer to the stopping rule, and the diagnostics on return
+
+\return one if the stopping rule of conv is met, zero otherwise
+
+*/
+static int checkRanks(chainStats *stats, int Nstats, convergence *conv)
+{
+  int Nparam=stats->Nparam;
+  int Nsums=(2*NBATCHMAX+3)*Nparam;
+  int rank, irank, stop=0;
+  long long counters[4]={stats->Nsamples,stats->batchSize,stats->Ncurrent,stats->Nbatches};
+  long long *allCounters=NULL;
+  double *allSums=NULL;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+
+  if (rank==0)
+    {
+      allCounters=malloc(4*Nstats*sizeof(long long));
+      allSums=malloc((size_t)Nsums*Nstats*sizeof(double));
+      if (allCounters==NULL || allSums==NULL)
+	{
+	  printf("Error allocating memory for the diagnostics\n");
+	  MPI_Abort(MPI_COMM_WORLD,ERROR_FILE);
+	}
+    }
+
+  // only the first Nstats ranks take part; the others send nothing
+  MPI_Comm statsComm;
+  MPI_Comm_split(MPI_COMM_WORLD,(rank<Nstats) ? 0 : MPI_UNDEFINED,rank,&statsComm);
+  if (statsComm!=MPI_COMM_NULL)
+    {
+      MPI_Gather(counters,4,MPI_LONG_LONG,allCounters,4,MPI_LONG_LONG,0,statsComm);
+      MPI_Gather(stats->block,Nsums,MPI_DOUBLE,allSums,Nsums,MPI_DOUBLE,0,statsComm);
+      MPI_Comm_free(&statsComm);
+    }
+
+  if (rank==0)
+    {
+      chainStats all[Nstats];
+      for (irank=1;irank<=Nstats;irank++)
+	{
+	  chainStats *one=&all[irank-1];
+	  one->Nparam=Nparam;
+	  one->Nsamples=allCounters[4*(irank-1)];
+	  one->batchSize=allCounters[4*(irank-1)+1];
+	  one->Ncurrent=allCounters[4*(irank-1)+2];
+	  one->Nbatches=(int)allCounters[4*(irank-1)+3];
+	  one->block=allSums+(size_t)(irank-1)*Nsums;
+	  one->shift=one->block;
+	  one->csum=one->shift+Nparam;
+	  one->csumsq=one->csum+Nparam;
+	  one->bsum=one->csumsq+Nparam;
+	  one->bsumsq=one->bsum+NBATCHMAX*Nparam;
+	}
+      stop=checkConvergence(Nstats,all,conv);
+      free(allCounters);
+      free(allSums);
+    }
+
+  MPI_Bcast(&stop,1,MPI_INT,0,MPI_COMM_WORLD);
+
+  return stop;
+}
+
+/*!
+\brief
+Runs one MCMC chain per rank of an MPI job
+
+\details
+Each of the ranks of MPI_COMM_WORLD runs a Metropolis chain of Nchain
+links, starting at Aparam[] with steps of width dev[], and records it
+in its own file, named after fname with "_rank" inserted before the
+extension (see chainFileName()); in the binary format, the files are
+independent shards that can be loaded together.
+
+If tempering is zero, the chains are independent samples of the
+posterior. Otherwise rank k has inverse temperature
+beta_k = Tmax^(-k/(Nranks-1)), as in multichain(), so that rank 0
+samples the posterior, and every Nswap links swaps are proposed
+between the even pairs of neighbouring ranks, then between the odd
+pairs at the next swap, and so on.
+
+The links after the first Nadapt feed the convergence diagnostics, as
+in multichain(), and every conv->Ncheck links (rounded to a multiple
+of Nswap for a ladder) all ranks stop if the stopping rule of conv is
+met. The links recorded by each rank follow record, as in walkers();
+main() gives a summary only to rank 0, which samples the posterior.
+With -DINSTRUMENT, the loop of each rank is timed and its acceptance
+ratio followed in windows of links (see instrument.h).
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is called from main() by all ranks, after MPI_Init()
+
+@param fname a string with the filename from which the chain filenames are derived
+
+@param format an int with the format of the files, CHAIN_TEXT or CHAIN_NPY
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
+@param Nchain an int with the length of each chain
+
+@param tempering an int; if nonzero, the chains form a tempering ladder
+
+@param Tmax a double with the highest temperature of the ladder
+
+@param Nswap an int with the number of links between swap proposals
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial values of the model parameters
+
+@param dev[] an array of doubles with the standard deviations of Gaussian steps for each model parameter
+
+@param proposal an int with the kind of steps, PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
+
+@param Nadapt an int with the number of links of burn-in over which PROPOSAL_ADAPTIVE chains adapt
+
+@param seed a uint32 with the seed of the random numbers, from which each chain gets its own stream
+
+@param record a pointer to the rule of the links recorded in the file and the summary, if any, of this rank
+
+@param conv a pointer to the stopping rule, and the diagnostics on return (on rank 0)
+
+@param data a pointer to the data set prepared by prepareData()
+
+@param swapRate a pointer to a double with the acceptance ratio of the swaps on return
+
+\return a double with the acceptance ratio of the chain of rank 0; also
+on return, on all ranks, the array Aparam[] will have the model
+parameters of the most likely model found by any of the chains.
+
+*/
+double mpichain(char fname[], int format, char *names[], int Nchain, int tempering, double Tmax, int Nswap, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *swapRate)
+{
+  chainState chain;
+  chainStats stats;
+  chainWriter chainfile;
+  char chainName[CHAINFNAMELENGTH];
+  mtState rngSwap;                     // random numbers for the swaps
+  int rank, Nranks, ichain, iparam, isync=0;
+  int status=0;
+  int checking=(conv->essTarget>0.0 && conv->Ncheck>0);
+  long swapCounts[2]={0,0};            // accepted and tried swaps of this rank
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&Nranks);
+
+  *swapRate=0.0;
+  if (Nswap<1)
+    Nswap=1;
+
+  int Nsync=(tempering) ? Nswap : conv->Ncheck;
+  int Ncheck=(checking) ? (conv->Ncheck+Nsync-1)/Nsync : 0;   // in stops
+  int Nstats=(tempering) ? 1 : Nranks;                        // chains in the diagnostics
+
+  double beta=1.0;
+  if (tempering && Nranks>1)
+    beta=pow(Tmax,-rank/(Nranks-1.0));
+
+  // each rank has its own stream; the swaps use the streams after those
+  uint32 chainSeed=streamSeedMT(seed,rank);
+  seedMT(&rngSwap,streamSeedMT(seed,Nranks+rank));
+
+  if (initChain(&chain,Nparam,Aparam,dev,beta,chainSeed,proposal,data)!=0)
+    status=ERROR_FILE;
+  else
+    {
+      chain.Nadapt=Nadapt;
+      if (initStats(&stats,Nparam)!=0)
+	{
+	  freeChain(&chain);
+	  status=ERROR_FILE;
+	}
+      else
+	{
+	  chainFileName(chainName,fname,rank);
+	  if (openChain(&chainfile,chainName,format,Nparam,0,recordedLinks(record,Nchain),names,chainSeed)!=0)
+	    {
+	      freeStats(&stats);
+	      freeChain(&chain);
+	      status=ERROR_FILE;
+	    }
+	}
+    }
+
+  // a rank that can not run its chain would leave the others waiting
+  MPI_Allreduce(MPI_IN_PLACE,&status,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+  if (status!=0)
+    {
+      if (rank==0)
+	printf("Error setting up the chains of the MPI ranks\n");
+      MPI_Abort(MPI_COMM_WORLD,ERROR_FILE);
+    }
+
+  double buffer[Nparam+2];             // position of the swap partner
+  INSTR_RUN_BEGIN();
+  for (ichain=1;ichain<=Nchain;ichain++)
+    {
+      // take a Metropolis step
+      chainStep(&chain);
+      INSTR_ACCEPT(ichain,Nchain,chain.accept);
+
+      // record the chain
+      recordLink(&chainfile,record,ichain,chain.Aparam);
+
+      if (ichain>chain.Nadapt)
+	addStats(&stats,chain.Aparam);
+
+      if ((tempering || checking) && ichain%Nsync==0)
+	{
+	  isync++;
+
+	  // even pairs of ranks at odd stops, odd pairs at even stops
+	  if (tempering && Nranks>1)
+	    {
+	      int partner=((rank+isync)%2==1) ? rank+1 : rank-1;
+	      if (partner>=0 && partner<Nranks)
+		{
+		  double betaPartner=pow(Tmax,-partner/(Nranks-1.0));
+		  int accept=swapRanks(&chain,partner,betaPartner,&rngSwap,buffer);
+		  // count each swap once, on the colder rank
+		  if (rank<partner)
+		    {
+		      swapCounts[0]+=accept;
+		      swapCounts[1]++;
+		    }
+		}
+	    }
+
+	  if (checking && isync%Ncheck==0 && (long)ichain>Nadapt &&
+	      checkRanks(&stats,Nstats,conv))
+	    {
+	      ichain++;
+	      break;
+	    }
+	}
+    }
+  long Ndone=ichain-1;
+
+  // the final diagnostics, the acceptance of rank 0 and the swap rate
+  checkRanks(&stats,Nstats,conv);
+  conv->Nlinks=Ndone;
+
+  double acceptance=chain.accept/(1.0*Ndone);
+  MPI_Bcast(&acceptance,1,MPI_DOUBLE,0,MPI_COMM_WORLD);
+
+  MPI_Allreduce(MPI_IN_PLACE,swapCounts,2,MPI_LONG,MPI_SUM,MPI_COMM_WORLD);
+  if (swapCounts[1]>0)
+    *swapRate=swapCounts[0]/(1.0*swapCounts[1]);
+
+  // return the most likely model of all chains
+  struct { double post; int rank; } best={chain.postMax,rank};
+  MPI_Allreduce(MPI_IN_PLACE,&best,1,MPI_DOUBLE_INT,MPI_MAXLOC,MPI_COMM_WORLD);
+  for (iparam=1;iparam<=Nparam;iparam++)
+    Aparam[iparam-1]=chain.AparamMax[iparam-1];
+  MPI_Bcast(Aparam,Nparam,MPI_DOUBLE,best.rank,MPI_COMM_WORLD);
+
+  closeChain(&chainfile);
+  INSTR_RUN_END();
+  freeStats(&stats);
+  freeChain(&chain);
+
+  return acceptance;
+}
+
+#endif
@@ -0,0 +1,494 @@
+/*! \file
+  \brief
+  File with subroutines to run several MCMC chains in parallel threads
+
+  \details
+  Each chain runs in its own thread with its own random number
+  generator, seeded from a separate stream (see streamSeedMT()), and
+  records its links in its own file. The chains are either independent
+  copies of the posterior or the rungs of a parallel-tempering ladder,
+  in which case the threads stop every Nswap links so that swaps of
+  the positions of neighbouring temperatures can be proposed. With a
+  stopping rule, the threads also stop regularly so that the
+  convergence of all the chains can be checked together.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
+
+#include "mcmc.h"
+#include "instrument.h"
+
+#define CHAINFNAMELENGTH 256       // max length of the per-chain filenames
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+A reusable barrier for a fixed number of threads
+
+\details
+Implemented with a mutex and a condition variable, since
+pthread_barrier_t is not available on all platforms.
+
+*/
+typedef struct
+{
+  pthread_mutex_t mutex;         //!< protects the counters
+  pthread_cond_t cond;           //!< signals the end of a cycle
+  int Nthreads;                  //!< number of threads that must arrive
+  int count;                     //!< number of threads that have arrived
+  unsigned long cycle;           //!< number of completed cycles
+} barrierState;
+
+/*!
+\brief
+The work of one thread: a chain and the file it is recorded in
+
+*/
+typedef struct
+{
+  chainState chain;              //!< the chain run by the thread
+  char fname[CHAINFNAMELENGTH];  //!< the file with the chain
+  chainWriter chainfile;         //!< the open file with the chain
+  chainStats stats;              //!< running sums of the diagnostics of the chain
+  int Nchain;                    //!< number of links to calculate
+  int Nsync;                     //!< number of links between stops at the barrier
+  barrierState *barrier;         //!< barrier for swaps and checks, or NULL for none
+  int *stop;                     //!< set at the barrier when all chains must stop
+  long Ndone;                    //!< number of links calculated, on return
+  int first;                     //!< 1 for the first chain, whose acceptance ratio is reported
+  chainRecord record;            //!< links recorded, with the summary only for the first chain
+} chainThread;
+
+static void initBarrier(barrierState *barrier, int Nthreads)
+{
+  pthread_mutex_init(&barrier->mutex,NULL);
+  pthread_cond_init(&barrier->cond,NULL);
+  barrier->Nthreads=Nthreads;
+  barrier->count=0;
+  barrier->cycle=0;
+}
+
+static void waitBarrier(barrierState *barrier)
+{
+  pthread_mutex_lock(&barrier->mutex);
+  unsigned long cycle=barrier->cycle;
+
+  if (++barrier->count==barrier->Nthreads)
+    {
+      // the last thread to arrive releases the others
+      barrier->count=0;
+      barrier->cycle++;
+      pthread_cond_broadcast(&barrier->cond);
+    }
+  else
+    {
+      while (cycle==barrier->cycle)
+	pthread_cond_wait(&barrier->cond,&barrier->mutex);
+    }
+  pthread_mutex_unlock(&barrier->mutex);
+}
+
+static void freeBarrier(barrierState *barrier)
+{
+  pthread_mutex_destroy(&barrier->mutex);
+  pthread_cond_destroy(&barrier->cond);
+}
+
+/*!
+\brief
+Constructs the filename for one of several chains
+
+\details
+Inserts "_ichain" before the extension of fname, e.g., chains.dat
+becomes chains_3.dat for ichain=3. The string out must have room for
+256 characters.
+
+\version 1.1
+
+\date Oct 14, 2026
+
+@param out a string of length CHAINFNAMELENGTH with the filename on return
+
+@param fname a string with the filename for all the chains
+
+@param ichain an int with the index of the chain
+
+*/
+void chainFileName(char out[], char fname[], int ichain)
+{
+  char *dot=strrchr(fname,'.');
+  int Nbase=(dot==NULL) ? (int)strlen(fname) : (int)(dot-fname);
+
+  snprintf(out,CHAINFNAMELENGTH,"%.*s_%d%s",Nbase,fname,ichain,(dot==NULL) ? "" : dot);
+}
+
+/*!
+\brief
+Runs the chain of one thread
+
+\details
+Advances the chain for Nchain links, passing each one to recordLink()
+and adding those after burn-in to the diagnostics. For a tempering ladder or a
+stopping rule, it waits at the barrier every Nsync links twice: once
+for all chains to arrive, and once for the swaps and the check of
+convergence to complete, after which it may have to stop.
+
+With -DINSTRUMENT, the loop is timed and, for the first chain, the
+acceptance ratio followed in windows of links (see instrument.h).
+
+\version 1.3
+
+\date Oct 14, 2026
+
+\pre It is started in a thread by multichain()
+
+@param arg a pointer to the chainThread with the work of the thread
+
+\return NULL
+
+*/
+static void *runChain(void *arg)
+{
+  chainThread *thread=(chainThread *)arg;
+  int ichain;
+
+  INSTR_RUN_BEGIN();
+  for (ichain=1;ichain<=thread->Nchain;ichain++)
+    {
+      // take a Metropolis step
+      chainStep(&thread->chain);
+#ifdef INSTRUMENT
+      if (thread->first)
+	INSTR_ACCEPT(ichain,thread->Nchain,thread->chain.accept);
+#endif
+
+      // record the chain
+      recordLink(&thread->chainfile,&thread->record,ichain,thread->chain.Aparam);
+
+      if (ichain>thread->chain.Nadapt)
+	addStats(&thread->stats,thread->chain.Aparam);
+
+      // let the swaps between temperatures and the checks take place
+      if (thread->barrier!=NULL && ichain%thread->Nsync==0)
+	{
+	  waitBarrier(thread->barrier);
+	  waitBarrier(thread->barrier);
+	  if (*thread->stop)
+	    {
+	      ichain++;
+	      break;
+	    }
+	}
+    }
+  thread->Ndone=ichain-1;
+  INSTR_RUN_END();
+
+  return NULL;
+}
+
+/*!
+\brief
+Proposes a swap between two neighbouring chains of a tempering ladder
+
+\details
+The positions of the chains are exchanged with probability
+min(1, exp[(beta1-beta2)(L2-L1)]), where L is the log likelihood at the
+current position of each chain. The tempered posteriors of both chains
+are updated accordingly, and the cached components of the model, if
+any, travel with the positions. Every proposal starts a new step of the
+generator of the swaps (see nextStepMT()).
+
+\version 1.2
+
+\date Oct 14, 2026
+
+\pre It is called from multichain() while all chain threads wait
+
+@param chain1 a pointer to the colder chain
+
+@param chain2 a pointer to the hotter chain
+
+@param rng a pointer to the random number generator for the swaps
+
+\return one if the swap was accepted, zero otherwise
+
+*/
+static int swapChains(chainState *chain1, chainState *chain2, mtState *rng)
+{
+  double lnratio=(chain1->beta-chain2->beta)*(chain2->likepre-chain1->likepre);
+  double *aux;
+
+  nextStepMT(rng);
+  if (lnratio<log(uniform(rng)))
+    return 0;
+
+  aux=chain1->Aparam;
+  chain1->Aparam=chain2->Aparam;
+  chain2->Aparam=aux;
+
+  modelCache *cacheAux=chain1->cache;
+  chain1->cache=chain2->cache;
+  chain2->cache=cacheAux;
+
+  double priorAux=chain1->priorpre;
+  chain1->priorpre=chain2->priorpre;
+  chain2->priorpre=priorAux;
+
+  double likeAux=chain1->likepre;
+  chain1->likepre=chain2->likepre;
+  chain2->likepre=likeAux;
+
+  chain1->probpre=chain1->priorpre+chain1->beta*chain1->likepre;
+  chain2->probpre=chain2->priorpre+chain2->beta*chain2->likepre;
+
+  return 1;
+}
+
+/*!
+\brief
+Runs several MCMC chains in parallel threads
+
+\details
+Runs Nchains Metropolis chains of Nchain links each, one per thread,
+all starting at Aparam[] with steps of width dev[]. Chain number k is
+recorded in its own file, named after fname with "_k" inserted before
+the extension (see chainFileName()).
+
+If tempering is zero, the chains are independent samples of the
+posterior that differ only in the stream of random numbers. Otherwise
+they form a parallel-tempering ladder with inverse temperatures
+beta_k = Tmax^(-k/(Nchains-1)), so that chain 0 samples the posterior
+and chain Nchains-1 the posterior at temperature Tmax. Every Nswap
+links, swaps between all neighbouring pairs of temperatures are
+proposed in turn. Adaptive chains learn their proposal
+independently, so that on a ladder each temperature keeps its own.
+
+The links after the first Nadapt feed the convergence diagnostics:
+the split R-hat is taken over all the independent chains, and the
+effective sample sizes are summed over them; for a ladder, only chain
+0 samples the posterior and only its links count. Every conv->Ncheck
+links (rounded to a multiple of Nswap for a ladder), all the chains
+stop if the stopping rule of conv is met.
+
+Every chain leaves out of its file the first record->Nburn links and
+thins the others by record->thin; only chain 0 (the posterior, on a
+ladder) feeds record->summary.
+
+\version 1.5
+
+\date Oct 14, 2026
+
+\pre It is called from main()
+
+@param fname a string with the filename from which the chain filenames are derived
+
+@param format an int with the format of the files, CHAIN_TEXT or CHAIN_NPY
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
+@param Nchain an int with the length of each chain
+
+@param Nchains an int with the number of chains
+
+@param tempering an int; if nonzero, the chains form a tempering ladder
+
+@param Tmax a double with the highest temperature of the ladder
+
+@param Nswap an int with the number of links between swap proposals
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial values of the model parameters
+
+@param dev[] an array of doubles with the standard deviations of Gaussian steps for each model parameter
+
+@param proposal an int with the kind of steps, PROPOSAL_FULL, PROPOSAL_BLOCK or PROPOSAL_ADAPTIVE
+
+@param Nadapt an int with the number of links of burn-in over which PROPOSAL_ADAPTIVE chains adapt
+
+@param seed a uint32 with the seed of the random numbers, from which each chain gets its own stream
+
+@param record a pointer to the rule of the links recorded in the files, and the summary of chain 0
+
+@param conv a pointer to the stopping rule, and the diagnostics on return
+
+@param data a pointer to the data set prepared by prepareData()
+
+@param swapRate a pointer to a double with the acceptance ratio of the swaps on return
+
+\return a double with the acceptance ratio of chain 0; also on return,
+the array Aparam[] will have the model parameters of the most likely
+model found by any of the chains.
+
+*/
+double multichain(char fname[], int format, char *names[], int Nchain, int Nchains, int tempering, double Tmax, int Nswap, int Nparam, double Aparam[], double dev[], int proposal, int Nadapt, uint32 seed, chainRecord *record, convergence *conv, dataset *data, double *swapRate)
+{
+  chainThread *threads=malloc(Nchains*sizeof(chainThread));
+  pthread_t *tid=malloc(Nchains*sizeof(pthread_t));
+  barrierState barrier;
+  mtState rngSwap;                     // random numbers for the swaps
+
+  int ichain, iparam, isync, Nstarted=0;
+  long swapAccept=0, swapTried=0;
+  int status=0, stop=0;
+  int checking=(conv->essTarget>0.0 && conv->Ncheck>0);
+
+  *swapRate=0.0;
+
+  if (threads==NULL || tid==NULL)
+    {
+      printf("Error allocating memory for %d chains\n",Nchains);
+      free(threads); free(tid);
+      return ERROR_FILE;
+    }
+
+  if (Nswap<1)
+    Nswap=1;
+
+  // how often the chains stop for swaps and checks of convergence
+  int Nsync=(tempering) ? Nswap : conv->Ncheck;
+  int Ncheck=(checking) ? (conv->Ncheck+Nsync-1)/Nsync : 0;   // in stops
+  int Nstats=(tempering) ? 1 : Nchains;                       // chains in the diagnostics
+  chainStats *stats=malloc(Nchains*sizeof(chainStats));
+  if (stats==NULL)
+    {
+      free(threads); free(tid);
+      return ERROR_FILE;
+    }
+
+  if (tempering || checking)
+    initBarrier(&barrier,Nchains+1);   // the chains plus this thread
+
+  seedMT(&rngSwap,streamSeedMT(seed,Nchains));
+
+  // set up each chain with its own temperature, stream and file
+  for (ichain=1;ichain<=Nchains;ichain++)
+    {
+      chainThread *thread=&threads[ichain-1];
+      double beta=1.0;
+
+      if (tempering && Nchains>1)
+	beta=pow(Tmax,-(ichain-1)/(Nchains-1.0));
+
+      uint32 chainSeed=streamSeedMT(seed,ichain-1);
+
+      if (initChain(&thread->chain,Nparam,Aparam,dev,beta,chainSeed,proposal,data)!=0)
+	{
+	  status=ERROR_FILE;
+	  break;
+	}
+      thread->chain.Nadapt=Nadapt;
+      if (initStats(&thread->stats,Nparam)!=0)
+	{
+	  freeChain(&thread->chain);
+	  status=ERROR_FILE;
+	  break;
+	}
+
+      chainFileName(thread->fname,fname,ichain-1);
+      if (openChain(&thread->chainfile,thread->fname,format,Nparam,0,recordedLinks(record,Nchain),names,chainSeed)!=0)
+	{
+	  freeStats(&thread->stats);
+	  freeChain(&thread->chain);
+	  status=ERROR_FILE;
+	  break;
+	}
+
+      thread->Nchain=Nchain;
+      thread->Nsync=Nsync;
+      thread->barrier=(tempering || checking) ? &barrier : NULL;
+      thread->stop=&stop;
+      thread->first=(ichain==1);
+      thread->record=*record;
+      if (ichain>1)
+	thread->record.summary=NULL;
+      Nstarted++;
+    }
+
+  // start the threads
+  if (status==0)
+    for (ichain=1;ichain<=Nchains;ichain++)
+      if (pthread_create(&tid[ichain-1],NULL,runChain,&threads[ichain-1])!=0)
+	{
+	  // without all the threads, the ladder can not proceed
+	  printf("Error starting thread for chain %d\n",ichain-1);
+	  exit(ERROR_FILE);
+	}
+
+  // propose the swaps between neighbouring temperatures and check convergence
+  if (status==0 && (tempering || checking))
+    for (isync=1;isync<=Nchain/Nsync;isync++)
+      {
+	waitBarrier(&barrier);         // all chains stopped
+	if (tempering)
+	  for (ichain=1;ichain<Nchains;ichain++)
+	    {
+	      swapAccept+=swapChains(&threads[ichain-1].chain,&threads[ichain].chain,&rngSwap);
+	      swapTried++;
+	    }
+	if (checking && isync%Ncheck==0 && (long)isync*Nsync>Nadapt)
+	  {
+	    for (ichain=1;ichain<=Nstats;ichain++)
+	      stats[ichain-1]=threads[ichain-1].stats;
+	    stop=checkConvergence(Nstats,stats,conv);
+	  }
+	waitBarrier(&barrier);         // let the chains continue, or stop
+	if (stop)
+	  break;
+      }
+
+  if (status==0)
+    for (ichain=1;ichain<=Nchains;ichain++)
+      pthread_join(tid[ichain-1],NULL);
+
+  // the final diagnostics
+  if (status==0)
+    {
+      for (ichain=1;ichain<=Nstats;ichain++)
+	stats[ichain-1]=threads[ichain-1].stats;
+      checkConvergence(Nstats,stats,conv);
+      conv->Nlinks=threads[0].Ndone;
+    }
+
+  double acceptance=(status==0) ? threads[0].chain.accept/(1.0*threads[0].Ndone) : ERROR_FILE;
+
+  if (status==0)
+    {
+      // return the most likely model of all chains
+      int ibest=0;
+      for (ichain=2;ichain<=Nchains;ichain++)
+	if (threads[ichain-1].chain.postMax>threads[ibest].chain.postMax)
+	  ibest=ichain-1;
+      for (iparam=1;iparam<=Nparam;iparam++)
+	Aparam[iparam-1]=threads[ibest].chain.AparamMax[iparam-1];
+
+      if (swapTried>0)
+	*swapRate=swapAccept/(1.0*swapTried);
+    }
+
+  for (ichain=1;ichain<=Nstarted;ichain++)
+    {
+      closeChain(&threads[ichain-1].chainfile);
+      freeStats(&threads[ichain-1].stats);
+      freeChain(&threads[ichain-1].chain);
+    }
+
+  if (tempering || checking)
+    freeBarrier(&barrier);
+  free(stats);
+  free(threads);
+  free(tid);
+
+  return acceptance;
+}
@@ -0,0 +1,349 @@
+/*! \file
+  \brief
+  File with subroutines to find the best fit before sampling
+
+  \details
+  A multi-start Nelder-Mead search for the maximum of the posterior
+  (see post()), run before the samplers so that their chains and
+  walkers start near the mode instead of climbing to it during the
+  burn-in. The first start is at the initial parameters of the run and
+  the others are scattered around them with Gaussian offsets of a
+  fraction of each parameter; the starts are shared by a pool of
+  threads, which take them in turn, and each one runs the simplex from
+  its start until the log posterior of its vertices agrees to OPTFTOL,
+  restarting the simplex at the best vertex to guard against a
+  collapsed simplex. The best fit of all the starts wins, the lowest
+  start on a tie, so that the result does not depend on the number of
+  threads.
+
+  The simplex needs no gradient, so that it works for every model and
+  for data with complex or closure terms.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
+
+#include "mcmc.h"
+
+#define OPTSTREAM -1               // stream of the random numbers of the starts, apart from those of the chains
+#define OPTFTOL 1.e-10             // relative spread of the log posterior over the simplex at convergence
+#define OPTRESTARTS 3              // largest number of restarts of the simplex after convergence
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+/*!
+\brief
+The starts of a search, shared by the threads that run them
+
+*/
+typedef struct
+{
+  int Nparam;                    //!< number of model parameters
+  int Nstarts;                   //!< number of starts
+  double scale;                  //!< size of the first simplex, as a fraction of each parameter
+  int Nmax;                      //!< evaluations of the posterior per start
+  dataset *data;                 //!< the data set
+  double *Xbest;                 //!< the start, then the best fit, of each start (Nstarts x Nparam)
+  double *fbest;                 //!< the log posterior of the best fit of each start
+  long *Neval;                   //!< evaluations of the posterior of each start
+  int *converged;                //!< 1 if the start converged within Nmax evaluations
+  int next;                      //!< next start to run
+  pthread_mutex_t mutex;         //!< protects next
+} optTask;
+
+// sets up the first simplex of a search at the point x[]
+static void initSimplex(int Nparam, double x[], double scale, double simplex[], double f[], dataset *data)
+{
+  int ivertex, iparam;
+
+  for (ivertex=1;ivertex<=Nparam+1;ivertex++)
+    {
+      double *vertex=simplex+(ivertex-1)*Nparam;
+
+      for (iparam=1;iparam<=Nparam;iparam++)
+	vertex[iparam-1]=x[iparam-1];
+      if (ivertex>1)
+	vertex[ivertex-2]+=(x[ivertex-2]!=0.0) ? scale*fabs(x[ivertex-2]) : scale;
+      f[ivertex-1]=-post(Nparam,vertex,data);
+    }
+}
+
+/*!
+\brief
+Runs the Nelder-Mead simplex from one start
+
+\details
+Minimizes -post() with the reflections, expansions, contractions and
+shrinks of Nelder & Mead (1965), with the usual coefficients 1, 2,
+1/2 and 1/2. The search converges when the spread of -post() over the
+vertices is at most OPTFTOL relative to its best value; it then
+restarts from a new simplex at the best vertex, up to OPTRESTARTS
+times, until a restart no longer improves the best value.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from runStarts()
+
+@param Nparam an int with the number of model parameters
+
+@param x[] an array of doubles with the start, and the best fit on return
+
+@param scale a double with the size of the first simplex, as a fraction of each parameter
+
+@param Nmax an int with the largest number of evaluations of the posterior
+
+@param data a pointer to the data set
+
+@param Neval a pointer to a long with the number of evaluations on return
+
+@param converged a pointer to an int, set to 1 if the search converged
+
+\return a double with the log posterior of the best fit
+
+*/
+static double nelderMead(int Nparam, double x[], double scale, int Nmax, dataset *data, long *Neval, int *converged)
+{
+  double simplex[(Nparam+1)*Nparam], f[Nparam+1];
+  double centroid[Nparam], xr[Nparam], xe[Nparam], xc[Nparam];
+  double fr, fe, fc, fprev=0.0;
+  int ivertex, iparam, irestart;
+  int best, worst, second;
+
+  *Neval=0;
+  *converged=0;
+
+  for (irestart=0;irestart<=OPTRESTARTS;irestart++)
+    {
+      initSimplex(Nparam,x,scale,simplex,f,data);
+      *Neval+=Nparam+1;
+
+      while (*Neval<Nmax)
+	{
+	  // the best, worst and second worst vertices
+	  best=0; worst=0;
+	  for (ivertex=1;ivertex<=Nparam;ivertex++)
+	    {
+	      if (f[ivertex]<f[best])
+		best=ivertex;
+	      if (f[ivertex]>f[worst])
+		worst=ivertex;
+	    }
+	  second=best;
+	  for (ivertex=0;ivertex<=Nparam;ivertex++)
+	    if (ivertex!=worst && f[ivertex]>f[second])
+	      second=ivertex;
+
+	  if (f[worst]-f[best]<=OPTFTOL*(1.0+fabs(f[best])))
+	    {
+	      *converged=1;
+	      break;
+	    }
+
+	  double *xw=simplex+worst*Nparam;
+	  for (iparam=1;iparam<=Nparam;iparam++)
+	    {
+	      centroid[iparam-1]=0.0;
+	      for (ivertex=0;ivertex<=Nparam;ivertex++)
+		if (ivertex!=worst)
+		  centroid[iparam-1]+=simplex[ivertex*Nparam+iparam-1];
+	      centroid[iparam-1]/=Nparam;
+	      xr[iparam-1]=2.0*centroid[iparam-1]-xw[iparam-1];
+	    }
+	  fr=-post(Nparam,xr,data);
+	  (*Neval)++;
+
+	  if (fr<f[best])
+	    {
+	      // expand past the reflection
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		xe[iparam-1]=3.0*centroid[iparam-1]-2.0*xw[iparam-1];
+	      fe=-post(Nparam,xe,data);
+	      (*Neval)++;
+	      memcpy(xw,(fe<fr) ? xe : xr,Nparam*sizeof(double));
+	      f[worst]=(fe<fr) ? fe : fr;
+	    }
+	  else if (fr<f[second])
+	    {
+	      memcpy(xw,xr,Nparam*sizeof(double));
+	      f[worst]=fr;
+	    }
+	  else
+	    {
+	      // contract on the side of the reflection or of the worst vertex
+	      int outside=(fr<f[worst]);
+	      for (iparam=1;iparam<=Nparam;iparam++)
+		xc[iparam-1]=0.5*(centroid[iparam-1]+((outside) ? xr[iparam-1] : xw[iparam-1]));
+	      fc=-post(Nparam,xc,data);
+	      (*Neval)++;
+	      if (fc<((outside) ? fr : f[worst]))
+		{
+		  memcpy(xw,xc,Nparam*sizeof(double));
+		  f[worst]=fc;
+		}
+	      else
+		{
+		  // shrink towards the best vertex
+		  double *xb=simplex+best*Nparam;
+		  for (ivertex=0;ivertex<=Nparam;ivertex++)
+		    if (ivertex!=best)
+		      {
+			for (iparam=1;iparam<=Nparam;iparam++)
+			  simplex[ivertex*Nparam+iparam-1]=0.5*(xb[iparam-1]+simplex[ivertex*Nparam+iparam-1]);
+			f[ivertex]=-post(Nparam,simplex+ivertex*Nparam,data);
+		      }
+		  *Neval+=Nparam;
+		}
+	    }
+	}
+
+      best=0;
+      for (ivertex=1;ivertex<=Nparam;ivertex++)
+	if (f[ivertex]<f[best])
+	  best=ivertex;
+      memcpy(x,simplex+best*Nparam,Nparam*sizeof(double));
+
+      // done once a restart no longer improves the fit
+      if (!*converged || (irestart>0 && fprev-f[best]<=OPTFTOL*(1.0+fabs(f[best]))))
+	break;
+      fprev=f[best];
+      if (irestart<OPTRESTARTS)
+	*converged=0;
+    }
+
+  return -f[best];
+}
+
+// the body of each thread of a search: runs starts until none are left
+static void *runStarts(void *arg)
+{
+  optTask *task=(optTask *)arg;
+  int istart;
+
+  for (;;)
+    {
+      pthread_mutex_lock(&task->mutex);
+      istart=++task->next;
+      pthread_mutex_unlock(&task->mutex);
+      if (istart>task->Nstarts)
+	break;
+
+      task->fbest[istart-1]=nelderMead(task->Nparam,task->Xbest+(istart-1)*task->Nparam,task->scale,task->Nmax,task->data,&task->Neval[istart-1],&task->converged[istart-1]);
+    }
+
+  return NULL;
+}
+
+/*!
+\brief
+Finds the best fit of the posterior with a multi-start Nelder-Mead search
+
+\details
+Runs opt->Nstarts searches (see nelderMead()) in opt->Nthreads
+threads: the first from Aparam[], the others from Aparam[] plus
+Gaussian offsets of opt->scale times each parameter, drawn from their
+own stream of seed (see streamSeedMT()). On return, Aparam[] holds the
+best fit of all the starts, and opt its log posterior, that of the
+initial parameters, and the evaluations of the posterior and the
+converged starts of the search.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main(), before the samplers
+
+@param Nparam an int with the number of model parameters
+
+@param Aparam[] an array of doubles with the initial parameters, and the best fit on return
+
+@param seed a uint32 with the seed of the random numbers of the run
+
+@param opt a pointer to the settings of the search, and its results on return
+
+@param data a pointer to the data set prepared by prepareData()
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int optimize(int Nparam, double Aparam[], uint32 seed, optimizer *opt, dataset *data)
+{
+  int Nstarts=(opt->Nstarts>0) ? opt->Nstarts : 1;
+  int Nthreads=(opt->Nthreads<1) ? 1 : ((opt->Nthreads>Nstarts) ? Nstarts : opt->Nthreads);
+  pthread_t *tid=malloc(Nthreads*sizeof(pthread_t));
+  optTask task;
+  mtState rng;
+  int istart, iparam, ithread, Nrunning=0, best=1;
+
+  task.Xbest=malloc((size_t)Nstarts*Nparam*sizeof(double));
+  task.fbest=malloc(Nstarts*sizeof(double));
+  task.Neval=malloc(Nstarts*sizeof(long));
+  task.converged=malloc(Nstarts*sizeof(int));
+  if (tid==NULL || task.Xbest==NULL || task.fbest==NULL || task.Neval==NULL || task.converged==NULL)
+    {
+      printf("Error allocating memory for %d starts of the optimizer\n",Nstarts);
+      free(tid); free(task.Xbest); free(task.fbest); free(task.Neval); free(task.converged);
+      return ERROR_FILE;
+    }
+
+  // the starts, drawn before any thread runs
+  seedMT(&rng,streamSeedMT(seed,OPTSTREAM));
+  for (istart=1;istart<=Nstarts;istart++)
+    for (iparam=1;iparam<=Nparam;iparam++)
+      {
+	double width=(Aparam[iparam-1]!=0.0) ? opt->scale*fabs(Aparam[iparam-1]) : opt->scale;
+	task.Xbest[(istart-1)*Nparam+iparam-1]=Aparam[iparam-1]+((istart>1) ? gauss(&rng,width) : 0.0);
+      }
+
+  task.Nparam=Nparam;
+  task.Nstarts=Nstarts;
+  task.scale=opt->scale;
+  task.Nmax=opt->Nmax;
+  task.data=data;
+  task.next=0;
+  pthread_mutex_init(&task.mutex,NULL);
+
+  opt->postInit=post(Nparam,Aparam,data);
+
+  // the calling thread runs the starts if no thread can be started
+  for (ithread=1;ithread<=Nthreads;ithread++)
+    {
+      if (pthread_create(&tid[ithread-1],NULL,runStarts,&task)!=0)
+	break;
+      Nrunning++;
+    }
+  if (Nrunning==0)
+    runStarts(&task);
+  for (ithread=1;ithread<=Nrunning;ithread++)
+    pthread_join(tid[ithread-1],NULL);
+  pthread_mutex_destroy(&task.mutex);
+
+  // the best fit of all the starts, in the order of the starts
+  opt->Neval=1;
+  opt->Nconverged=0;
+  for (istart=1;istart<=Nstarts;istart++)
+    {
+      opt->Neval+=task.Neval[istart-1];
+      opt->Nconverged+=task.converged[istart-1];
+      if (task.fbest[istart-1]>task.fbest[best-1])
+	best=istart;
+    }
+  opt->best=best;
+  opt->postMax=task.fbest[best-1];
+  memcpy(Aparam,task.Xbest+(best-1)*Nparam,Nparam*sizeof(double));
+  opt->Nthreads=Nthreads;
+
+  free(tid); free(task.Xbest); free(task.fbest); free(task.Neval); free(task.converged);
+
+  return 0;
+}
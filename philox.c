@@ -0,0 +1,239 @@
+/*! \file
+  \brief
+  The Philox4x32-10 counter-based random number generator
+
+  \details
+  Philox4x32-10 (Salmon, Moraes, Dror & Shaw 2011, "Parallel random
+  numbers: as easy as 1, 2, 3") turns a 128-bit counter and a 64-bit
+  key into four 32-bit random numbers with ten rounds of multiplications
+  and xors. There is no state other than the counter: the numbers at
+  any position of a stream can be calculated directly, without drawing
+  the ones before them.
+
+  The generator is an alternative backend of the mtState of a chain
+  (see setGeneratorMT()), so that randomMT(), fillMT() and everything
+  built on them (uniform(), gauss(), gaussFill()) draw from it
+  unchanged. Its key is the seed of the stream, as derived for each
+  chain by streamSeedMT(), and its counter is the pair (step, block):
+  the samplers start every link at a new step (see nextStepMT()), and
+  the numbers of a link are the blocks of four of that step, in order.
+  The numbers of link n of a chain are therefore a function of the seed
+  of the chain and of n alone, whatever the other links drew, so that any
+  link can be regenerated on its own (see seekPhilox()) and a checkpoint
+  only needs the counter.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "mcmc.h"
+
+#define PHILOX_M0 0xD2511F53U      // multipliers of the rounds
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U      // increments of the key between rounds
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10           // rounds of Philox4x32-10
+
+/*!
+\brief
+Calculates one block of four random numbers
+
+\details
+The ten rounds of Philox4x32 on the counter ctr[0..3] with the key
+key[0..1]. The result agrees with the known-answer tests of the
+reference implementation (Random123).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param key[] an array of two uint32 with the key
+
+@param ctr[] an array of four uint32 with the counter
+
+@param out[] an array of four uint32 with the random numbers on return
+
+*/
+void philox4x32(uint32 key[], uint32 ctr[], uint32 out[])
+{
+  uint32 k0=key[0], k1=key[1];
+  uint32 x0=ctr[0], x1=ctr[1], x2=ctr[2], x3=ctr[3];
+  int iround;
+
+  for (iround=1;iround<=PHILOX_ROUNDS;iround++)
+    {
+      unsigned long long p0=(unsigned long long)PHILOX_M0*x0;
+      unsigned long long p1=(unsigned long long)PHILOX_M1*x2;
+      uint32 y0=(uint32)(p1>>32)^x1^k0;
+      uint32 y2=(uint32)(p0>>32)^x3^k1;
+      x1=(uint32)p1;
+      x3=(uint32)p0;
+      x0=y0;
+      x2=y2;
+      k0+=PHILOX_W0;
+      k1+=PHILOX_W1;
+    }
+
+  out[0]=x0; out[1]=x1; out[2]=x2; out[3]=x3;
+}
+
+// calculates the next block of the current step into mt->out
+static void nextBlock(mtState *mt)
+{
+  uint32 ctr[4]={mt->block,0U,(uint32)mt->step,(uint32)(mt->step>>32)};
+
+  philox4x32(mt->key,ctr,mt->out);
+  mt->block++;
+  mt->nout=4;
+}
+
+/*!
+\brief
+Seeds a Philox stream
+
+\details
+Sets the key of the stream to (seed, 0) and its counter to the first
+block of step 0, and discards any normal deviate kept by gaussFill().
+The fields of the Mersenne Twister are left empty.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param mt a pointer to the generator
+
+@param seed a uint32 with the seed of the stream
+
+*/
+void seedPhilox(mtState *mt, uint32 seed)
+{
+  mt->philox=1;
+  mt->key[0]=seed;
+  mt->key[1]=0U;
+  mt->step=0;
+  mt->block=0;
+  mt->nout=0;
+  mt->next=mt->state;
+  mt->left=0;
+  mt->hasGauss=0;
+}
+
+/*!
+\brief
+Moves a Philox stream to a position
+
+\details
+Sets the counter of the stream to block "block" of step "step", with
+nout numbers of the block before it still to be drawn, which are
+recalculated from the counter. seekPhilox(mt,n,0,0) is the start of
+link n of a chain (see nextStepMT()); writeCheckpoint() saves these
+three numbers and readCheckpoint() restores them with this function.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The stream was seeded with seedPhilox(); nout is zero unless block is positive
+
+@param mt a pointer to the generator
+
+@param step an unsigned long long with the step
+
+@param block a uint32 with the next block of the step
+
+@param nout an int with the numbers of the previous block left to draw (0 to 4)
+
+*/
+void seekPhilox(mtState *mt, unsigned long long step, uint32 block, int nout)
+{
+  mt->step=step;
+  mt->block=block;
+  mt->nout=0;
+  if (nout>0 && block>0)
+    {
+      mt->block=block-1;
+      nextBlock(mt);
+      mt->nout=nout;
+    }
+  mt->hasGauss=0;
+}
+
+/*!
+\brief
+Returns the next random number of a Philox stream
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from randomMT()
+
+@param mt a pointer to the generator
+
+\return a uint32 uniformly distributed in 0..2^32-1
+
+*/
+uint32 randomPhilox(mtState *mt)
+{
+  if (mt->nout==0)
+    nextBlock(mt);
+
+  return mt->out[4-mt->nout--];
+}
+
+/*!
+\brief
+Block of uniform random numbers from a Philox stream
+
+\details
+Fills result[] with Nfill uniform deviates in (0,1), identical to
+those of Nfill successive calls to uniform(): the numbers left of the
+current block first, then whole blocks straight into result[], which
+the compiler can evaluate in SIMD lanes since they are independent.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from fillMT()
+
+@param mt a pointer to the generator
+
+@param Nfill an int with the number of deviates
+
+@param result[] an array of doubles with the deviates on return
+
+*/
+void fillPhilox(mtState *mt, int Nfill, double result[])
+{
+  const double scale=1.0/4294967296.0;
+  int index=0, iblock, j, Nblocks;
+
+  while (index<Nfill && mt->nout>0)
+    result[index++]=(mt->out[4-mt->nout--]+0.5)*scale;
+
+  Nblocks=(Nfill-index)/4;
+  for (iblock=1;iblock<=Nblocks;iblock++)
+    {
+      uint32 ctr[4]={mt->block+iblock-1,0U,(uint32)mt->step,(uint32)(mt->step>>32)};
+      uint32 out[4];
+      philox4x32(mt->key,ctr,out);
+      for (j=0;j<4;j++)
+	result[index+4*(iblock-1)+j]=(out[j]+0.5)*scale;
+    }
+  mt->block+=Nblocks;
+  index+=4*Nblocks;
+
+  while (index<Nfill)
+    {
+      if (mt->nout==0)
+	nextBlock(mt);
+      result[index++]=(mt->out[4-mt->nout--]+0.5)*scale;
+    }
+}
@@ -1,8 +1,19 @@
+import sys                            # imports library for arguments
 import numpy as np                    # imports library for math
 import matplotlib.pyplot as plt       # imports library for plots
 import csv                            # import csv reader
 
-samples=np.genfromtxt('chains.dat')
+Nparam=6                              # number of model parameters
+
+# chains file from the command line, chains.dat by default
+fname=sys.argv[1] if len(sys.argv)>1 else 'chains.dat'
+
+# binary chains are loaded directly, text chains are parsed;
+# the ensemble sampler adds a walker index as the last column
+if fname.endswith('.npy'):
+    samples=np.array(np.load(fname)[:,:Nparam])
+else:
+    samples=np.genfromtxt(fname)[:,:Nparam]
 
 # for all parameters
 for iparam in range(0,samples.shape[1]):
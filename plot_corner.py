@@ -1,11 +1,66 @@
 import corner
+import sys
 import numpy as np
 import matplotlib.pyplot as plt      
 
-chains=np.genfromtxt('chains.dat')
+Nparam=6                             # number of model parameters
+labels=[r"F$_1$",r"$\sigma_1$",r"x$_2$",r"y$_2$",r"F$_2$",r"$\sigma_2$"]
 
-fig1 = plt.clf()
-fig1 = corner.corner(chains, labels=[r"F$_1$",r"$\sigma_1$",r"x$_2$",r"y$_2$",r"F$_2$",r"$\sigma_2$"],
-                     show_titles=True,title_fmt='.3f', bins=25, color='blue')
+# chains file from the command line, chains.dat by default
+fname=sys.argv[1] if len(sys.argv)>1 else 'chains.dat'
+
+# reads the histograms of a summary written by the run (summaryfname,
+# see summary.c), which has a section after each line "# <name>"
+def readSummary(fname):
+    sections={}
+    name=None
+    for line in open(fname):
+        if line.startswith('#'):
+            name=line[1:].split()[0]
+            if name=='histogram2d':
+                name=tuple(int(i) for i in line.split()[2:4])
+            sections[name]=[]
+        elif name is not None:
+            sections[name].append([float(x) for x in line.split()])
+    return sections
+
+with open(fname,'rb') as file:
+    summary=file.read(15)==b'# mcmc summary'
+
+if summary:
+    # a corner plot of the histograms, without reloading the chain
+    sections=readSummary(fname)
+    ranges=np.array(sections['ranges'])
+    hist1=np.array(sections['histograms'])
+    Nbins=hist1.shape[1]
+    edges=[ranges[i,0]+ranges[i,1]*np.arange(Nbins+1) for i in range(Nparam)]
+    fig1,axes=plt.subplots(Nparam,Nparam,figsize=(2*Nparam,2*Nparam))
+    for i in range(Nparam):
+        for j in range(Nparam):
+            ax=axes[i,j]
+            if j>i:
+                ax.axis('off')
+            elif j==i:
+                ax.stairs(hist1[i],edges[i],color='blue')
+                ax.set_yticks([])
+            else:
+                hist2=np.array(sections[(j,i)])
+                ax.pcolormesh(edges[j],edges[i],hist2.T,cmap='Blues')
+            if i==Nparam-1:
+                ax.set_xlabel(labels[j])
+            if j==0 and i>0:
+                ax.set_ylabel(labels[i])
+    fig1.tight_layout()
+else:
+    # binary chains are memory-mapped, text chains are parsed;
+    # the ensemble sampler adds a walker index as the last column
+    if fname.endswith('.npy'):
+        chains=np.load(fname,mmap_mode='r')[:,:Nparam]
+    else:
+        chains=np.genfromtxt(fname)[:,:Nparam]
+
+    fig1 = plt.clf()
+    fig1 = corner.corner(chains, labels=labels,
+                         show_titles=True,title_fmt='.3f', bins=25, color='blue')
 
 fig1.savefig('cornerplot.pdf')
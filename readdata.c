@@ -1,98 +1,644 @@
-
 /*! \file
   \brief
   subroutine(s) to read data from files
 
   \details
-  this file contains a simple subroutine to read 
+  this file contains a simple subroutine to read
   the data to be fit from a file.
 
+  The ascii file is memory-mapped and parsed with a fast number
+  parser. Optionally, the parsed data are stored in a binary cache
+  file next to the data file (with the extension ".cache" appended),
+  which is reloaded directly as long as the size and modification time
+  of the data file have not changed.
+
+  The complex and closure terms of the data, if any, are read from a
+  separate, small ascii file of indices into the data points.
+
   \author D.P.
-  
+
   \date November 26, 2018
 
   \bugs No known bugs
-  
+
   \warning No known warnings
-  
+
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mcmc.h"
+
+#define ERROR_FILE 1                  // error code
+#define NPTSINIT 1024                 // initial room for data points
+#define NUMBERMAX 64                  // max length of a number for strtod()
+#define CACHEMAGIC "MCMCDAT1"         // identifies the binary cache files
+#define CACHEORDER 0x01020304U        // identifies the byte order of the cache
+
+/*!
+\brief
+The header of a binary cache file
+
+\details
+The header is followed by the Npts u-coordinates, then the Npts
+v-coordinates, visibility amplitudes and errors, as doubles in the
+byte order of the machine that wrote them.
+
+*/
+typedef struct
+{
+  char magic[8];                       //!< CACHEMAGIC
+  unsigned int order;                  //!< CACHEORDER, as written by the machine
+  int Npts;                            //!< number of data points
+  long long size;                      //!< size of the data file in bytes
+  long long mtime;                     //!< modification time of the data file
+} cacheHeader;
+
+// exact powers of ten for the fast path of parseNumber()
+static const double power10[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,
+			       1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,
+			       1e20,1e21,1e22};
+
+/*!
+\brief
+Parses a number from a buffer
+
+\details
+Skips white space starting at *pos and parses the decimal number that
+follows, without reading beyond end (the buffer is not NUL terminated).
+
+When the significant digits fit in 2^53 and the decimal exponent is
+at most 22 in magnitude, both are exact doubles and a single
+multiplication or division gives the correctly rounded result
+(Clinger's fast path). This covers the numbers in the data files,
+which have a few significant digits; all other numbers are handed over
+to strtod(), so the result is always correctly rounded.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from readData()
+
+@param pos a pointer to the position in the buffer, advanced past the number on return
+
+@param end a pointer to the end of the buffer
+
+@param value a pointer to a double with the number on return
+
+\return one if a number was parsed, zero at the end of the buffer or if there is no number
+
+*/
+static int parseNumber(const char **pos, const char *end, double *value)
+{
+  const char *ptr=*pos, *start;
+  unsigned long long mantissa=0;
+  int Ndigits=0, exponent=0, expdigits=0, negative=0, exact=1;
+
+  // skip white space
+  while (ptr<end && (*ptr==' ' || *ptr=='\t' || *ptr=='\n' || *ptr=='\r'))
+    ptr++;
+  if (ptr==end)
+    return 0;
+  start=ptr;
+
+  if (*ptr=='-' || *ptr=='+')
+    negative=(*ptr++=='-');
+
+  // integer and fractional digits
+  while (ptr<end && *ptr>='0' && *ptr<='9')
+    {
+      if (mantissa<100000000000000000ULL)
+	mantissa=10*mantissa+(*ptr-'0');
+      else
+	{
+	  exponent++;
+	  exact=exact && (*ptr=='0');
+	}
+      Ndigits++;
+      ptr++;
+    }
+  if (ptr<end && *ptr=='.')
+    {
+      ptr++;
+      while (ptr<end && *ptr>='0' && *ptr<='9')
+	{
+	  if (mantissa<100000000000000000ULL)
+	    {
+	      mantissa=10*mantissa+(*ptr-'0');
+	      exponent--;
+	    }
+	  else
+	    exact=exact && (*ptr=='0');
+	  Ndigits++;
+	  ptr++;
+	}
+    }
+  if (Ndigits==0)
+    exact=0;                           // e.g., nan or inf: let strtod() decide
+
+  // exponent
+  if (exact && ptr<end && (*ptr=='e' || *ptr=='E'))
+    {
+      int expnegative=0, expvalue=0;
+      ptr++;
+      if (ptr<end && (*ptr=='-' || *ptr=='+'))
+	expnegative=(*ptr++=='-');
+      while (ptr<end && *ptr>='0' && *ptr<='9')
+	{
+	  if (expvalue<10000)
+	    expvalue=10*expvalue+(*ptr-'0');
+	  expdigits++;
+	  ptr++;
+	}
+      if (expdigits==0)
+	exact=0;
+      exponent+=(expnegative) ? -expvalue : expvalue;
+    }
+
+  // the number must end at white space or at the end of the buffer
+  if (exact && ptr<end && !(*ptr==' ' || *ptr=='\t' || *ptr=='\n' || *ptr=='\r'))
+    exact=0;
+
+  if (exact && mantissa<=(1ULL<<53) && exponent>=-22 && exponent<=22)
+    {
+      double result=(double)mantissa;
+      result=(exponent<0) ? result/power10[-exponent] : result*power10[exponent];
+      *value=(negative) ? -result : result;
+      *pos=ptr;
+      return 1;
+    }
+
+  // slow path: copy the token and let strtod() parse it
+  {
+    char token[NUMBERMAX];
+    char *tokenEnd;
+    int Ntoken=0;
+
+    ptr=start;
+    while (ptr<end && Ntoken<NUMBERMAX-1 && !(*ptr==' ' || *ptr=='\t' || *ptr=='\n' || *ptr=='\r'))
+      token[Ntoken++]=*ptr++;
+    token[Ntoken]='\0';
+
+    *value=strtod(token,&tokenEnd);
+    if (tokenEnd==token || *tokenEnd!='\0')
+      return 0;
+    *pos=ptr;
+    return 1;
+  }
+}
+
+/*!
+\brief
+Reads the data from a binary cache file
+
+\details
+Reads the data points from the cache file cachename, if it exists and
+was written for a data file with the size and modification time in
+source.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from readData()
+
+@param cachename[] a string with the filename of the cache
+
+@param source a pointer to the status of the data file
+
+@param data a pointer to the data set to fill
+
+\return zero if the data were read, one otherwise
+
+*/
+static int readCache(char cachename[], struct stat *source, dataset *data)
+{
+  FILE *cache_file;
+  cacheHeader header;
+  int icol, result=0;
+
+  if ((cache_file=fopen(cachename,"rb"))==NULL)
+    return ERROR_FILE;
+
+  if (fread(&header,sizeof(header),1,cache_file)!=1 ||
+      memcmp(header.magic,CACHEMAGIC,8)!=0 || header.order!=CACHEORDER ||
+      header.size!=(long long)source->st_size || header.mtime!=(long long)source->st_mtime ||
+      header.Npts<0 || allocData(data,header.Npts)!=0)
+    {
+      fclose(cache_file);
+      return ERROR_FILE;
+    }
+
+  // the columns are stored one after the other
+  for (icol=1;icol<=4 && result==0;icol++)
+    {
+      double *column=(icol==1) ? data->uCo : (icol==2) ? data->vCo : (icol==3) ? data->Vis : data->Sigma;
+      if (fread(column,sizeof(double),header.Npts,cache_file)!=(size_t)header.Npts)
+	result=ERROR_FILE;
+    }
+  fclose(cache_file);
+
+  if (result!=0)
+    {
+      freeData(data);
+      return ERROR_FILE;
+    }
+  data->Npts=header.Npts;
+
+  return 0;
+}
 
 /*!
-\brief 
+\brief
+Writes the data to a binary cache file
+
+\details
+Writes the data points to a temporary file that is then renamed to
+cachename, so that an interrupted run never leaves a partial cache.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from readData()
+
+@param cachename[] a string with the filename of the cache
+
+@param source a pointer to the status of the data file
+
+@param data a pointer to the data set with the data points
+
+\return zero if the cache was written, one otherwise
+
+*/
+static int writeCache(char cachename[], struct stat *source, dataset *data)
+{
+  char tmpname[FILENAME_MAX];
+  FILE *cache_file;
+  cacheHeader header;
+  int icol, result=0;
+
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,CACHEMAGIC,8);
+  header.order=CACHEORDER;
+  header.Npts=data->Npts;
+  header.size=source->st_size;
+  header.mtime=source->st_mtime;
+
+  if (snprintf(tmpname,sizeof(tmpname),"%s.tmp",cachename)>=(int)sizeof(tmpname))
+    return ERROR_FILE;
+  if ((cache_file=fopen(tmpname,"wb"))==NULL)
+    {
+      printf("Error opening file %s for writing\n",tmpname);
+      return ERROR_FILE;
+    }
+
+  if (fwrite(&header,sizeof(header),1,cache_file)!=1)
+    result=ERROR_FILE;
+  for (icol=1;icol<=4 && result==0;icol++)
+    {
+      double *column=(icol==1) ? data->uCo : (icol==2) ? data->vCo : (icol==3) ? data->Vis : data->Sigma;
+      if (fwrite(column,sizeof(double),data->Npts,cache_file)!=(size_t)data->Npts)
+	result=ERROR_FILE;
+    }
+  if (fclose(cache_file)!=0)
+    result=ERROR_FILE;
+
+  if (result!=0 || rename(tmpname,cachename)!=0)
+    {
+      printf("Error writing cache file %s\n",cachename);
+      remove(tmpname);
+      return ERROR_FILE;
+    }
+
+  return 0;
+}
+
+/*!
+\brief
 Reads data from an ascii file
 
-\details 
+\details
 Reads data from an ascii file assumed to have only four columns.
 The first column is the u-distance, the second column is the v-distance,
-the third column is the visibility amplitude, and the fourth is the 
-error.
+the third column is the visibility amplitude, and the fourth is the
+error. Lines starting with '#' are comments.
 
-At exit, Npts carries the number of data points that were read, U[],
-V[], Vis[], and Sigma[] are 1D arrays with the u-coordinates,
-v-coordinates, visibility amplitudes, and errors.
+The file is memory-mapped (or read in one go, where mapping is not
+possible) and the numbers are parsed as doubles with parseNumber().
+Reading stops at the first entry that is not a number. The storage of
+the data set grows (doubling its size) as the data points are read, so
+there is no limit to their number.
+
+If cache is nonzero, the data are loaded from the binary cache file
+filename.cache when it matches the size and modification time of the
+file, and the cache is (re)written after parsing otherwise.
+
+At exit, the data set holds the number of data points that were
+read, their u-coordinates, v-coordinates, visibility amplitudes, and
+errors, and the quantities precomputed for the likelihood kernel (see
+precomputeData()).
 
 \author Dimitrios Psaltis
 
-\version 1.0
+\version 1.5
 
-\date Nov 26, 2018
+\date Oct 14, 2026
 
 \pre It is called from main()
 
 @param filename[] a string with the filename that contains the data
 
-@param *Npts an int with the number of data points read
+@param data a pointer to the data set to fill
 
-@param U[] an array of doubles with the u-coordinates of the data
+@param cache an int; if nonzero, use and update the binary cache of the data
 
-@param V[] an array of doubles with the v-coordinates of the data
+\return zero if all was OK, one if there as a problem
+
+*/
+int readData(char filename[], dataset *data, int cache)
+{
+  char cachename[FILENAME_MAX];        // filename of the binary cache
+  struct stat source;                  // status of the data file
+  char *buffer;                        // contents of the data file
+  const char *pos, *end;               // position in the contents
+  int mapped=1;                        // buffer is memory-mapped
+  int fd;
+
+  data->block=NULL;
+  data->Npts=data->Npad=data->Nmax=0;
+  data->model=findModel(DEFAULT_MODEL);
+  data->Nterms=data->Nvis=data->Ncphase=data->Nlcamp=0;
+  data->termIndex=NULL;
+  data->termBlock=NULL;
+  data->chi2Offset=0.0;
+  data->earlyExit=0;
+  data->precision=PRECISION_DOUBLE;
+  data->blockf=NULL;
+  data->check=NULL;
+  data->pool=NULL;
+  data->gpu=NULL;
+
+  if ((fd=open(filename,O_RDONLY))<0 || fstat(fd,&source)!=0)
+    {
+      printf("Error opening file %s for reading",filename);
+      if (fd>=0)
+	close(fd);
+      return ERROR_FILE;
+    }
 
-@param Vis[] an array of the visibility amplitudes
+  snprintf(cachename,sizeof(cachename),"%s.cache",filename);
+  if (cache && readCache(cachename,&source,data)==0)
+    {
+      close(fd);
+      precomputeData(data);
+      return 0;
+    }
 
-@param Sigma[] an array of the errors
+  // map the file, or read it if it can not be mapped
+  buffer=(source.st_size>0) ? mmap(NULL,source.st_size,PROT_READ,MAP_PRIVATE,fd,0) : MAP_FAILED;
+  if (buffer==MAP_FAILED)
+    {
+      mapped=0;
+      buffer=malloc(source.st_size+1);
+      if (buffer==NULL || (source.st_size>0 && read(fd,buffer,source.st_size)!=source.st_size))
+	{
+	  printf("Error reading file %s\n",filename);
+	  free(buffer);
+	  close(fd);
+	  return ERROR_FILE;
+	}
+    }
+  else
+    madvise(buffer,source.st_size,MADV_SEQUENTIAL);
+  close(fd);
+
+  if (allocData(data,NPTSINIT)!=0)
+    {
+      if (mapped) munmap(buffer,source.st_size); else free(buffer);
+      return ERROR_FILE;
+    }
+
+  pos=buffer;
+  end=buffer+source.st_size;
+  while (1)
+    {
+      double read[4];                  // aux variables for file reading
+      int icol;
+
+      // skip comment lines
+      while (pos<end && (*pos==' ' || *pos=='\t' || *pos=='\n' || *pos=='\r'))
+	pos++;
+      if (pos<end && *pos=='#')
+	{
+	  while (pos<end && *pos!='\n')
+	    pos++;
+	  continue;
+	}
+
+      for (icol=0;icol<4;icol++)
+	if (parseNumber(&pos,end,&read[icol])==0)
+	  break;
+      if (icol<4)
+	break;
+
+      // make room for more data points
+      if (data->Npts==data->Nmax && allocData(data,2*data->Nmax)!=0)
+	{
+	  if (mapped) munmap(buffer,source.st_size); else free(buffer);
+	  freeData(data);
+	  return ERROR_FILE;
+	}
+      data->uCo[data->Npts]=read[0];       // first column is u coordinate
+      data->vCo[data->Npts]=read[1];       // second column is v coordinate
+      data->Vis[data->Npts]=read[2];       // third column is Vis amplitude
+      data->Sigma[data->Npts]=read[3];     // fourth column is error
+      data->Npts=data->Npts+1;
+    }
+
+  if (mapped)
+    munmap(buffer,source.st_size);
+  else
+    free(buffer);
+
+  if (cache)
+    writeCache(cachename,&source,data);
+
+  // precompute the per-point quantities used by the likelihood kernel
+  precomputeData(data);
+
+  return 0;                              // all is good
+
+}
+
+/*!
+\brief
+Reads the complex and closure terms of a data set from an ascii file
+
+\details
+Reads an index table of terms over the data points read by readData(),
+one term per line, with the data points numbered from 1 in the order
+of the data file. Lines starting with '#' are comments. The terms are
+
+- "V k phase": the complex visibility of point k, with the amplitude
+  of the point, the given phase (in degrees) and the error of the point
+  in each of its real and imaginary parts; the amplitude of the point
+  is then no longer fit on its own,
+
+- "P i j k phase sigma": the closure phase (in degrees) over the
+  triangle of points i, j and k, with a negative index for a baseline
+  taken in the opposite direction (the conjugate visibility),
+
+- "A i j k l lnA sigma": the log closure amplitude
+  ln(|V_i||V_j|/(|V_k||V_l|)) over the quadrangle of points i to l.
+
+The table is read in a first pass to count the terms, which are
+then stored in the storage of the data set in a second pass.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main() after readData()
+
+@param filename[] a string with the filename that contains the terms
+
+@param data a pointer to the data set, read by readData()
 
 \return zero if all was OK, one if there as a problem
 
 */
-int readData(char filename[], int *Npts, double U[], double V[], double Vis[], double Sigma[])
+int readClosures(char filename[], dataset *data)
 {
-#define ERROR_FILE 1                  // error code 
-  
-  FILE *data_file;                     // pointer for file to be read
-  float read1, read2, read3,read4;     // aux variables for file reading   
-  int result; 
-  
-  if ((data_file=fopen(filename,"r"))==NULL)
+  char line[256];                      // a line of the file
+  int count[3]={0,0,0};                // terms of each kind
+  int ipass, Nline;
+  FILE *term_file;
+
+  if ((term_file=fopen(filename,"r"))==NULL)
     {
-      printf("Error opening file %s for reading",filename);
+      printf("Error opening file %s for reading\n",filename);
       return ERROR_FILE;
     }
-  
-  *Npts=0;
-  do
+
+  free(data->termIndex);
+  free(data->termBlock);
+  data->termIndex=NULL;
+  data->termBlock=NULL;
+
+  for (ipass=1;ipass<=2;ipass++)
     {
-      result=fscanf(data_file,"%e %e %e %e",&read1,&read2,&read3,&read4);
-      if (result>0)
+      int Nvis=0, Ncphase=0, Nlcamp=0;
+
+      if (ipass==2)
+	{
+	  data->Nvis=count[0];
+	  data->Ncphase=count[1];
+	  data->Nlcamp=count[2];
+	  data->Nterms=count[0]+count[1]+count[2];
+	  data->termIndex=malloc((count[0]+3*count[1]+4*count[2]+1)*sizeof(int));
+	  data->termBlock=malloc((2*count[0]+3*count[1]+2*count[2]+1)*sizeof(double));
+	  if (data->termIndex==NULL || data->termBlock==NULL)
+	    {
+	      printf("Error allocating memory for the terms in %s\n",filename);
+	      break;
+	    }
+	  data->visIndex=data->termIndex;
+	  data->cphaseIndex=data->visIndex+count[0];
+	  data->lcampIndex=data->cphaseIndex+3*count[1];
+	  data->visRe=data->termBlock;
+	  data->visIm=data->visRe+count[0];
+	  data->cphaseCos=data->visIm+count[0];
+	  data->cphaseSin=data->cphaseCos+count[1];
+	  data->cphaseInvVar=data->cphaseSin+count[1];
+	  data->lcamp=data->cphaseInvVar+count[1];
+	  data->lcampInvVar=data->lcamp+count[2];
+	  rewind(term_file);
+	}
+
+      Nline=0;
+      while (fgets(line,sizeof(line),term_file)!=NULL)
 	{
-	  U[*Npts]=read1;                   // first column is u coordinate
-	  V[*Npts]=read2;                   // second column is v coordinate
-	  Vis[*Npts]=read3;                 // third column is Vis amplitude
-	  Sigma[*Npts]=read4;               // fourth column is error
-	  *Npts=*Npts+1;
+	  int ipt[4], Nread;
+	  double value, sigma;
+	  char kind;
+
+	  Nline++;
+	  if (sscanf(line," %c",&kind)!=1 || kind=='#')
+	    continue;
+
+	  if (kind=='V' && sscanf(line," V %d %lf",&ipt[0],&value)==2 &&
+	      ipt[0]>=1 && ipt[0]<=data->Npts)
+	    {
+	      if (ipass==2)
+		{
+		  data->visIndex[Nvis]=ipt[0];
+		  data->visRe[Nvis]=data->Vis[ipt[0]-1]*cos(value*M_PI/180.);
+		  data->visIm[Nvis]=data->Vis[ipt[0]-1]*sin(value*M_PI/180.);
+		  // the amplitude is part of the complex visibility
+		  data->invVar[ipt[0]-1]=0.0;
+		}
+	      Nvis++;
+	    }
+	  else if (kind=='P' && sscanf(line," P %d %d %d %lf %lf",&ipt[0],&ipt[1],&ipt[2],&value,&sigma)==5 &&
+		   ipt[0]!=0 && abs(ipt[0])<=data->Npts && ipt[1]!=0 && abs(ipt[1])<=data->Npts &&
+		   ipt[2]!=0 && abs(ipt[2])<=data->Npts && sigma>0.0)
+	    {
+	      if (ipass==2)
+		{
+		  for (Nread=1;Nread<=3;Nread++)
+		    data->cphaseIndex[3*Ncphase+Nread-1]=ipt[Nread-1];
+		  data->cphaseCos[Ncphase]=cos(value*M_PI/180.);
+		  data->cphaseSin[Ncphase]=sin(value*M_PI/180.);
+		  data->cphaseInvVar[Ncphase]=1./(sigma*M_PI/180.*sigma*M_PI/180.);
+		}
+	      Ncphase++;
+	    }
+	  else if (kind=='A' && sscanf(line," A %d %d %d %d %lf %lf",&ipt[0],&ipt[1],&ipt[2],&ipt[3],&value,&sigma)==6 &&
+		   ipt[0]>=1 && ipt[0]<=data->Npts && ipt[1]>=1 && ipt[1]<=data->Npts &&
+		   ipt[2]>=1 && ipt[2]<=data->Npts && ipt[3]>=1 && ipt[3]<=data->Npts && sigma>0.0)
+	    {
+	      if (ipass==2)
+		{
+		  for (Nread=1;Nread<=4;Nread++)
+		    data->lcampIndex[4*Nlcamp+Nread-1]=ipt[Nread-1];
+		  data->lcamp[Nlcamp]=value;
+		  data->lcampInvVar[Nlcamp]=1./(sigma*sigma);
+		}
+	      Nlcamp++;
+	    }
+	  else
+	    {
+	      printf("Error in line %d of file %s\n",Nline,filename);
+	      break;
+	    }
 	}
+      if (!feof(term_file))
+	break;
+
+      count[0]=Nvis;
+      count[1]=Ncphase;
+      count[2]=Nlcamp;
     }
-  while (result>0);
+  fclose(term_file);
 
-  if (fclose(data_file)!=0)
+  if (ipass<=2)
     {
-      printf("Error in closing input file %s\n",filename);
+      free(data->termIndex);
+      free(data->termBlock);
+      data->termIndex=NULL;
+      data->termBlock=NULL;
+      data->Nterms=data->Nvis=data->Ncphase=data->Nlcamp=0;
       return ERROR_FILE;
     }
 
   return 0;                              // all is good
-  
 }
-
@@ -0,0 +1,359 @@
+/*! \file
+  \brief
+  The SIMD lanes of the likelihood kernels
+
+  \details
+  Defines the vector type vdouble of VLEN doubles and the operations on
+  it used by the kernels in likelihood.c and models.c. The lane width is
+  chosen at compile time from the instruction set the compiler targets:
+  8 doubles for AVX-512, 4 doubles for AVX2 and a scalar fallback
+  otherwise.
+
+  The single-precision kernels use the vector type vfloat of VLENF
+  floats, the same register width and so twice the lanes. vfwiden(x)
+  adds the two halves of a vfloat into a vdouble, so that these kernels
+  can sum their terms in double precision.
+
+  When the code is linked against the glibc vector math library
+  (HAVE_LIBMVEC, detected by the Makefile) the exponentials and the
+  trigonometric functions are evaluated lane-wise by the library; without
+  it, and for the functions the library does not have, they are
+  evaluated one lane at a time with the standard libm calls (vlanes()).
+
+  With VMATH (make VMATH=fast or VMATH=full), the exponential, the sine
+  and the cosine are instead inline polynomials in the lanes, after a
+  range reduction with the bits of the lanes as integers, to a relative
+  error of about 1e-12 (VMATH=12) or a few units in the last place
+  (VMATH=16), and about 1e-7 in single precision. vsincos(x,s,c) gives
+  the sine and the cosine of the same lanes with one range reduction;
+  without VMATH it calls the two functions. See the "accuracy" section
+  of bench.c for their errors against libm.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning No known warnings
+
+*/
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <math.h>
+
+#include "mcmc.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+
+#define VLEN 8                     // number of doubles per SIMD lane
+typedef __m512d vdouble;
+#define vset(x)      _mm512_set1_pd(x)
+#define vload(p)     _mm512_load_pd(p)
+#define vstore(p,x)  _mm512_store_pd(p,x)
+#define vsqrt(x)     _mm512_sqrt_pd(x)
+#if defined(HAVE_LIBMVEC) && !defined(VMATH)
+extern __m512d _ZGVeN8v_exp(__m512d x);
+extern __m512d _ZGVeN8v_cos(__m512d x);
+extern __m512d _ZGVeN8v_sin(__m512d x);
+#define vexp(x)      _ZGVeN8v_exp(x)
+#define vcos(x)      _ZGVeN8v_cos(x)
+#define vsin(x)      _ZGVeN8v_sin(x)
+#endif
+
+#define VLENF 16                   // number of floats per SIMD lane
+typedef __m512 vfloat;
+#define vfset(x)     _mm512_set1_ps(x)
+#define vfload(p)    _mm512_load_ps(p)
+#define vfstore(p,x) _mm512_store_ps(p,x)
+#define vfsqrt(x)    _mm512_sqrt_ps(x)
+#define vfwiden(x)   (_mm512_cvtps_pd(_mm512_castps512_ps256(x))+_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(x),1))))
+#if defined(HAVE_LIBMVEC) && !defined(VMATH)
+extern __m512 _ZGVeN16v_expf(__m512 x);
+extern __m512 _ZGVeN16v_cosf(__m512 x);
+extern __m512 _ZGVeN16v_sinf(__m512 x);
+#define vfexp(x)     _ZGVeN16v_expf(x)
+#define vfcos(x)     _ZGVeN16v_cosf(x)
+#define vfsin(x)     _ZGVeN16v_sinf(x)
+#endif
+
+#elif defined(__AVX2__)
+
+#define VLEN 4
+typedef __m256d vdouble;
+#define vset(x)      _mm256_set1_pd(x)
+#define vload(p)     _mm256_load_pd(p)
+#define vstore(p,x)  _mm256_store_pd(p,x)
+#define vsqrt(x)     _mm256_sqrt_pd(x)
+#if defined(HAVE_LIBMVEC) && !defined(VMATH)
+extern __m256d _ZGVdN4v_exp(__m256d x);
+extern __m256d _ZGVdN4v_cos(__m256d x);
+extern __m256d _ZGVdN4v_sin(__m256d x);
+#define vexp(x)      _ZGVdN4v_exp(x)
+#define vcos(x)      _ZGVdN4v_cos(x)
+#define vsin(x)      _ZGVdN4v_sin(x)
+#endif
+
+#define VLENF 8
+typedef __m256 vfloat;
+#define vfset(x)     _mm256_set1_ps(x)
+#define vfload(p)    _mm256_load_ps(p)
+#define vfstore(p,x) _mm256_store_ps(p,x)
+#define vfsqrt(x)    _mm256_sqrt_ps(x)
+#define vfwiden(x)   (_mm256_cvtps_pd(_mm256_castps256_ps128(x))+_mm256_cvtps_pd(_mm256_extractf128_ps(x,1)))
+#if defined(HAVE_LIBMVEC) && !defined(VMATH)
+extern __m256 _ZGVdN8v_expf(__m256 x);
+extern __m256 _ZGVdN8v_cosf(__m256 x);
+extern __m256 _ZGVdN8v_sinf(__m256 x);
+#define vfexp(x)     _ZGVdN8v_expf(x)
+#define vfcos(x)     _ZGVdN8v_cosf(x)
+#define vfsin(x)     _ZGVdN8v_sinf(x)
+#endif
+
+#else
+
+#define VLEN 1
+typedef double vdouble;
+#define vset(x)      (x)
+#define vload(p)     (*(p))
+#define vstore(p,x)  (*(p)=(x))
+#define vsqrt(x)     sqrt(x)
+#ifndef VMATH
+#define vexp(x)      exp(x)
+#define vcos(x)      cos(x)
+#define vsin(x)      sin(x)
+#endif
+
+#define VLENF 1
+typedef float vfloat;
+#define vfset(x)     ((float)(x))
+#define vfload(p)    (*(p))
+#define vfstore(p,x) (*(p)=(x))
+#define vfsqrt(x)    sqrtf(x)
+#define vfwiden(x)   ((double)(x))
+#ifndef VMATH
+#define vfexp(x)     expf(x)
+#define vfcos(x)     cosf(x)
+#define vfsin(x)     sinf(x)
+#endif
+
+#endif
+
+#ifdef VMATH
+// the polynomial exponential and sine/cosine of the lanes (make VMATH=fast or
+// VMATH=full), in place of the vector math library
+
+#if VLEN>1
+typedef long long vint64 __attribute__((vector_size(sizeof(vdouble))));
+typedef int vint32 __attribute__((vector_size(sizeof(vfloat))));
+#define vasint(x)    ((vint64)(x))          // the bits of the lanes
+#define vasdouble(i) ((vdouble)(i))
+#define vfasint(x)   ((vint32)(x))
+#define vfasfloat(i) ((vfloat)(i))
+#define vless(a,b)   ((a)<(b))              // -1 in the lanes where a<b, 0 elsewhere
+#else
+typedef long long vint64;
+typedef int vint32;
+static inline vint64 vasint(double x) { union {double d; long long i;} u; u.d=x; return u.i; }
+static inline double vasdouble(vint64 i) { union {double d; long long i;} u; u.i=i; return u.d; }
+static inline vint32 vfasint(float x) { union {float f; int i;} u; u.f=x; return u.i; }
+static inline float vfasfloat(vint32 i) { union {float f; int i;} u; u.i=i; return u.f; }
+#define vless(a,b)   (-((a)<(b)))
+#endif
+#define vselect(m,a,b)  vasdouble((vasint(a)&(m))|(vasint(b)&~(m)))    // a where m is -1, b elsewhere
+#define vfselect(m,a,b) vfasfloat((vfasint(a)&(m))|(vfasint(b)&~(m)))
+
+// Taylor coefficients 1/k! of the exponential and (-1)^k/(2k+1)! and
+// (-1)^k/(2k)! of the sine and the cosine, to the degrees that reach a
+// relative error of about 1e-12 (VMATH=12) or of a few units in the last
+// place (VMATH=16) on the reduced arguments, and 1e-7 in single precision
+#if VMATH>=16
+#define VMATH_NEXP 13
+#define VMATH_NSIN 7
+#define VMATH_NCOS 8
+#else
+#define VMATH_NEXP 10
+#define VMATH_NSIN 6
+#define VMATH_NCOS 6
+#endif
+#define VMATH_NEXPF 7
+#define VMATH_NSINF 4
+#define VMATH_NCOSF 5
+
+static const double vmExpCoef[14]={1.,1.,1./2,1./6,1./24,1./120,1./720,1./5040,1./40320,1./362880,
+				   1./3628800,1./39916800,1./479001600,1./6227020800.};
+static const double vmSinCoef[8]={1.,-1./6,1./120,-1./5040,1./362880,-1./39916800,1./6227020800.,-1./1307674368000.};
+static const double vmCosCoef[9]={1.,-1./2,1./24,-1./720,1./40320,-1./3628800,1./479001600,-1./87178291200.,1./20922789888000.};
+
+// exp(x) = 2^n exp(r), with n the nearest integer to x/ln2 and |r| <= ln2/2;
+// the result is 0 below -708
+static inline vdouble vmexp(vdouble x)
+{
+  const vdouble shift=vset(0x1.8p52);       // rounds to an integer in the low bits
+  vint64 under=vless(x,vset(-708.0));
+  vdouble p;
+  int k;
+
+  x=vselect(vless(vset(709.0),x),vset(709.0),x);
+  vdouble t=x*vset(M_LOG2E)+shift;
+  vdouble n=t-shift;
+  vdouble r=x-n*vset(6.93147180369123816490e-01)-n*vset(1.90821492927058770002e-10);
+
+  p=vset(vmExpCoef[VMATH_NEXP]);
+#pragma GCC unroll 16
+  for (k=VMATH_NEXP-1;k>=0;k--)
+    p=p*r+vset(vmExpCoef[k]);
+
+  p*=vasdouble((vasint(t)<<52)+0x3ff0000000000000LL);
+  return vselect(under,vset(0.0),p);
+}
+
+// sin(x) and cos(x) with one reduction: x = q pi/2 + r, |r| <= pi/4, with
+// the three-part split of pi/2 of fdlibm, whose first two parts have 33
+// bits, so that their products with q are exact for |q| < 2^20, then the
+// quadrant q mod 4 swaps and changes the signs of sin(r) and cos(r)
+static inline void vmsincos(vdouble x, vdouble *s, vdouble *c)
+{
+  const vdouble shift=vset(0x1.8p52);
+  vdouble ps, pc;
+  int k;
+
+  vdouble t=x*vset(M_2_PI)+shift;
+  vdouble q=t-shift;
+  vdouble r=x-q*vset(1.57079632673412561417e+00);
+  r=r-q*vset(6.07710050630396597660e-11);
+  r=r-q*vset(2.02226624871116645580e-21);
+  vdouble r2=r*r;
+
+  ps=vset(vmSinCoef[VMATH_NSIN]);
+#pragma GCC unroll 16
+  for (k=VMATH_NSIN-1;k>=1;k--)
+    ps=ps*r2+vset(vmSinCoef[k]);
+  ps=r+r*r2*ps;
+  pc=vset(vmCosCoef[VMATH_NCOS]);
+#pragma GCC unroll 16
+  for (k=VMATH_NCOS-1;k>=0;k--)
+    pc=pc*r2+vset(vmCosCoef[k]);
+
+  vint64 quad=vasint(t);
+  vint64 swap=-(quad&1);
+  *s=vasdouble(vasint(vselect(swap,pc,ps))^((quad&2)<<62));
+  *c=vasdouble(vasint(vselect(swap,ps,pc))^(((quad+1)&2)<<62));
+}
+
+static inline vdouble vmsin(vdouble x) { vdouble s, c; vmsincos(x,&s,&c); return s; }
+static inline vdouble vmcos(vdouble x) { vdouble s, c; vmsincos(x,&s,&c); return c; }
+
+// the same in single precision; the result is 0 below -87
+static inline vfloat vmexpf(vfloat x)
+{
+  const vfloat shift=vfset(0x1.8p23f);
+  vint32 under=vless(x,vfset(-87.0f));
+  vfloat p;
+  int k;
+
+  x=vfselect(vless(vfset(88.0f),x),vfset(88.0f),x);
+  vfloat t=x*vfset((float)M_LOG2E)+shift;
+  vfloat n=t-shift;
+  vfloat r=x-n*vfset(0.693359375f)-n*vfset(-2.12194440e-4f);
+
+  p=vfset((float)vmExpCoef[VMATH_NEXPF]);
+#pragma GCC unroll 16
+  for (k=VMATH_NEXPF-1;k>=0;k--)
+    p=p*r+vfset((float)vmExpCoef[k]);
+
+  p*=vfasfloat((vfasint(t)<<23)+0x3f800000);
+  return vfselect(under,vfset(0.0f),p);
+}
+
+static inline void vmsincosf(vfloat x, vfloat *s, vfloat *c)
+{
+  const vfloat shift=vfset(0x1.8p23f);
+  vfloat ps, pc;
+  int k;
+
+  vfloat t=x*vfset((float)M_2_PI)+shift;
+  vfloat q=t-shift;
+  vfloat r=x-q*vfset(1.5703125f);
+  r=r-q*vfset(4.837512969970703125e-4f);
+  r=r-q*vfset(7.54978995489188216e-8f);
+  vfloat r2=r*r;
+
+  ps=vfset((float)vmSinCoef[VMATH_NSINF]);
+#pragma GCC unroll 16
+  for (k=VMATH_NSINF-1;k>=1;k--)
+    ps=ps*r2+vfset((float)vmSinCoef[k]);
+  ps=r+r*r2*ps;
+  pc=vfset((float)vmCosCoef[VMATH_NCOSF]);
+#pragma GCC unroll 16
+  for (k=VMATH_NCOSF-1;k>=0;k--)
+    pc=pc*r2+vfset((float)vmCosCoef[k]);
+
+  vint32 quad=vfasint(t);
+  vint32 swap=-(quad&1);
+  *s=vfasfloat(vfasint(vfselect(swap,pc,ps))^((quad&2)<<30));
+  *c=vfasfloat(vfasint(vfselect(swap,ps,pc))^(((quad+1)&2)<<30));
+}
+
+static inline vfloat vmsinf(vfloat x) { vfloat s, c; vmsincosf(x,&s,&c); return s; }
+static inline vfloat vmcosf(vfloat x) { vfloat s, c; vmsincosf(x,&s,&c); return c; }
+
+#define vexp(x)         vmexp(x)
+#define vcos(x)         vmcos(x)
+#define vsin(x)         vmsin(x)
+#define vsincos(x,s,c)  vmsincos(x,&(s),&(c))
+#define vfexp(x)        vmexpf(x)
+#define vfcos(x)        vmcosf(x)
+#define vfsin(x)        vmsinf(x)
+#define vfsincos(x,s,c) vmsincosf(x,&(s),&(c))
+#endif
+
+// evaluates a libm function one lane at a time
+static inline vdouble vlanes(vdouble x, double (*func)(double))
+{
+  double aux[VLEN] __attribute__((aligned(DATA_ALIGN)));
+  int lane;
+
+  vstore(aux,x);
+  for (lane=0;lane<VLEN;lane++)
+    aux[lane]=func(aux[lane]);
+  return vload(aux);
+}
+
+#ifndef vexp
+// no vector math library: evaluate the transcendentals one lane at a time
+#define vexp(x)      vlanes(x,exp)
+#define vcos(x)      vlanes(x,cos)
+#define vsin(x)      vlanes(x,sin)
+#endif
+
+#define vj0(x)       vlanes(x,j0)
+
+// evaluates a libm function of floats one lane at a time
+static inline vfloat vflanes(vfloat x, float (*func)(float))
+{
+  float aux[VLENF] __attribute__((aligned(DATA_ALIGN)));
+  int lane;
+
+  vfstore(aux,x);
+  for (lane=0;lane<VLENF;lane++)
+    aux[lane]=func(aux[lane]);
+  return vfload(aux);
+}
+
+#ifndef vfexp
+#define vfexp(x)     vflanes(x,expf)
+#define vfcos(x)     vflanes(x,cosf)
+#define vfsin(x)     vflanes(x,sinf)
+#endif
+
+#ifndef vsincos
+// the sine and the cosine of the same lanes, s and c on return
+#define vsincos(x,s,c)  ((s)=vsin(x),(c)=vcos(x))
+#define vfsincos(x,s,c) ((s)=vfsin(x),(c)=vfcos(x))
+#endif
+
+#endif
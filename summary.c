@@ -0,0 +1,607 @@
+/*! \file
+  \brief
+  File with subroutines to summarize MCMC chains as they are run
+
+  \details
+  The links that a sampler passes through recordLink() after burn-in
+  are summarized on the fly in a chainSummary, in memory independent of
+  the length of the chain, so that a production run needs neither to
+  write nor to reload the whole chain:
+
+  - the mean and the covariance of the parameters, with Welford's
+    running sums of the deviations from the mean;
+  - the quantiles 2.5%, 16%, 50%, 84% and 97.5% of each parameter, with
+    the P-square algorithm of Jain & Chlamtac (1985), which follows
+    each quantile with five markers; the markers start at the exact
+    quantiles of the first SUMMARYNRANGE links rather than at the
+    first five, which are too close together in an MCMC chain;
+  - 1D histograms of each parameter and 2D histograms of each pair of
+    parameters, with Nbins fixed bins, ready for a corner plot.
+
+  The ranges of the histograms are set by the first SUMMARYNRANGE links,
+  which are kept until then: each range is that of those links, widened
+  by half of it on each side. Later links outside the range of a
+  parameter are counted, but left out of its histograms.
+
+  writeSummary() records the summary as text, in sections that start
+  with a line "# <name>", e.g.
+
+  # mcmc summary Nparam=6 Nbins=50 Nlinks=40000 names=F1,sigma1,x2,y2,F2,sigma2
+  # mean
+  ...
+  # covariance
+  ...
+
+  which plot_corner.py reads instead of a chains file.
+
+  \date October 14, 2026
+
+  \bugs No known bugs
+
+  \warning The P-square estimates of the tail quantiles of a
+  strongly autocorrelated chain can be off by a fair fraction of the
+  width of the posterior; the histograms are exact.
+
+*/
+#include<stdio.h>
+#include<math.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "mcmc.h"
+
+#define NMARKERS 5                 // markers of a P-square estimate
+
+#define ERROR_FILE 9999            // error code for file i/o errors
+
+// probabilities of the quantiles of a summary
+static const double quantiles[SUMMARYNQUANT]={0.025,0.16,0.5,0.84,0.975};
+
+/*!
+\brief
+Sets up the streaming summary of a chain
+
+\version 1.1
+
+\date Oct 14, 2026
+
+\pre It is called from main()
+
+@param summary a pointer to the summary
+
+@param Nparam an int with the number of model parameters
+
+@param Nbins an int with the number of bins of each histogram
+
+\return zero if all was OK, ERROR_FILE if the allocation failed
+
+*/
+int initSummary(chainSummary *summary, int Nparam, int Nbins)
+{
+  int Nmarkers=Nparam*SUMMARYNQUANT*NMARKERS;
+  int Npairs=Nparam*(Nparam-1)/2;
+
+  summary->Nparam=Nparam;
+  summary->Nbins=Nbins;
+  summary->Nlinks=0;
+
+  summary->Nblock=Nparam+Nparam*Nparam+3*Nmarkers+SUMMARYNRANGE*Nparam+2*Nparam;
+  summary->Ncounts=Nparam*Nbins+(long)Npairs*Nbins*Nbins+Nparam;
+  summary->block=calloc(summary->Nblock,sizeof(double));
+  summary->counts=calloc(summary->Ncounts,sizeof(long));
+  if (summary->block==NULL || summary->counts==NULL)
+    {
+      printf("Error allocating memory for the summary of the chain\n");
+      free(summary->block);
+      free(summary->counts);
+      return ERROR_FILE;
+    }
+  summary->mean=summary->block;
+  summary->comoment=summary->mean+Nparam;
+  summary->height=summary->comoment+Nparam*Nparam;
+  summary->position=summary->height+Nmarkers;
+  summary->desired=summary->position+Nmarkers;
+  summary->first=summary->desired+Nmarkers;
+  summary->lower=summary->first+SUMMARYNRANGE*Nparam;
+  summary->width=summary->lower+Nparam;
+
+  summary->hist1=summary->counts;
+  summary->hist2=summary->hist1+Nparam*Nbins;
+  summary->Nout=summary->hist2+(long)Npairs*Nbins*Nbins;
+
+  return 0;
+}
+
+/*!
+\brief
+Frees the streaming summary of a chain
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param summary a pointer to the summary
+
+*/
+void freeSummary(chainSummary *summary)
+{
+  free(summary->block);
+  free(summary->counts);
+  summary->block=NULL;
+  summary->counts=NULL;
+}
+
+// for qsort() of doubles
+static int compareDoubles(const void *a, const void *b)
+{
+  double x=*(const double *)a, y=*(const double *)b;
+
+  return (x>y)-(x<y);
+}
+
+// the quantiles of the links kept in first[], by linear interpolation
+// between the sorted links
+static void exactQuantiles(chainSummary *summary, long Nlinks, double quant[])
+{
+  int Nparam=summary->Nparam;
+  int iparam, iquant;
+  long ilink;
+  double *sorted=malloc(Nlinks*sizeof(double));
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      for (ilink=1;ilink<=Nlinks;ilink++)
+	sorted[ilink-1]=summary->first[(ilink-1)*Nparam+iparam-1];
+      qsort(sorted,Nlinks,sizeof(double),compareDoubles);
+      for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+	{
+	  double x=quantiles[iquant-1]*(Nlinks-1);
+	  long below=(long)x;
+	  long above=(below+1<Nlinks) ? below+1 : below;
+	  quant[(iparam-1)*SUMMARYNQUANT+iquant-1]=sorted[below]+(x-below)*(sorted[above]-sorted[below]);
+	}
+    }
+  free(sorted);
+}
+
+/*!
+\brief
+Starts the P-square estimates of the quantiles from the first links
+
+\details
+The five markers of each quantile p start at the ranks 1, 1+(N-1)p/2,
+1+(N-1)p, 1+(N-1)(1+p)/2 and N of the first N=SUMMARYNRANGE links,
+rounded to whole ranks, with those same rounded ranks as their
+positions and the unrounded ones as their desired positions.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The summary has exactly SUMMARYNRANGE links
+
+@param summary a pointer to the summary
+
+*/
+static void startQuantiles(chainSummary *summary)
+{
+  int Nparam=summary->Nparam;
+  int iparam, iquant, imark;
+  long ilink, N=SUMMARYNRANGE;
+  double *sorted=malloc(N*sizeof(double));
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      for (ilink=1;ilink<=N;ilink++)
+	sorted[ilink-1]=summary->first[(ilink-1)*Nparam+iparam-1];
+      qsort(sorted,N,sizeof(double),compareDoubles);
+
+      for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+	{
+	  double p=quantiles[iquant-1];
+	  int offset=((iparam-1)*SUMMARYNQUANT+iquant-1)*NMARKERS;
+	  double fraction[NMARKERS]={0.0,p/2.0,p,(1.0+p)/2.0,1.0};
+
+	  for (imark=1;imark<=NMARKERS;imark++)
+	    {
+	      double desired=1.0+(N-1)*fraction[imark-1];
+	      long rank=(long)floor(desired+0.5);
+	      summary->height[offset+imark-1]=sorted[rank-1];
+	      summary->position[offset+imark-1]=rank;
+	      summary->desired[offset+imark-1]=desired;
+	    }
+	}
+    }
+  free(sorted);
+}
+
+/*!
+\brief
+Adds a value to the P-square estimate of a quantile
+
+\details
+Moves the markers that the value passes by one position, and then
+adjusts each of the three middle markers that is at least one
+position away from its desired position by one position, with the
+piecewise-parabolic prediction of its height (or the linear one, if
+the parabola would leave the neighbouring markers out of order).
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param q[] an array of doubles with the heights of the NMARKERS markers
+
+@param n[] an array of doubles with the positions of the markers
+
+@param desired[] an array of doubles with the desired positions of the markers
+
+@param p a double with the probability of the quantile
+
+@param x a double with the value
+
+*/
+static void addQuantile(double q[], double n[], double desired[], double p, double x)
+{
+  double increment[NMARKERS]={0.0,p/2.0,p,(1.0+p)/2.0,1.0};
+  int imark, cell;
+
+  // the cell of the value, extending the ends of the range if needed
+  if (x<q[0])
+    {
+      q[0]=x;
+      cell=1;
+    }
+  else if (x>=q[NMARKERS-1])
+    {
+      q[NMARKERS-1]=x;
+      cell=NMARKERS-1;
+    }
+  else
+    for (cell=1;cell<NMARKERS-1 && x>=q[cell];cell++);
+
+  for (imark=cell+1;imark<=NMARKERS;imark++)
+    n[imark-1]+=1.0;
+  for (imark=1;imark<=NMARKERS;imark++)
+    desired[imark-1]+=increment[imark-1];
+
+  // adjust the heights of the middle markers (imark-1 is 1, 2 and 3)
+  for (imark=2;imark<=NMARKERS-1;imark++)
+    {
+      int i=imark-1;
+      double d=desired[i]-n[i];
+
+      if ((d>=1.0 && n[i+1]-n[i]>1.0) || (d<=-1.0 && n[i-1]-n[i]<-1.0))
+	{
+	  int s=(d>0.0) ? 1 : -1;
+	  double parabolic=q[i]+s/(n[i+1]-n[i-1])*((n[i]-n[i-1]+s)*(q[i+1]-q[i])/(n[i+1]-n[i])+(n[i+1]-n[i]-s)*(q[i]-q[i-1])/(n[i]-n[i-1]));
+
+	  if (q[i-1]<parabolic && parabolic<q[i+1])
+	    q[i]=parabolic;
+	  else
+	    q[i]+=s*(q[i+s]-q[i])/(n[i+s]-n[i]);
+	  n[i]+=s;
+	}
+    }
+}
+
+/*!
+\brief
+Sets the ranges of the histograms from the links kept so far
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param summary a pointer to the summary
+
+@param Nlinks a long with the number of links kept in first[]
+
+*/
+static void setRanges(chainSummary *summary, long Nlinks)
+{
+  int Nparam=summary->Nparam;
+  int iparam;
+  long ilink;
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      double lo=summary->first[iparam-1], hi=lo;
+      for (ilink=2;ilink<=Nlinks;ilink++)
+	{
+	  double x=summary->first[(ilink-1)*Nparam+iparam-1];
+	  if (x<lo) lo=x;
+	  if (x>hi) hi=x;
+	}
+
+      // a chain that has not moved yet gets a range around its value
+      double span=hi-lo;
+      if (span<=0.0)
+	span=(lo!=0.0) ? 0.1*fabs(lo) : 1.0;
+      summary->lower[iparam-1]=lo-0.5*span;
+      summary->width[iparam-1]=2.0*span/summary->Nbins;
+    }
+}
+
+/*!
+\brief
+Adds a link to the 1D and 2D histograms
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre The ranges of the histograms are set
+
+@param summary a pointer to the summary
+
+@param row[] an array of doubles with the parameters of the link
+
+*/
+static void addHistograms(chainSummary *summary, double row[])
+{
+  int Nparam=summary->Nparam, Nbins=summary->Nbins;
+  int bin[Nparam];
+  int iparam, jparam;
+  long *hist2=summary->hist2;
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      double x=(row[iparam-1]-summary->lower[iparam-1])/summary->width[iparam-1];
+      bin[iparam-1]=(x>=0.0 && x<Nbins) ? (int)x : -1;
+      if (bin[iparam-1]<0)
+	summary->Nout[iparam-1]++;
+      else
+	summary->hist1[(iparam-1)*Nbins+bin[iparam-1]]++;
+    }
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=iparam+1;jparam<=Nparam;jparam++)
+      {
+	if (bin[iparam-1]>=0 && bin[jparam-1]>=0)
+	  hist2[bin[iparam-1]*Nbins+bin[jparam-1]]++;
+	hist2+=Nbins*Nbins;
+      }
+}
+
+/*!
+\brief
+Adds a link to the streaming summary of a chain
+
+\details
+Updates the running mean and covariance and the estimates of the
+quantiles. The first SUMMARYNRANGE links are also kept, to set the
+ranges of the histograms; once they are all in, they are added to the
+histograms, and so is every link after them.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from recordLink() with the links after burn-in
+
+@param summary a pointer to the summary
+
+@param row[] an array of doubles with the Nparam parameters of the link, and any extra columns
+
+*/
+void addSummary(chainSummary *summary, double row[])
+{
+  int Nparam=summary->Nparam;
+  double delta[Nparam];
+  int iparam, jparam, iquant;
+  long ilink;
+
+  summary->Nlinks++;
+
+  // Welford's update of the mean and of the sums of products
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      delta[iparam-1]=row[iparam-1]-summary->mean[iparam-1];
+      summary->mean[iparam-1]+=delta[iparam-1]/summary->Nlinks;
+    }
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=1;jparam<=Nparam;jparam++)
+      summary->comoment[(iparam-1)*Nparam+jparam-1]+=delta[iparam-1]*(row[jparam-1]-summary->mean[jparam-1]);
+
+  if (summary->Nlinks<=SUMMARYNRANGE)
+    {
+      memcpy(summary->first+(summary->Nlinks-1)*Nparam,row,Nparam*sizeof(double));
+      if (summary->Nlinks==SUMMARYNRANGE)
+	{
+	  startQuantiles(summary);
+	  setRanges(summary,SUMMARYNRANGE);
+	  for (ilink=1;ilink<=SUMMARYNRANGE;ilink++)
+	    addHistograms(summary,summary->first+(ilink-1)*Nparam);
+	}
+      return;
+    }
+
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+      {
+	int offset=((iparam-1)*SUMMARYNQUANT+iquant-1)*NMARKERS;
+	addQuantile(summary->height+offset,summary->position+offset,summary->desired+offset,quantiles[iquant-1],row[iparam-1]);
+      }
+  addHistograms(summary,row);
+}
+
+/*!
+\brief
+Records the streaming summary of a chain in a file
+
+\details
+Writes the sections of the summary (see the description of the file):
+the mean, the covariance (Nparam rows), the quantiles (one row per
+parameter), the ranges (lower edge, bin width and links outside, one
+row per parameter), the 1D histograms (one row per parameter) and the
+2D histograms of each pair i<j of parameters (Nbins rows, for the
+bins of i, of Nbins counts, for the bins of j).
+
+For a chain shorter than SUMMARYNRANGE links, the ranges are set from
+all its links and the quantiles are those of its sorted links.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called from main() after the sampler
+
+@param fname a string with the filename of the summary
+
+@param summary a pointer to the summary
+
+@param names[] an array of strings with the names of the parameters, or NULL
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int writeSummary(char fname[], chainSummary *summary, char *names[])
+{
+  int Nparam=summary->Nparam, Nbins=summary->Nbins;
+  int iparam, jparam, iquant, ibin, jbin;
+  long ilink, Nlinks=summary->Nlinks;
+  double quant[Nparam*SUMMARYNQUANT];
+  FILE *file;
+
+  if (Nlinks<1)
+    {
+      printf("No links after burn-in to summarize\n");
+      return ERROR_FILE;
+    }
+
+  // the links of a short chain are all still kept
+  if (Nlinks<SUMMARYNRANGE)
+    {
+      memset(summary->counts,0,(Nparam*Nbins+(long)Nparam*(Nparam-1)/2*Nbins*Nbins+Nparam)*sizeof(long));
+      setRanges(summary,Nlinks);
+      for (ilink=1;ilink<=Nlinks;ilink++)
+	addHistograms(summary,summary->first+(ilink-1)*Nparam);
+    }
+  if (Nlinks<=SUMMARYNRANGE)
+    exactQuantiles(summary,Nlinks,quant);
+  else
+    for (iparam=1;iparam<=Nparam;iparam++)
+      for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+	quant[(iparam-1)*SUMMARYNQUANT+iquant-1]=summary->height[((iparam-1)*SUMMARYNQUANT+iquant-1)*NMARKERS+2];
+
+  if ((file=fopen(fname,"w"))==NULL)
+    {
+      printf("Error opening file %s for writing\n",fname);
+      return ERROR_FILE;
+    }
+
+  fprintf(file,"# mcmc summary Nparam=%d Nbins=%d Nlinks=%ld names=",Nparam,Nbins,Nlinks);
+  for (iparam=1;iparam<=Nparam;iparam++)
+    {
+      if (names!=NULL)
+	fprintf(file,"%s%s",names[iparam-1],(iparam==Nparam) ? "\n" : ",");
+      else
+	fprintf(file,"p%d%s",iparam,(iparam==Nparam) ? "\n" : ",");
+    }
+
+  fprintf(file,"# mean\n");
+  for (iparam=1;iparam<=Nparam;iparam++)
+    fprintf(file,"%e\t%s",summary->mean[iparam-1],(iparam==Nparam) ? "\n" : "");
+
+  fprintf(file,"# covariance\n");
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=1;jparam<=Nparam;jparam++)
+      fprintf(file,"%e\t%s",(Nlinks>1) ? summary->comoment[(iparam-1)*Nparam+jparam-1]/(Nlinks-1) : 0.0,(jparam==Nparam) ? "\n" : "");
+
+  fprintf(file,"# quantiles");
+  for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+    fprintf(file," %g",quantiles[iquant-1]);
+  fprintf(file,"\n");
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (iquant=1;iquant<=SUMMARYNQUANT;iquant++)
+      fprintf(file,"%e\t%s",quant[(iparam-1)*SUMMARYNQUANT+iquant-1],(iquant==SUMMARYNQUANT) ? "\n" : "");
+
+  fprintf(file,"# ranges\n");
+  for (iparam=1;iparam<=Nparam;iparam++)
+    fprintf(file,"%.17e\t%.17e\t%ld\n",summary->lower[iparam-1],summary->width[iparam-1],summary->Nout[iparam-1]);
+
+  fprintf(file,"# histograms\n");
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (ibin=1;ibin<=Nbins;ibin++)
+      fprintf(file,"%ld%s",summary->hist1[(iparam-1)*Nbins+ibin-1],(ibin==Nbins) ? "\n" : "\t");
+
+  long *hist2=summary->hist2;
+  for (iparam=1;iparam<=Nparam;iparam++)
+    for (jparam=iparam+1;jparam<=Nparam;jparam++)
+      {
+	fprintf(file,"# histogram2d %d %d\n",iparam-1,jparam-1);
+	for (ibin=1;ibin<=Nbins;ibin++)
+	  for (jbin=1;jbin<=Nbins;jbin++)
+	    fprintf(file,"%ld%s",hist2[(ibin-1)*Nbins+jbin-1],(jbin==Nbins) ? "\n" : "\t");
+	hist2+=Nbins*Nbins;
+      }
+
+  if (fclose(file)!=0)
+    return ERROR_FILE;
+
+  return 0;
+}
+
+/*!
+\brief
+Passes a link of a chain to its file and its summary
+
+\details
+Leaves out the first record->Nburn links; of the others, it adds every
+one to the summary, if there is one, and writes every record->thin-th
+one to the chains file.
+
+\version 1.0
+
+\date Oct 14, 2026
+
+\pre It is called by the samplers after every link, with ilink counting from 1
+
+@param writer a pointer to the chain writer
+
+@param record a pointer to the rule of the links that are recorded
+
+@param ilink a long with the number of the link
+
+@param row[] an array of doubles with the row of the link
+
+\return zero if all was OK, ERROR_FILE otherwise
+
+*/
+int recordLink(chainWriter *writer, chainRecord *record, long ilink, double row[])
+{
+  if (ilink<=record->Nburn)
+    return 0;
+
+  if (record->summary!=NULL)
+    addSummary(record->summary,row);
+
+  if (record->thin>0 && (ilink-record->Nburn)%record->thin==0)
+    return writeChain(writer,row);
+
+  return 0;
+}
+
+/*!
+\brief
+Returns the number of links of a chain that go to its file
+
+\version 1.0
+
+\date Oct 14, 2026
+
+@param record a pointer to the rule of the links that are recorded
+
+@param Nchain a long with the number of links of the chain
+
+\return a long with the number of links written by recordLink()
+
+*/
+long recordedLinks(chainRecord *record, long Nchain)
+{
+  if (record->thin<1 || Nchain<=record->Nburn)
+    return 0;
+
+  return (Nchain-record->Nburn)/record->thin;
+}
@@ -62,6 +62,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "mcmc.h"
 
 
 // uint32_t must be an unsigned integer type capable of holding at least 32
@@ -69,9 +72,7 @@
 //  GCC at -O3 optimization so try your options and see what's best for you
 
 
-typedef unsigned int uint32;
-
-#define N              (624)                 // length of state vector
+#define N              (MTLENGTH)            // length of state vector
 #define M              (397)                 // a period parameter
 #define K              (0x9908B0DFU)         // a magic constant
 #define hiBit(u)       ((u) & 0x80000000U)   // mask all but highest   bit of u
@@ -79,9 +80,43 @@ typedef unsigned int uint32;
 #define loBits(u)      ((u) & 0x7FFFFFFFU)   // mask     the highest   bit of u
 #define mixBits(u, v)  (hiBit(u)|loBits(v))  // move hi bit of u to hi bit of v
 
-static uint32   state[N+1];     // state vector + 1 extra to not violate ANSI C
-static uint32   *next;          // next random value is computed from here
-static int      left = -1;      // can *next++ this many times before reloading
+// The state vector, the pointer to the next value and the number of values
+// left before reloading are kept in an mtState structure (see mcmc.h), so
+// that each chain can own an independent generator.
+
+// The generator seedMT() sets up: RNG_MT, or RNG_PHILOX for the
+// counter-based streams of philox.c (see setGeneratorMT()).
+static int generatorMT=RNG_MT;
+
+// The block routines below use the generic vector extensions of GCC and
+// clang, which compile to the widest SIMD instructions enabled by ARCH
+// (or to scalar code), on MTLANES 32-bit words at a time.
+#define MTLANES        8
+typedef uint32 vuint32 __attribute__((vector_size(4*MTLANES)));
+typedef double vdouble32 __attribute__((vector_size(8*MTLANES)));
+
+static inline vuint32 loadMT(uint32 *p)
+ {
+    vuint32 v;
+    memcpy(&v, p, sizeof(v));
+    return(v);
+ }
+
+static inline void storeMT(uint32 *p, vuint32 v)
+ {
+    memcpy(p, &v, sizeof(v));
+ }
+
+// one step of the recursion, state[i] from state[i], state[i+1], state[i+M]
+#define twistMT(s0, s1, sM) \
+    ((sM) ^ (mixBits(s0, s1) >> 1) ^ (-loBit(s1) & K))
+
+// the tempering of an element of the state into an output value
+#define temperMT(y)                           \
+    ((y) ^= ((y) >> 11),                      \
+     (y) ^= ((y) <<  7) & 0x9D2C5680U,        \
+     (y) ^= ((y) << 15) & 0xEFC60000U,        \
+     (y) ^  ((y) >> 18))
 
 /*!
   \brief
@@ -132,40 +167,152 @@ static int      left = -1;      // can *next++ this many times before reloading
        none of all of this matters.  In fact, the seed values made here could
        even be extra-special desirable if the Mersenne Twister theory says
        so-- that's why the only change I made is to restrict to odd seeds.
+
+       The generator state is the structure pointed to by mt; any normal
+       deviate kept by gaussFill() from the previous seed is discarded.
+
+       With RNG_PHILOX (see setGeneratorMT()), the seed is instead the
+       key of a Philox stream (see seedPhilox()).
       
 */
-void seedMT(uint32 seed)
+void seedMT(mtState *mt, uint32 seed)
  {
 
-    register uint32 x = (seed | 1U) & 0xFFFFFFFFU, *s = state;
+    register uint32 x = (seed | 1U) & 0xFFFFFFFFU, *s = mt->state;
     register int    j;
 
-    for(left=0, *s++=x, j=N; --j;
+    if(generatorMT == RNG_PHILOX)
+     {
+        seedPhilox(mt, seed);
+        return;
+     }
+    mt->philox=0;     // and no counter of a Philox stream
+    mt->key[0]=mt->key[1]=0U;
+    mt->step=0;
+    mt->block=0;
+    mt->nout=0;
+
+    for(mt->left=0, *s++=x, j=N; --j;
         *s++ = (x*=69069U) & 0xFFFFFFFFU);
+
+    mt->hasGauss=0;   // no normal deviates left over from a previous seed
  }
 
+/*!
+  \brief
+  Choice of the generator
 
-uint32 reloadMT(void)
+  \details
+  Chooses the generator that seedMT() sets up from then on: RNG_MT, the
+  Mersenne Twister (the default), or RNG_PHILOX, the counter-based
+  Philox4x32-10 of philox.c. It is called once by main(), before any
+  chain is seeded or any thread started.
+
+*/
+void setGeneratorMT(int generator)
  {
-    register uint32 *p0=state, *p2=state+2, *pM=state+M, s0, s1;
-    register int    j;
+    generatorMT = generator;
+ }
+
+/*!
+  \brief
+  Start of a new step of the samplers
+
+  \details
+  Called by the samplers at the start of every link (or step, or swap).
+  A Philox stream moves to the first block of the next step of its
+  counter, and discards any normal deviate kept by gaussFill(), so that
+  the numbers of a link depend only on the key and the number of the
+  link. The Mersenne Twister has no counter and goes on with its
+  sequence.
+
+*/
+void nextStepMT(mtState *mt)
+ {
+    if(!mt->philox)
+        return;
+
+    mt->step++;
+    mt->block=0;
+    mt->nout=0;
+    mt->hasGauss=0;
+ }
+
+/*!
+  \brief
+  Seed for one of several independent streams
 
-    if(left < -1)
-        seedMT(4357U);
+  \details
+  Returns the seed of stream number "stream" derived from a base seed.
+  Stream 0 uses the base seed itself, so that a single chain reproduces
+  the runs made before multiple streams existed. The other streams hash
+  the pair (seed, stream) with the SplitMix64 finalizer, so that nearby
+  stream numbers give unrelated seeds and, because of the poor seeding
+  recursion discussed in seedMT(), unrelated initial states.
 
-    left=N-1, next=state+1;
+*/
+uint32 streamSeedMT(uint32 seed, int stream)
+ {
+    unsigned long long z;
 
-    for(s0=state[0], s1=state[1], j=N-M+1; --j; s0=s1, s1=*p2++)
-        *p0++ = *pM++ ^ (mixBits(s0, s1) >> 1) ^ (loBit(s1) ? K : 0U);
+    if(stream == 0)
+        return(seed);
+
+    z  = (((unsigned long long) seed << 32) | (uint32) stream) + 0x9E3779B97F4A7C15ULL;
+    z  = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z  = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= (z >> 31);
+    return((uint32) (z >> 32));
+ }
 
-    for(pM=state, j=M; --j; s0=s1, s1=*p2++)
-        *p0++ = *pM++ ^ (mixBits(s0, s1) >> 1) ^ (loBit(s1) ? K : 0U);
 
-    s1=state[0], *p0 = *pM ^ (mixBits(s0, s1) >> 1) ^ (loBit(s1) ? K : 0U);
-    s1 ^= (s1 >> 11);
-    s1 ^= (s1 <<  7) & 0x9D2C5680U;
-    s1 ^= (s1 << 15) & 0xEFC60000U;
-    return(s1 ^ (s1 >> 18));
+/*!
+  \brief
+  Regeneration of the state vector
+
+  \details
+  Calculates the next N elements of the state vector in place, MTLANES
+  at a time. The recursion reads state[i+1] and state[i+M], or for the
+  later elements state[i+M-N], which are at least MTLANES elements
+  away from the ones being written, so a block of lanes never depends
+  on itself. The result is identical to that of the scalar recursion.
+
+*/
+static void regenMT(mtState *mt)
+ {
+    uint32 *state=mt->state;
+    int     j;
+
+    if(mt->left < -1)
+        seedMT(mt, 4357U);
+
+    // state[0..N-M-1] use state[j+M], not yet regenerated
+    for(j=0; j+MTLANES <= N-M; j+=MTLANES)
+        storeMT(state+j, twistMT(loadMT(state+j), loadMT(state+j+1), loadMT(state+j+M)));
+    for(; j < N-M; j++)
+        state[j] = twistMT(state[j], state[j+1], state[j+M]);
+
+    // state[N-M..N-2] use state[j+M-N], already regenerated
+    for(; j+MTLANES <= N-1; j+=MTLANES)
+        storeMT(state+j, twistMT(loadMT(state+j), loadMT(state+j+1), loadMT(state+j+M-N)));
+    for(; j < N-1; j++)
+        state[j] = twistMT(state[j], state[j+1], state[j+M-N]);
+
+    // state[N-1] wraps around to the new state[0]
+    state[N-1] = twistMT(state[N-1], state[0], state[M-1]);
+ }
+
+
+uint32 reloadMT(mtState *mt)
+ {
+    uint32 s1;
+
+    regenMT(mt);
+
+    mt->left=N-1, mt->next=mt->state+1;
+
+    s1=mt->state[0];
+    return(temperMT(s1));
  }
 
 
@@ -174,21 +321,75 @@ uint32 reloadMT(void)
   Random number generator
 
   \details
-  Random number generator
+  Random number generator; returns the next value of the stream of the
+  generator pointed to by mt, which must have been seeded with seedMT()
 
 */
-uint32 randomMT(void)
+uint32 randomMT(mtState *mt)
  {
     uint32 y;
 
-    if(--left < 0)
-        return(reloadMT());
+    if(mt->philox)
+        return(randomPhilox(mt));
+
+    if(--mt->left < 0)
+        return(reloadMT(mt));
+
+    y  = *mt->next++;
+    return(temperMT(y));
+ }
+
+
+/*!
+  \brief
+  Block of uniform random numbers
+
+  \details
+  Fills result[] with Nfill uniform deviates in (0,1), identical to
+  those of Nfill successive calls to uniform(): the output k maps to
+  (k+1/2)/2^32. The values are tempered and converted MTLANES at a
+  time straight from the state vector, which is regenerated with
+  regenMT() whenever it runs out, so the calls can be freely mixed
+  with randomMT() and uniform() on the same generator.
 
-    y  = *next++;
-    y ^= (y >> 11);
-    y ^= (y <<  7) & 0x9D2C5680U;
-    y ^= (y << 15) & 0xEFC60000U;
-    return(y ^ (y >> 18));
+*/
+void fillMT(mtState *mt, int Nfill, double result[])
+ {
+    const double scale=1.0/4294967296.0;
+    int j, Nblock;
+
+    if(mt->philox)
+     {
+        fillPhilox(mt, Nfill, result);
+        return;
+     }
+
+    while(Nfill > 0)
+     {
+        if(mt->left <= 0)
+         {
+            regenMT(mt);
+            mt->left=N, mt->next=mt->state;
+         }
+
+        Nblock = (Nfill < mt->left) ? Nfill : mt->left;
+
+        for(j=0; j+MTLANES <= Nblock; j+=MTLANES)
+         {
+            vuint32 y=loadMT(mt->next+j);
+            vdouble32 u=__builtin_convertvector(temperMT(y), vdouble32);
+            u=(u+0.5)*scale;
+            memcpy(result+j, &u, sizeof(u));
+         }
+        for(; j < Nblock; j++)
+         {
+            uint32 y=mt->next[j];
+            result[j]=(temperMT(y)+0.5)*scale;
+         }
+
+        mt->next+=Nblock, mt->left-=Nblock;
+        result+=Nblock, Nfill-=Nblock;
+     }
  }
 
 /*
@@ -196,15 +397,16 @@ uint32 randomMT(void)
 int main(void)
  {
     int j;
+    mtState mt;
 
     // you can seed with any uint32, but the best are odds in 0..(2^32 - 1)
 
-    seedMT(4357U);
+    seedMT(&mt, 4357U);
 
     // print the first 2,002 random numbers seven to a line as an example
 
     for(j=0; j<2002; j++)
-        printf(" %10lu%s", (unsigned long) randomMT(), (j%7)==6 ? "\n" : "");
+        printf(" %10lu%s", (unsigned long) randomMT(&mt), (j%7)==6 ? "\n" : "");
 
     return(EXIT_SUCCESS);
  }